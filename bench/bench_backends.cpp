@@ -0,0 +1,125 @@
+#include "Compiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace minilang;
+
+/**
+ * Expression-heavy workloads run unchanged on both backends
+ */
+static const char* LOOP_SOURCE =
+    "let i = 0;"
+    "let sum = 0;"
+    "while (i < 2000000) {"
+    "    sum = sum + i % 7;"
+    "    i = i + 1;"
+    "}"
+    "print sum;";
+
+static const char* LOCAL_LOOP_SOURCE =
+    "fn work(n) {"
+    "    let i = 0;"
+    "    let acc = 0;"
+    "    while (i < n) {"
+    "        acc = acc + (i * 3 - i / 2) % 11;"
+    "        i = i + 1;"
+    "    }"
+    "    return acc;"
+    "}"
+    "print work(2000000);";
+
+static const char* FIB_SOURCE =
+    "fn fib(n) {"
+    "    if (n <= 1) { return n; }"
+    "    return fib(n - 1) + fib(n - 2);"
+    "}"
+    "print fib(25);";
+
+static constexpr int RUNS = 5;
+
+/**
+ * Static instruction count of a chunk and every function nested in it
+ */
+template <typename ChunkType, typename CodeOf>
+static size_t countInstructions(const ChunkType& chunk, CodeOf codeOf) {
+    size_t count = chunk.code.size();
+    for (const Value& constant : chunk.constants) {
+        if (constant.isFunction()) {
+            count += countInstructions(codeOf(constant.asFunction()), codeOf);
+        }
+    }
+    return count;
+}
+
+/**
+ * Run a compiled chunk several times and return the fastest run in ms
+ */
+template <typename ChunkType>
+static double bestTime(Compiler& compiler, const ChunkType& chunk) {
+    double best = 0.0;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        compiler.run(chunk);
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+/**
+ * Compile a workload for both backends and report size, executed
+ * instructions (profiling builds only) and wall time side by side
+ */
+static void benchmark(const std::string& name, const std::string& source) {
+    std::ostringstream discard;
+
+    // Interpreter against interpreter: keep the JIT out of the stack VM
+    Compiler stack;
+    stack.vm().setOutput(discard);
+    stack.vm().setJitEnabled(false);
+    Chunk chunk = stack.compile(source);
+
+    Compiler reg;
+    reg.registerVM().setOutput(discard);
+    RegisterChunk regChunk = reg.compileRegister(source);
+
+    if (stack.hadError() || reg.hadError()) {
+        std::cerr << name << ": " << stack.getError() << reg.getError() << std::endl;
+        return;
+    }
+
+    size_t stackSize = countInstructions(chunk, [](const ObjFunction* f) -> const Chunk& { return f->chunk; });
+    size_t regSize = countInstructions(regChunk,
+                                       [](const ObjFunction* f) -> const RegisterChunk& { return f->registerChunk; });
+    double stackMs = bestTime(stack, chunk);
+    double regMs = bestTime(reg, regChunk);
+
+    // Executed counts are only collected by profiling builds
+    auto executed = [](uint64_t total) {
+        return MINILANG_PROFILE_OPCODES ? std::to_string(total / RUNS) : std::string("-");
+    };
+
+    std::cout << name << std::endl;
+    std::cout << std::format("  {:<9} {:>6} static {:>12} executed {:>9.2f} ms", "stack", stackSize,
+                             executed(stack.vm().executedCount()), stackMs)
+              << std::endl;
+    std::cout << std::format("  {:<9} {:>6} static {:>12} executed {:>9.2f} ms", "register", regSize,
+                             executed(reg.registerVM().executedCount()), regMs)
+              << std::endl;
+}
+
+int main() {
+    std::cout << "=== Backends: stack vs register (best of " << RUNS << ")"
+              << (MINILANG_PROFILE_OPCODES ? ", profiling build" : "") << " ===" << std::endl;
+
+    benchmark("while loop (globals)", LOOP_SOURCE);
+    benchmark("while loop (locals)", LOCAL_LOOP_SOURCE);
+    benchmark("fib(25)", FIB_SOURCE);
+    return 0;
+}
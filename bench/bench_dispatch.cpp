@@ -0,0 +1,68 @@
+#include "Compiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace minilang;
+
+/**
+ * Workloads dominated by dispatch: tight while-loops over locals and calls
+ */
+static const char* LOOP_SOURCE =
+    "let i = 0;"
+    "let sum = 0;"
+    "while (i < 2000000) {"
+    "    sum = sum + i % 7;"
+    "    i = i + 1;"
+    "}"
+    "print sum;";
+
+static const char* FIB_SOURCE =
+    "fn fib(n) {"
+    "    if (n <= 1) { return n; }"
+    "    return fib(n - 1) + fib(n - 2);"
+    "}"
+    "print fib(25);";
+
+static constexpr int RUNS = 5;
+
+/**
+ * Compile once, run several times, report the fastest run
+ */
+static void benchmark(const std::string& name, const std::string& source, bool jit = false) {
+    Compiler compiler;
+    compiler.vm().setJitEnabled(jit);
+    Chunk chunk = compiler.compile(source);
+    if (compiler.hadError()) {
+        std::cerr << name << ": " << compiler.getError() << std::endl;
+        return;
+    }
+
+    double best = 0.0;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        compiler.run(chunk);
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+
+    std::cout << "  " << name << ": " << best << " ms (best of " << RUNS << ")" << std::endl;
+}
+
+int main() {
+    std::cout << "=== VM dispatch: " << (MINILANG_COMPUTED_GOTO ? "computed goto" : "switch")
+              << " ===" << std::endl;
+
+    benchmark("while loop", LOOP_SOURCE);
+    benchmark("fib(25)", FIB_SOURCE);
+
+    if (MINILANG_JIT && MINILANG_COMPUTED_GOTO) {
+        std::cout << "=== Baseline JIT ===" << std::endl;
+        benchmark("while loop", LOOP_SOURCE, true);
+        benchmark("fib(25)", FIB_SOURCE, true);
+    }
+    return 0;
+}
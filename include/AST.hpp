@@ -2,6 +2,7 @@
 
 #include "Token.hpp"
 #include <memory>
+#include <stdexcept>
 #include <vector>
 #include <variant>
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "AST.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * Ahead-of-time backend - Compiles AST to a standalone C program
+ *
+ * The output carries a small runtime for tagged values, strings and
+ * dynamic calls, and needs only the C standard library and libm. Every
+ * subexpression is evaluated into its own temporary, so the evaluation
+ * order (and the runtime errors raised) match the VM exactly; the C
+ * compiler folds the temporaries away.
+ */
+class CGenerator {
+public:
+    CGenerator() = default;
+    ~CGenerator() = default;
+
+    /**
+     * Compile a program to C source
+     */
+    std::string compile(const Program& program);
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Check if compilation was successful
+     */
+    bool hadError() const { return m_hadError; }
+
+private:
+    /**
+     * Local variable and the C variable holding it
+     */
+    struct CLocal {
+        std::string_view name;
+        size_t depth;
+        std::string variable;
+    };
+
+    /**
+     * Code generation state of the function being compiled
+     */
+    struct FunctionState {
+        std::string body;
+        std::vector<CLocal> locals;
+        size_t scopeDepth = 0;
+        size_t nextLocal = 0;
+        size_t nextTemp = 0;
+        int indent = 1;
+        bool isScript = true;   // Top level, compiled into ml_main()
+    };
+
+    FunctionState m_function;
+    std::string m_declarations;              // Function prototypes and descriptors
+    std::string m_definitions;               // Function bodies
+    std::vector<std::string> m_strings;      // String literals, created once at startup
+    std::vector<std::string> m_globals;      // Declared globals, in declaration order
+    std::vector<std::string> m_globalRefs;   // Globals referenced anywhere
+    size_t m_functionCount = 0;
+    bool m_hadError = false;
+    std::string m_error;
+
+    // Scope management
+    void beginScope();
+    void endScope();
+    std::string declareLocal(std::string_view name);
+    const CLocal* resolveLocal(std::string_view name) const;
+    std::string resolveGlobal(std::string_view name);
+    void declareGlobal(std::string_view name);
+    void checkGlobalsDefined();
+
+    // Emission
+    void line(const std::string& code);
+    std::string temp(const std::string& value);
+    std::string literal(const std::string& value);
+
+    // Expression compilation; returns the C variable holding the result
+    std::string compileExpr(Expr* expr);
+    std::string compileBinaryExpr(BinaryExpr* expr);
+    std::string compileCallExpr(CallExpr* expr);
+    std::string compileAssign(AssignExpr* expr);
+
+    // Statement compilation
+    void compileStmt(Stmt* stmt);
+    void compileLetStmt(LetStmt* stmt);
+    void compileFunctionStmt(FunctionStmt* stmt);
+    void compileIfStmt(IfStmt* stmt);
+    void compileWhileStmt(WhileStmt* stmt);
+    void compileBlockStmt(BlockStmt* stmt);
+
+    // Error handling
+    void error(const std::string& message);
+};
+
+} // namespace minilang
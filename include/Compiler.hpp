@@ -3,14 +3,28 @@
 #include "IRGenerator.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
+#include "RegisterVM.hpp"
+#include "SSA.hpp"
 #include "VM.hpp"
+#include <memory>
 #include <string>
 
 namespace minilang {
 
+/**
+ * Bytecode format and VM used by Compiler::run(source)
+ */
+enum class Backend : uint8_t {
+    STACK,
+    REGISTER,
+    SSA, // Stack bytecode generated through the SSA IR
+};
+
 /**
  * Top-level compiler that orchestrates the compilation pipeline
- * Source -> Lexer -> Tokens -> Parser -> AST -> IR Generator -> Bytecode -> VM
+ * Source -> Lexer -> Tokens -> Parser -> AST -> Optimizer -> IR Generator -> Bytecode -> VM
+ * (or AST -> SSA Builder -> SSA -> SSA Lowering -> Bytecode with Backend::SSA,
+ *  or AST -> C Generator -> C source for ahead-of-time builds)
  */
 class Compiler {
 public:
@@ -20,18 +34,57 @@ public:
     /**
      * Compile and run source code
      */
-    InterpretResult run(const std::string& source);
+    InterpretResult run(std::string_view source);
 
     /**
      * Compile source code and return bytecode
+     * Strings and functions in the chunk live on this compiler's VM heap
+     */
+    Chunk compile(std::string_view source);
+
+    /**
+     * Compile source code to stack bytecode through the SSA IR
+     * Strings and functions in the chunk live on this compiler's VM heap
+     */
+    Chunk compileSSA(std::string_view source);
+
+    /**
+     * Build the SSA IR for source code and render it as text
      */
-    Chunk compile(const std::string& source);
+    std::string dumpSSA(std::string_view source);
+
+    /**
+     * Compile source code to register bytecode
+     * Strings and functions in the chunk live on the register VM heap
+     */
+    RegisterChunk compileRegister(std::string_view source);
+
+    /**
+     * Compile source code to a standalone C program
+     */
+    std::string compileToC(std::string_view source);
 
     /**
      * Run pre-compiled bytecode
      */
     InterpretResult run(const Chunk& chunk);
 
+    /**
+     * Run pre-compiled register bytecode
+     */
+    InterpretResult run(const RegisterChunk& chunk);
+
+    /**
+     * Select the backend used when running source code
+     */
+    void setBackend(Backend backend) { m_backend = backend; }
+
+    /**
+     * Enable or disable inlining of small functions in compile(source)
+     * The REPL turns it off: a later line may redefine an inlined function
+     */
+    void setInlining(bool enabled) { m_inlining = enabled; }
+
     /**
      * Get the last error message
      */
@@ -42,12 +95,37 @@ public:
      */
     bool hadError() const { return !m_error.empty(); }
 
+    /**
+     * Peephole counters from the last compile(source) or compileSSA(source)
+     */
+    const PeepholeStats& peepholeStats() const { return m_peepholeStats; }
+
+    /**
+     * The VM that runs compiled chunks
+     */
+    VM& vm() { return *m_vm; }
+
+    /**
+     * The VM that runs compiled register chunks
+     */
+    RegisterVM& registerVM() { return *m_regvm; }
+
 private:
     std::string m_error;
+    PeepholeStats m_peepholeStats;
+    Backend m_backend = Backend::STACK;
+    bool m_inlining = true;
     Lexer* m_lexer = nullptr;
     Parser* m_parser = nullptr;
     IRGenerator* m_irgen = nullptr;
-    VM* m_vm = nullptr;
+    std::unique_ptr<VM> m_vm;
+    std::unique_ptr<RegisterVM> m_regvm;
+
+    // Front end shared by both backends; false on a lexer error
+    bool parse(std::string_view source, Program& program);
+
+    // Verified SSA for a parsed program; null on error
+    std::unique_ptr<SSAFunction> buildSSA(const Program& program);
 };
 
 } // namespace minilang
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "AST.hpp"
+#include "Peephole.hpp"
+#include "TypeInference.hpp"
+#include "Value.hpp"
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <variant>
+#include <unordered_set>
 #include <vector>
 
 namespace minilang {
@@ -58,70 +63,125 @@ enum class OpCode : uint8_t {
     OP_CALL,
     OP_RETURN,
 
+    // Superinstructions (fused sequences that dominate opcode-pair profiles)
+    OP_POP_JUMP_IF_FALSE,          // OP_JUMP_IF_FALSE + OP_POP on both paths
+    OP_POP_JUMP_IF_TRUE,           // OP_NOT + OP_POP_JUMP_IF_FALSE (peephole only)
+    OP_JUMP_IF_NOT_LESS,           // OP_LESS + OP_POP_JUMP_IF_FALSE
+    OP_JUMP_IF_NOT_LESS_EQUAL,     // OP_LESS_EQUAL + OP_POP_JUMP_IF_FALSE
+    OP_JUMP_IF_NOT_GREATER,        // OP_GREATER + OP_POP_JUMP_IF_FALSE
+    OP_JUMP_IF_NOT_GREATER_EQUAL,  // OP_GREATER_EQUAL + OP_POP_JUMP_IF_FALSE
+    OP_SET_LOCAL_POP,              // OP_SET_LOCAL + OP_POP
+    OP_SET_GLOBAL_POP,             // OP_SET_GLOBAL + OP_POP
+    OP_ADD_LOCAL_CONSTANT,         // OP_GET_LOCAL + OP_CONSTANT + OP_ADD
+    OP_ADD_GLOBAL_CONSTANT,        // OP_GET_GLOBAL + OP_CONSTANT + OP_ADD
+
+    // Quickened forms: never emitted, the VM rewrites generic ops into these
+    // after observing operand types and rewrites them back on a type miss
+    OP_ADD_NUM,
+    OP_ADD_STR,
+    OP_EQUAL_NUM,
+    OP_NOT_EQUAL_NUM,
+
+    // Typed forms: emitted when static type inference proves every operand
+    // is a number, so they skip the tag checks of their generic forms
+    OP_NUM_ADD,
+    OP_NUM_SUBTRACT,
+    OP_NUM_MULTIPLY,
+    OP_NUM_DIVIDE,
+    OP_NUM_MODULO,
+    OP_NUM_NEGATE,
+    OP_NUM_EQUAL,
+    OP_NUM_NOT_EQUAL,
+    OP_NUM_LESS,
+    OP_NUM_LESS_EQUAL,
+    OP_NUM_GREATER,
+    OP_NUM_GREATER_EQUAL,
+    OP_NUM_JUMP_IF_NOT_LESS,
+    OP_NUM_JUMP_IF_NOT_LESS_EQUAL,
+    OP_NUM_JUMP_IF_NOT_GREATER,
+    OP_NUM_JUMP_IF_NOT_GREATER_EQUAL,
+    OP_NUM_ADD_LOCAL_CONSTANT,
+    OP_NUM_ADD_GLOBAL_CONSTANT,
+    OP_INT_MODULO, // Both operands are also proven integral
+
     // Built-in
     OP_PRINT,
 };
 
+// Number of opcodes; OP_PRINT must stay the last enumerator
+constexpr size_t OPCODE_COUNT = static_cast<size_t>(OpCode::OP_PRINT) + 1;
+
 /**
- * Value types in the VM
+ * Get the opcode name for disassembly and profiles
  */
-enum class ValueType : uint8_t {
-    NIL,
-    BOOL,
-    NUMBER,
-    STRING,
-};
+const char* opcodeName(OpCode op);
 
 /**
- * Runtime value
+ * Generic form of a typed opcode; every other opcode maps to itself
  */
-struct Value {
-    ValueType type;
-    std::variant<std::monostate, bool, double, std::string> as;
+OpCode untypedOpcode(OpCode op);
 
-    Value() : type(ValueType::NIL), as(std::monostate{}) {}
-    explicit Value(bool b) : type(ValueType::BOOL), as(b) {}
-    explicit Value(double n) : type(ValueType::NUMBER), as(n) {}
-    explicit Value(std::string s) : type(ValueType::STRING), as(std::move(s)) {}
-
-    bool isBool() const { return type == ValueType::BOOL; }
-    bool isNumber() const { return type == ValueType::NUMBER; }
-    bool isString() const { return type == ValueType::STRING; }
-    bool isNil() const { return type == ValueType::NIL; }
+/**
+ * Bytecode instruction packed into one 32-bit word
+ * 8-bit opcode + 24-bit operand (jump offsets, local slots, constant indices)
+ * Constants live in Chunk::constants and are referenced by index
+ */
+struct Instruction {
+    OpCode opcode : 8;
+    uint32_t operand : 24;
 
-    bool asBool() const { return std::get<bool>(as); }
-    double asNumber() const { return std::get<double>(as); }
-    const std::string& asString() const { return std::get<std::string>(as); }
+    Instruction(OpCode op, uint32_t ops = 0) : opcode(op), operand(ops) {}
 };
 
+static_assert(sizeof(Instruction) == 4, "Instruction must pack into a single 32-bit word");
+
+// Largest operand an instruction can encode (constant index, jump, slot)
+constexpr uint32_t OPERAND_MAX = (1u << 24) - 1;
+
+// OP_ADD_*_CONSTANT pack a variable slot and a constant index into 12 bits each
+constexpr uint32_t PAIR_OPERAND_BITS = 12;
+constexpr uint32_t PAIR_OPERAND_MAX = (1u << PAIR_OPERAND_BITS) - 1;
+
+// Most local slots a single function may declare
+constexpr size_t LOCALS_MAX = UINT16_MAX + 1;
+
+// Largest returned expression, in AST nodes, that a call may be replaced with
+constexpr size_t INLINE_BUDGET = 24;
+
+class JitCode;
+
 /**
- * Bytecode instruction (8-bit opcode + optional operand)
+ * Tracing state of one loop, keyed by its header's instruction index
  */
-struct Instruction {
-    OpCode opcode;
-    uint8_t operand; // For jump offsets, local indices, etc.
-    Value constant;  // For OP_CONSTANT
-
-    Instruction(OpCode op, uint8_t ops = 0, Value cons = Value())
-        : opcode(op), operand(ops), constant(std::move(cons)) {}
+struct LoopTrace {
+    uint32_t hotness = 0;           // Back-edges taken since the last recording attempt
+    uint32_t aborts = 0;            // Recordings that left the loop or hit an untraceable op
+    const JitCode* code = nullptr;  // Owned by the VM that compiled it
 };
 
 /**
  * Chunk of bytecode
  */
 struct Chunk {
-    std::vector<Instruction> code;
+    mutable std::vector<Instruction> code; // Quickened in place by the VM
     std::vector<size_t> lines; // Debug info
     std::vector<Value> constants;
+    size_t localCount = 0; // High-water mark of declared local slots
+    size_t stackMax = 0;   // Most values a frame holds at once, its slots included
 
-    void write(OpCode op, size_t line, uint8_t operand = 0) {
+    // Calls and loop back-edges seen by the VM; compiled once hot
+    mutable uint32_t hotness = 0;
+    mutable const JitCode* jit = nullptr; // Owned by the VM that compiled it
+    mutable std::unordered_map<size_t, LoopTrace> traces;
+
+    void write(OpCode op, size_t line, uint32_t operand = 0) {
         code.emplace_back(op, operand);
         lines.push_back(line);
     }
 
     void writeConstant(Value constant, size_t line) {
         size_t index = addConstant(std::move(constant));
-        write(OpCode::OP_CONSTANT, line, static_cast<uint8_t>(index));
+        write(OpCode::OP_CONSTANT, line, static_cast<uint32_t>(index));
     }
 
     size_t addConstant(Value value) {
@@ -131,14 +191,155 @@ struct Chunk {
 };
 
 /**
- * Local variable in a scope
+ * Most values a chunk's frame holds at once, starting from entry values
+ * (the callee and its arguments); code after a return is not counted
  */
-struct Local {
+size_t stackHeight(const Chunk& chunk, size_t entry);
+
+/**
+ * Register-machine opcodes (three-address code over frame registers)
+ *
+ * Operands named RK are either a register or, with RK_CONSTANT set, an
+ * index into RegisterChunk::constants. Register 0 of every frame holds
+ * the callee and parameters follow it, mirroring the stack VM's slots.
+ */
+enum class RegOpCode : uint8_t {
+    MOVE,       // R[A] = R[B]
+    LOADK,      // R[A] = K[Bx]
+    LOADNIL,    // R[A] = nil
+    LOADBOOL,   // R[A] = B != 0
+    GETGLOBAL,  // R[A] = G[Bx]
+    SETGLOBAL,  // G[Bx] = RK[A]
+
+    ADD,        // R[A] = RK[B] + RK[C]
+    SUB,        // R[A] = RK[B] - RK[C]
+    MUL,        // R[A] = RK[B] * RK[C]
+    DIV,        // R[A] = RK[B] / RK[C]
+    MOD,        // R[A] = RK[B] % RK[C]
+    NEG,        // R[A] = -RK[B]
+    NOT,        // R[A] = !RK[B]
+
+    EQ,         // R[A] = RK[B] == RK[C]
+    NE,         // R[A] = RK[B] != RK[C]
+    LT,         // R[A] = RK[B] < RK[C]
+    LE,         // R[A] = RK[B] <= RK[C]
+    GT,         // R[A] = RK[B] > RK[C]
+    GE,         // R[A] = RK[B] >= RK[C]
+    AND,        // R[A] = RK[B] && RK[C]
+    OR,         // R[A] = RK[B] || RK[C]
+
+    JMP,        // pc += sBx
+    JMPF,       // if !RK[A] then pc += sBx
+    CALL,       // R[A] = R[A](R[A+1], ..., R[A+B])
+    RETURN,     // return RK[A]
+    PRINT,      // print RK[A]
+};
+
+// Number of register opcodes; PRINT must stay the last enumerator
+constexpr size_t REG_OPCODE_COUNT = static_cast<size_t>(RegOpCode::PRINT) + 1;
+
+// RK operands with this bit set name a constant instead of a register
+constexpr uint16_t RK_CONSTANT = 0x8000;
+constexpr uint16_t RK_MAX = RK_CONSTANT - 1;
+
+/**
+ * Register instruction: opcode plus three 16-bit operands
+ * B and C combine into a 32-bit Bx/sBx for constants and jumps
+ */
+struct RegInstruction {
+    RegOpCode op;
+    uint16_t a = 0;
+    uint16_t b = 0;
+    uint16_t c = 0;
+
+    RegInstruction(RegOpCode o, uint16_t ra = 0, uint16_t rb = 0, uint16_t rc = 0)
+        : op(o), a(ra), b(rb), c(rc) {}
+
+    uint32_t bx() const { return b | static_cast<uint32_t>(c) << 16; }
+    int32_t sbx() const { return static_cast<int32_t>(bx()); }
+    void setBx(uint32_t value) {
+        b = static_cast<uint16_t>(value);
+        c = static_cast<uint16_t>(value >> 16);
+    }
+};
+
+static_assert(sizeof(RegInstruction) == 8, "RegInstruction must pack into 64 bits");
+
+/**
+ * Chunk of register bytecode
+ */
+struct RegisterChunk {
+    std::vector<RegInstruction> code;
+    std::vector<Value> constants;
+    size_t registerCount = 1; // Registers the frame needs, including register 0
+};
+
+/**
+ * Compiled user-defined function
+ * Each backend fills in its own code; the other stays empty
+ */
+struct ObjFunction : Obj {
     std::string name;
+    uint8_t arity = 0;
+    Chunk chunk;
+    RegisterChunk registerChunk;
+
+    ObjFunction() : Obj(ObjType::FUNCTION) {}
+};
+
+inline const ObjFunction* Value::asFunction() const {
+    return static_cast<const ObjFunction*>(asObj());
+}
+
+/**
+ * Local variable in a scope; the name views the source being compiled
+ */
+struct Local {
+    std::string_view name;
     size_t depth;
     bool isCaptured;
 };
 
+/**
+ * String hash that also takes a string_view, so a lookup by lexeme does not
+ * build a std::string
+ */
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+/**
+ * Compile-time mapping from global names to dense slots in the VM's
+ * globals vector. Persists across compilations so REPL lines share
+ * globals; the VM itself only ever sees slot indices.
+ */
+struct GlobalTable {
+    std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> slots;
+    std::vector<std::string> names;  // Slot -> name, for diagnostics
+    std::vector<bool> defined;       // Slot has a top-level declaration
+
+    uint32_t slotFor(std::string_view name) {
+        auto it = slots.find(name);
+        if (it != slots.end()) {
+            return it->second;
+        }
+        uint32_t slot = static_cast<uint32_t>(names.size());
+        slots.emplace(name, slot);
+        names.emplace_back(name);
+        defined.push_back(false);
+        return slot;
+    }
+
+    uint32_t define(std::string_view name) {
+        uint32_t slot = slotFor(name);
+        defined[slot] = true;
+        return slot;
+    }
+
+    size_t size() const { return names.size(); }
+};
+
 /**
  * Compiler state
  */
@@ -149,10 +350,35 @@ enum class CompilerState : uint8_t {
 
 /**
  * IR Generator - Compiles AST to bytecode
+ *
+ * While loops get loop-invariant code motion: arithmetic over variables
+ * the loop never writes is computed once into a hidden local before the
+ * loop when it appears in the condition, and the same expression in the
+ * body reuses that local. Globals count as unwritten only in loops that
+ * make no calls. An expression is hoisted only if nothing that can fail
+ * or write a variable is evaluated before it in the condition, so errors
+ * are raised in the same order as without hoisting.
+ *
+ * Calls to small top-level functions (a single `return` of at most
+ * INLINE_BUDGET expression nodes, not calling themselves) are replaced by
+ * the returned expression. Literal and variable arguments are substituted
+ * for the parameters; any other argument is evaluated in order into a
+ * fresh stack slot. Only functions declared once in the program, never
+ * assigned and not defined by an earlier compilation are inlined, so the
+ * callee at each site is known.
+ *
+ * Arithmetic, comparisons and fused compare-and-branch instructions whose
+ * operands TypeInference proves are numbers use the typed OP_NUM_* forms,
+ * which skip the operand tag checks.
  */
 class IRGenerator {
 public:
-    IRGenerator();
+    /**
+     * Strings and functions referenced by compiled chunks are allocated
+     * on the given heap and stay valid for as long as it lives.
+     * Top-level declarations are assigned slots in the given globals table.
+     */
+    IRGenerator(Heap& heap, GlobalTable& globals);
     ~IRGenerator() = default;
 
     /**
@@ -175,25 +401,97 @@ public:
      */
     bool hadError() const { return m_hadError; }
 
+    /**
+     * Peephole counters for every chunk compiled so far
+     */
+    const PeepholeStats& peepholeStats() const { return m_peephole.stats(); }
+
+    /**
+     * Enable or disable inlining of small functions (on by default); code
+     * compiled with it keeps calling the definitions it saw, so it must be
+     * off when later compilations may redefine those functions
+     */
+    void setInlining(bool enabled) { m_inlining = enabled; }
+
 private:
+    Heap& m_heap;
+    GlobalTable& m_globals;
+    std::vector<uint32_t> m_pendingGlobals; // Referenced before any declaration
+    std::unordered_set<uint32_t> m_declaredGlobals; // Declared by this compilation; later REPL lines may redeclare
     Chunk m_chunk;
+    Peephole m_peephole;
     std::vector<Local> m_locals;
     size_t m_scopeDepth = 0;
+    std::unordered_map<const Expr*, uint32_t> m_hoisted; // Loop-invariant expression -> hidden local
+    std::deque<std::string> m_hiddenNames;               // Hidden local names, shared by every loop
+    size_t m_temps = 0;                                  // Operand stack values above the locals
+    TypeInference m_types;
     bool m_hadError = false;
     std::string m_error;
 
+    /**
+     * Variables a loop assigns or declares; any call may also assign globals
+     */
+    struct LoopWrites {
+        std::unordered_set<std::string_view> names;
+        std::unordered_set<std::string_view> assigned; // Assignment targets only
+        bool calls = false;
+    };
+
+    /**
+     * Top-level function whose body is a single small `return`
+     */
+    struct InlineCandidate {
+        const FunctionStmt* function;
+        Expr* body;
+        bool pure; // No calls or assignments, so globals read by arguments cannot change
+    };
+
+    /**
+     * Function being inlined; each parameter is either a substituted
+     * literal or variable argument, or a fresh local holding the argument
+     */
+    struct InlineFrame {
+        const FunctionStmt* function;
+        std::vector<Expr*> arguments; // Null when the argument lives in a slot
+        std::vector<uint32_t> slots;
+    };
+
+    /**
+     * Storage a variable name refers to; ARGUMENT is a literal substituted for a parameter
+     */
+    struct VariableRef {
+        enum class Kind : uint8_t { LOCAL, GLOBAL, ARGUMENT } kind;
+        uint32_t slot;
+        Expr* argument;
+    };
+
+    bool m_inlining = true;
+    std::unordered_set<std::string_view> m_inlineSafe;                     // Functions never redefined or assigned
+    std::unordered_map<std::string_view, InlineCandidate> m_inlineCandidates;
+    std::vector<InlineFrame> m_inlineFrames;
+
     // Scope management
     void beginScope();
     void endScope();
 
     // Local variable management
-    void declareVariable(const std::string& name);
-    int resolveLocal(const std::string& name);
+    void declareVariable(std::string_view name);
+    int resolveLocal(std::string_view name);
+    VariableRef resolveVariable(std::string_view name, size_t frames);
+    uint32_t resolveGlobal(std::string_view name);
+    void defineGlobal(std::string_view name);
+    void checkGlobalsDefined();
     void markInitialized();
 
     // Bytecode emission
-    void emitByte(OpCode op, uint8_t operand = 0);
+    void emitByte(OpCode op, uint32_t operand = 0);
+    size_t findConstant(const Value& value) const; // Index of an equal constant, or the pool size
+    void emitConstant(Value value);
+    void emitReturn();
     void emitJump(OpCode op);
+    size_t emitConditionJump(Expr* condition);
+    bool emitAddConstant(BinaryExpr* expr);
     void emitLoop(size_t loopStart);
     void patchJump(size_t offset);
 
@@ -218,6 +516,20 @@ private:
     void compilePrintStmt(PrintStmt* stmt);
     void compileBlockStmt(BlockStmt* stmt);
 
+    // Loop-invariant code motion
+    void collectWrites(const Expr* expr, LoopWrites& writes);
+    void collectWrites(const Stmt* stmt, LoopWrites& writes);
+    bool isLoopInvariant(const Expr* expr, const LoopWrites& writes);
+    void findInvariants(Expr* expr, const LoopWrites& writes, bool& observable, std::vector<Expr*>& invariants);
+    void reuseInvariants(Expr* expr, const std::vector<Expr*>& invariants, std::vector<const Expr*>& reused);
+    void reuseInvariants(Stmt* stmt, const std::vector<Expr*>& invariants, std::vector<const Expr*>& reused);
+
+    // Inlining
+    void findInlineSafe(const Program& program);
+    void addInlineCandidate(const FunctionStmt* stmt);
+    const InlineCandidate* findInlineCandidate(const CallExpr* expr);
+    void compileInlineCall(CallExpr* expr, const InlineCandidate& candidate);
+
     // Error handling
     void error(const std::string& message);
 };
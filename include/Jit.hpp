@@ -0,0 +1,137 @@
+#pragma once
+
+#include "IRGenerator.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Native code generation is only implemented for x86-64 on POSIX systems;
+// CMake overrides this with -DMINILANG_JIT=OFF
+#ifndef MINILANG_JIT
+#if defined(__x86_64__) && defined(__unix__)
+#define MINILANG_JIT 1
+#else
+#define MINILANG_JIT 0
+#endif
+#endif
+
+namespace minilang {
+
+/**
+ * Interpreter state handed to native code on entry and read back on exit
+ * Native code works directly on the VM's value stack, so a frame moves
+ * between the interpreter and native code without any state translation
+ */
+struct JitContext {
+    Value* stackTop;          // Updated on exit
+    Value* slots;             // Frame's first stack slot
+    Value* globals;           // VM globals, indexed by slot
+    const Value* constants;   // Chunk constants
+};
+
+/**
+ * Native code for a whole chunk or for one loop trace
+ * A chunk translation has an entry point per bytecode instruction, so the
+ * interpreter can enter at a loop header as well as at the start of the
+ * chunk; a trace has a single entry at its loop header.
+ */
+class JitCode {
+public:
+    JitCode(uint8_t* memory, size_t size, std::vector<uint32_t> entries)
+        : m_memory(memory), m_size(size), m_entries(std::move(entries)) {}
+    ~JitCode();
+
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+
+    /**
+     * Execute from the given entry point until an instruction native code
+     * does not handle (or whose guard fails); returns that instruction's
+     * index so the interpreter can resume there
+     */
+    size_t run(JitContext& context, size_t entry) const;
+
+    size_t size() const { return m_size; }
+
+private:
+    uint8_t* m_memory;               // Start of the mapping; the entry stub lives at offset 0
+    size_t m_size;
+    std::vector<uint32_t> m_entries; // Entry point -> native offset
+};
+
+/**
+ * One instruction executed while recording a loop trace
+ */
+struct TraceStep {
+    uint32_t pc;                          // Instruction index in the chunk
+    OpCode opcode;
+    uint32_t operand;
+    ValueType observed = ValueType::NIL;  // Type read by GET_LOCAL/GET_GLOBAL
+    bool taken = false;                   // Whether a conditional branch jumped
+};
+
+/**
+ * Linear record of one iteration of a loop, from its header back to it
+ */
+struct Trace {
+    uint32_t header = 0;
+    std::vector<TraceStep> steps;
+};
+
+struct JitEncoding;
+
+/**
+ * Baseline template JIT and loop tracer
+ *
+ * Each opcode is translated with a fixed machine-code template. Numeric
+ * paths run natively behind NaN-box type guards; calls, returns, strings,
+ * printing and every guard failure exit back to the interpreter at the
+ * instruction concerned, which executes it and re-enters native code at
+ * the next loop back-edge or call.
+ */
+class Jit {
+public:
+    // Loop back-edges plus calls after which a chunk is compiled
+    static constexpr uint32_t HOT_THRESHOLD = 1000;
+
+    // Back-edges of one loop after which it is traced
+    static constexpr uint32_t HOT_LOOP_THRESHOLD = 50;
+
+    // Longest trace recorded, and failed recordings before a loop is left alone
+    static constexpr size_t TRACE_MAX_STEPS = 1024;
+    static constexpr uint32_t TRACE_MAX_ABORTS = 3;
+
+    Jit() = default;
+    ~Jit() = default;
+
+    /**
+     * Translate a chunk to native code
+     * Returns nullptr when native code is unavailable on this platform or
+     * executable memory cannot be mapped. The result lives as long as the Jit.
+     */
+    const JitCode* compile(const Chunk& chunk);
+
+    /**
+     * Compile a recorded loop iteration into a native loop
+     * Variable types seen while recording are guarded once before the loop
+     * when every write keeps them, so the body needs no type checks; each
+     * recorded branch direction becomes a guard that exits to the
+     * interpreter on the path not taken. Entered at the loop header.
+     */
+    const JitCode* compileTrace(const Chunk& chunk, const Trace& trace);
+
+    /**
+     * Bytes of machine code generated so far
+     */
+    size_t codeSize() const { return m_codeSize; }
+
+private:
+    std::vector<std::unique_ptr<JitCode>> m_code;
+    size_t m_codeSize = 0;
+
+    static JitEncoding encoding();
+    const JitCode* install(std::unique_ptr<JitCode> code);
+};
+
+} // namespace minilang
@@ -2,17 +2,32 @@
 
 #include "Token.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Runs of blanks, identifier characters and digits are classified 16 bytes
+// at a time with SSE2, which every x86-64 target has; CMake overrides this
+// with -DMINILANG_SIMD=OFF
+#ifndef MINILANG_SIMD
+#if defined(__SSE2__)
+#define MINILANG_SIMD 1
+#else
+#define MINILANG_SIMD 0
+#endif
+#endif
+
 namespace minilang {
 
 /**
  * Lexer that tokenizes source code into tokens
- * Optimized for speed with minimal allocations
+ * Optimized for speed with minimal allocations: lexemes are views into
+ * the source, which the caller keeps alive while the tokens are in use.
+ * Whole runs of characters are skipped at once (SSE2 for character
+ * classes, memchr for string and comment terminators).
  */
 class Lexer {
 public:
-    explicit Lexer(std::string source);
+    explicit Lexer(std::string_view source);
     ~Lexer() = default;
 
     /**
@@ -30,30 +45,35 @@ public:
      */
     bool hasMore() const { return !isAtEnd(); }
 
+    /**
+     * Literal values of the tokens returned so far, indexed by Token::literal
+     */
+    const std::vector<Literal>& literals() const { return m_literals; }
+
 private:
-    std::string m_source;
+    std::string_view m_source;
     size_t m_start = 0;
     size_t m_current = 0;
     size_t m_line = 1;
     size_t m_column = 1;
     std::vector<Token> m_tokens;
+    std::vector<Literal> m_literals;
 
     // Helper methods
     bool isAtEnd() const { return m_current >= m_source.size(); }
     char advance() { m_column++; return m_source[m_current++]; }
+    void advanceBy(size_t count) { m_current += count; m_column += count; } // No newlines in the run
+    void advanceLines(size_t count);
     char peek() const { return isAtEnd() ? '\0' : m_source[m_current]; }
     char peekNext() const {
         return (m_current + 1 >= m_source.size()) ? '\0' : m_source[m_current + 1];
     }
     bool match(char expected);
     void skipWhitespace();
-    void skipComment();
 
     Token makeToken(TokenType type) const;
-    Token makeToken(TokenType type, double literal) const;
-    Token makeToken(TokenType type, std::string literal) const;
-    Token makeToken(TokenType type, bool literal) const;
-    Token errorToken(const std::string& message) const;
+    Token makeToken(TokenType type, Literal literal);
+    Token errorToken(std::string message);
 
     // Lexing methods
     Token scanToken();
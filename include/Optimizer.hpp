@@ -0,0 +1,83 @@
+#pragma once
+
+#include "AST.hpp"
+#include <cstddef>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * AST optimizer - Runs between the parser and every backend
+ *
+ * Folds operators whose operands are all literals (arithmetic,
+ * comparisons, string concatenation, logical operators and `!`) and
+ * propagates local `let` bindings with a constant initializer that are
+ * never reassigned. Operations that would raise a runtime error, such as
+ * division by zero or mixing types, are left for the VM to report.
+ *
+ * Dead code is then pruned: branches on a constant condition, loops
+ * whose condition is constant false, statements after a return,
+ * expression statements with no effect, and local `let` bindings that
+ * are never read or assigned (an initializer with effects is kept as an
+ * expression statement). Pruned code is never compiled, so a backend no
+ * longer reports an undefined global that only dead code refers to.
+ *
+ * Globals are not propagated: they outlive the program (the REPL compiles
+ * each line separately) and functions from earlier runs may assign them.
+ */
+class Optimizer {
+public:
+    Optimizer() = default;
+    ~Optimizer() = default;
+
+    /**
+     * Optimize a program in place
+     */
+    void optimize(Program& program);
+
+private:
+    /**
+     * Local binding in scope; `let` is null for parameters and functions,
+     * and `constant` is set once a `let` with a literal initializer (or
+     * none) has been visited, so its initializer sees it as opaque
+     */
+    struct Binding {
+        std::string_view name;
+        size_t depth;
+        const LetStmt* let;
+        bool constant;
+    };
+
+    std::vector<Binding> m_scope;
+    size_t m_depth = 0;
+    std::unordered_set<const LetStmt*> m_assigned;  // Locals written after their declaration
+    std::unordered_set<const LetStmt*> m_read;      // Locals read after propagation
+    bool m_resolving = false;                       // First pass: only record assignments
+
+    // Scope management
+    void beginScope();
+    void endScope();
+    void declare(std::string_view name, const LetStmt* let = nullptr);
+    const Binding* resolve(std::string_view name) const;
+
+    // Traversal
+    void visitStmts(std::vector<std::unique_ptr<Stmt>>& stmts);
+    void visitStmt(Stmt* stmt);
+    void visitFunction(FunctionStmt* stmt);
+    void visitExpr(std::unique_ptr<Expr>& expr);
+
+    // Folding
+    void foldBinary(std::unique_ptr<Expr>& expr);
+    void foldUnary(std::unique_ptr<Expr>& expr);
+
+    // Dead code: a pruned statement is reset to null
+    void pruneStmts(std::vector<std::unique_ptr<Stmt>>& stmts);
+    void pruneStmt(std::unique_ptr<Stmt>& stmt);
+    void pruneBranch(std::unique_ptr<Stmt>& branch);
+    void pruneFunction(FunctionStmt* stmt);
+    bool isPure(const Expr* expr) const;
+};
+
+} // namespace minilang
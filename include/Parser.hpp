@@ -25,7 +25,7 @@ public:
  */
 class Parser {
 public:
-    explicit Parser(const std::vector<Token>& tokens);
+    Parser(const std::vector<Token>& tokens, const std::vector<Literal>& literals);
     ~Parser() = default;
 
     /**
@@ -35,6 +35,7 @@ public:
 
 private:
     const std::vector<Token>& m_tokens;
+    const std::vector<Literal>& m_literals;
     size_t m_current = 0;
 
     // Token consumption
@@ -45,6 +46,7 @@ private:
     bool check(TokenType type) const;
     bool match(std::initializer_list<TokenType> types);
     Token consume(TokenType type, const std::string& message);
+    const Literal* literalOf(const Token& token) const;
 
     // Error handling
     ParseError error(Token token, const std::string& message);
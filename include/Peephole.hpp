@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace minilang {
+
+struct Chunk;
+
+/**
+ * Counters accumulated by the peephole pass
+ */
+struct PeepholeStats {
+    size_t instructions = 0;              // Instructions before the pass
+    size_t removed = 0;                   // Instructions eliminated
+    std::map<std::string, size_t> rules;  // Times each rule fired
+};
+
+/**
+ * Peephole optimizer - Rewrites short instruction windows of a finished chunk
+ *
+ * Window rules come from a table of opcode patterns; jumps to jumps are
+ * threaded and code after an unconditional transfer that no jump reaches
+ * is dropped. A window is only rewritten when no jump lands inside it,
+ * and keeps its first instruction when a jump lands there.
+ * Jump offsets are re-patched and Chunk::lines stays in step with
+ * Chunk::code.
+ */
+class Peephole {
+public:
+    Peephole() = default;
+    ~Peephole() = default;
+
+    /**
+     * Optimize a chunk in place; nested function chunks are optimized when
+     * they are compiled
+     */
+    void optimize(Chunk& chunk);
+
+    /**
+     * Counters for every chunk optimized so far
+     */
+    const PeepholeStats& stats() const { return m_stats; }
+
+private:
+    PeepholeStats m_stats;
+};
+
+} // namespace minilang
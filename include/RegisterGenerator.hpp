@@ -0,0 +1,93 @@
+#pragma once
+
+#include "AST.hpp"
+#include "IRGenerator.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * Register backend - Compiles AST to three-address register bytecode
+ *
+ * Locals live in fixed registers (their slot index) and temporaries are
+ * allocated above them in stack order, so operands are read in place
+ * instead of being pushed and popped.
+ */
+class RegisterGenerator {
+public:
+    /**
+     * Strings and functions are allocated on the given heap; top-level
+     * declarations are assigned slots in the given globals table
+     */
+    RegisterGenerator(Heap& heap, GlobalTable& globals);
+    ~RegisterGenerator() = default;
+
+    /**
+     * Compile a program to register bytecode
+     */
+    RegisterChunk compile(const Program& program);
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Check if compilation was successful
+     */
+    bool hadError() const { return m_hadError; }
+
+private:
+    Heap& m_heap;
+    GlobalTable& m_globals;
+    std::vector<uint32_t> m_pendingGlobals; // Referenced before any declaration
+    std::unordered_set<uint32_t> m_declaredGlobals; // Declared by this compilation; later REPL lines may redeclare
+    RegisterChunk m_chunk;
+    std::vector<Local> m_locals;            // Local i lives in register i
+    size_t m_scopeDepth = 0;
+    uint16_t m_nextRegister = 0;            // First free temporary register
+    bool m_hadError = false;
+    std::string m_error;
+
+    // Scope and register management
+    void beginScope();
+    void endScope();
+    void declareLocal(std::string_view name);
+    int resolveLocal(std::string_view name);
+    uint32_t resolveGlobal(std::string_view name);
+    uint32_t defineGlobal(std::string_view name);
+    void checkGlobalsDefined();
+    uint16_t allocRegister();
+
+    // Bytecode emission
+    void emit(RegOpCode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+    void emitBx(RegOpCode op, uint16_t a, uint32_t bx);
+    uint16_t makeConstant(Value value);
+    size_t emitJump(RegOpCode op, uint16_t a = 0);
+    void patchJump(size_t at);
+    void emitLoop(size_t loopStart);
+
+    // Expression compilation
+    void compileInto(Expr* expr, uint16_t target);
+    uint16_t compileOperand(Expr* expr, bool mayBeClobbered = false);
+    void compileBinaryExpr(BinaryExpr* expr, uint16_t target);
+    void compileCallExpr(CallExpr* expr, uint16_t target);
+    void compileAssign(AssignExpr* expr, int target);
+
+    // Statement compilation
+    void compileStmt(Stmt* stmt);
+    void compileLetStmt(LetStmt* stmt);
+    void compileFunctionStmt(FunctionStmt* stmt);
+    void compileIfStmt(IfStmt* stmt);
+    void compileWhileStmt(WhileStmt* stmt);
+    void compileBlockStmt(BlockStmt* stmt);
+
+    // Error handling
+    void error(const std::string& message);
+};
+
+} // namespace minilang
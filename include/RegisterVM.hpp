@@ -0,0 +1,88 @@
+#pragma once
+
+#include "VM.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * Activation record for a register chunk being executed
+ */
+struct RegisterFrame {
+    const RegisterChunk* chunk;   // Code and constants of the running function
+    const RegInstruction* ip;     // Next instruction to execute
+    Value* base;                  // Register 0 of this frame (the callee)
+};
+
+/**
+ * Register-based virtual machine
+ * Executes RegisterChunk code over a window of registers per frame;
+ * a callee's window starts at the caller register holding the callee
+ */
+class RegisterVM {
+public:
+    static constexpr size_t FRAMES_MAX = VM::FRAMES_MAX;
+    static constexpr size_t REGISTERS_MAX = VM::STACK_MAX;
+
+    RegisterVM();
+    ~RegisterVM() = default;
+
+    /**
+     * Interpret a chunk of register bytecode
+     */
+    InterpretResult interpret(const RegisterChunk& chunk);
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Set output stream for print statements
+     */
+    void setOutput(std::ostream& output) { m_output = &output; }
+
+    /**
+     * Heap owning every string and function object this VM can reach
+     */
+    Heap& heap() { return m_heap; }
+
+    /**
+     * Name -> slot table for the globals this VM holds
+     */
+    GlobalTable& globals() { return m_globalNames; }
+
+    /**
+     * Instructions executed so far
+     * Only counted when built with MINILANG_PROFILE_OPCODES
+     */
+    uint64_t executedCount() const { return m_executed; }
+
+private:
+    Heap m_heap;
+    GlobalTable m_globalNames;
+    std::vector<Value> m_globals; // Indexed by GlobalTable slot
+    std::unique_ptr<Value[]> m_registers;
+    RegisterFrame m_frames[FRAMES_MAX];
+    size_t m_frameCount = 0;
+    std::string m_error;
+    std::ostream* m_output = &std::cout;
+    uint64_t m_executed = 0;
+
+    bool hasRegisterRoom(const Value* base, const RegisterChunk& chunk) const {
+        return chunk.registerCount <= REGISTERS_MAX - static_cast<size_t>(base - m_registers.get());
+    }
+
+    // Calls
+    bool call(Value* base, uint16_t argCount);
+
+    // Free strings no register of a live frame or global holds
+    void collectGarbage();
+
+    void runtimeError(const std::string& message);
+};
+
+} // namespace minilang
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "Value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * Static type of an SSA value
+ * NONE is the bottom of the lattice (no value seen yet) and ANY the top
+ */
+enum class SSAType : uint8_t {
+    NONE,
+    NIL,
+    BOOL,
+    NUMBER,
+    STRING,
+    FUNCTION,
+    ANY,
+};
+
+/**
+ * SSA instruction kinds
+ */
+enum class SSAOp : uint8_t {
+    // Values without operands
+    PARAM,       // Frame slot `index` on entry; slot 0 holds the callee
+    CONST,       // SSAFunction::constants[index]
+    FUNCTION,    // SSAFunction::functions[index]
+    GET_GLOBAL,  // Global slot `index`
+
+    // Merges; operands follow the block's predecessors
+    PHI,
+
+    // Arithmetic
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    NEG,
+
+    // Comparison
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+
+    // Logical (both operands are always evaluated)
+    NOT,
+    AND,
+    OR,
+
+    // Effects
+    CALL,        // operands: callee, arguments...
+    SET_GLOBAL,  // Global slot `index` = operand 0
+    PRINT,
+
+    // Terminators
+    JUMP,        // -> targets[0]
+    BRANCH,      // operand 0 truthy ? targets[0] : targets[1]
+    RETURN,
+};
+
+/**
+ * Name of an SSA opcode in dumps
+ */
+const char* ssaOpName(SSAOp op);
+
+/**
+ * Name of an SSA type in dumps
+ */
+const char* ssaTypeName(SSAType type);
+
+/**
+ * Least upper bound of two types
+ */
+SSAType joinTypes(SSAType a, SSAType b);
+
+/**
+ * Opcode ends a basic block
+ */
+bool isTerminator(SSAOp op);
+
+/**
+ * Opcode defines a value other instructions may use
+ */
+bool hasResult(SSAOp op);
+
+/**
+ * Opcode has no side effects and never raises a runtime error, so it may be
+ * dropped when unused (GET_GLOBAL still observes stores and calls)
+ */
+bool isPure(SSAOp op);
+
+/**
+ * SSA instruction; its id is its index in SSAFunction::values
+ */
+struct SSAInstr {
+    SSAOp op;
+    SSAType type = SSAType::NONE;
+    uint32_t block = 0;              // Block that contains the instruction
+    uint32_t index = 0;              // Slot, constant or function index, depending on op
+    std::vector<uint32_t> operands;  // Value ids
+    std::vector<uint32_t> targets;   // Successor blocks of JUMP and BRANCH
+};
+
+/**
+ * Basic block: phis first, then ordinary instructions, then one terminator
+ */
+struct SSABlock {
+    std::vector<uint32_t> instrs;
+    std::vector<uint32_t> preds;     // Phi operands follow this order
+};
+
+/**
+ * A function (or the top-level script) in SSA form
+ * Block 0 is the entry and has no predecessors
+ */
+struct SSAFunction {
+    std::string name;
+    uint8_t arity = 0;
+    std::vector<SSABlock> blocks;
+    std::vector<SSAInstr> values;
+    std::vector<Value> constants;
+    std::vector<std::unique_ptr<SSAFunction>> functions;  // Nested declarations
+
+    /**
+     * Append a new instruction to a block and return its id
+     */
+    uint32_t append(uint32_t block, SSAOp op, std::vector<uint32_t> operands = {}, uint32_t index = 0);
+
+    /**
+     * Add an operand-less phi after the block's existing phis and return its id
+     */
+    uint32_t addPhi(uint32_t block);
+
+    /**
+     * Add a new empty block and return its id
+     */
+    uint32_t addBlock();
+
+    /**
+     * Successors of a block (the targets of its terminator)
+     */
+    const std::vector<uint32_t>& successors(uint32_t block) const;
+};
+
+/**
+ * Blocks reachable from the entry in reverse postorder; the first target
+ * of a branch is laid out before the second
+ */
+std::vector<uint32_t> reversePostorder(const SSAFunction& function);
+
+/**
+ * Immediate dominator of every block (the entry is its own; unreachable
+ * blocks get UINT32_MAX)
+ */
+std::vector<uint32_t> immediateDominators(const SSAFunction& function);
+
+/**
+ * Does block a dominate block b, given immediateDominators()
+ */
+bool dominates(const std::vector<uint32_t>& idom, uint32_t a, uint32_t b);
+
+/**
+ * Number of times each value appears as an operand of a live instruction
+ */
+std::vector<uint32_t> useCounts(const SSAFunction& function);
+
+/**
+ * Replace every use of one value with another
+ */
+void replaceUses(SSAFunction& function, uint32_t from, uint32_t to);
+
+/**
+ * Drop blocks the entry cannot reach, along with their phi operands, and
+ * renumber the rest
+ */
+void removeUnreachableBlocks(SSAFunction& function);
+
+/**
+ * Replace phis whose operands are all the same value (or the phi itself)
+ */
+void removeTrivialPhis(SSAFunction& function);
+
+/**
+ * Insert an empty block on every edge from a block with several successors
+ * to a block with phis, so phi copies have a place to go
+ */
+void splitCriticalEdges(SSAFunction& function);
+
+/**
+ * Recompute every value's type from its operands; phis start at NONE and
+ * rise to a fixpoint
+ */
+void inferTypes(SSAFunction& function);
+
+/**
+ * Check structural invariants and that definitions dominate their uses
+ * Returns an empty string when the function (and its nested functions)
+ * are well formed, otherwise a description of the first problem
+ */
+std::string verifySSA(const SSAFunction& function);
+
+/**
+ * Textual listing of a function and its nested functions
+ */
+std::string dumpSSA(const SSAFunction& function);
+
+} // namespace minilang
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "AST.hpp"
+#include "IRGenerator.hpp"
+#include "SSA.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace minilang {
+
+/**
+ * SSA builder - Translates the AST into SSA form
+ *
+ * Uses on-the-fly construction (Braun et al., "Simple and Efficient
+ * Construction of Static Single Assignment Form"): local variables are
+ * never stored, reads walk back through predecessors and place phis only
+ * where definitions meet, and loop headers get their phis completed once
+ * the back-edge is known. Globals stay explicit loads and stores.
+ *
+ * Scoping and global resolution follow IRGenerator, so a program is
+ * accepted or rejected the same way by both.
+ */
+class SSABuilder {
+public:
+    /**
+     * String and function constants are allocated on the given heap;
+     * top-level declarations are assigned slots in the given globals table
+     */
+    SSABuilder(Heap& heap, GlobalTable& globals);
+    ~SSABuilder() = default;
+
+    /**
+     * Build the top-level script; nested function declarations become
+     * SSAFunction::functions
+     */
+    std::unique_ptr<SSAFunction> build(const Program& program);
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Check if building was successful
+     */
+    bool hadError() const { return m_hadError; }
+
+private:
+    /**
+     * Local variable in scope, numbered per function
+     */
+    struct ScopedVariable {
+        std::string_view name;
+        size_t depth;
+        uint32_t variable;
+    };
+
+    /**
+     * Construction state of the function being built
+     */
+    struct FunctionState {
+        SSAFunction* function = nullptr;
+        uint32_t current = 0;                                         // Block receiving instructions
+        std::vector<ScopedVariable> scope;
+        size_t scopeDepth = 0;
+        uint32_t variableCount = 0;
+        std::vector<std::unordered_map<uint32_t, uint32_t>> defs;     // Block -> variable -> value
+        std::vector<std::unordered_map<uint32_t, uint32_t>> pending;  // Incomplete phis of unsealed blocks
+        std::vector<bool> sealed;
+    };
+
+    Heap& m_heap;
+    GlobalTable& m_globals;
+    std::vector<uint32_t> m_pendingGlobals; // Referenced before any declaration
+    std::unordered_set<uint32_t> m_declaredGlobals; // Declared by this compilation; later REPL lines may redeclare
+    FunctionState m_state;
+    bool m_hadError = false;
+    std::string m_error;
+
+    // Blocks and instructions
+    uint32_t newBlock();
+    void addEdge(uint32_t from, uint32_t to);
+    void sealBlock(uint32_t block);
+    bool terminated() const;
+    uint32_t emit(SSAOp op, std::vector<uint32_t> operands = {}, uint32_t index = 0);
+    uint32_t emitConstant(Value value);
+    void emitJump(uint32_t target);
+    void emitBranch(uint32_t condition, uint32_t ifTrue, uint32_t ifFalse);
+    void startUnreachable();
+
+    // Variables
+    void beginScope();
+    void endScope();
+    uint32_t declareLocal(std::string_view name);
+    int resolveLocal(std::string_view name) const;
+    uint32_t resolveGlobal(std::string_view name);
+    uint32_t defineGlobal(std::string_view name);
+    void checkGlobalsDefined();
+    void writeVariable(uint32_t variable, uint32_t block, uint32_t value);
+    uint32_t readVariable(uint32_t variable, uint32_t block);
+    uint32_t readVariableRecursive(uint32_t variable, uint32_t block);
+    void addPhiOperands(uint32_t variable, uint32_t phi);
+
+    // Expressions; each returns the value it computes
+    uint32_t buildExpr(Expr* expr);
+    uint32_t buildBinaryExpr(BinaryExpr* expr);
+    uint32_t buildUnaryExpr(UnaryExpr* expr);
+    uint32_t buildLiteralExpr(LiteralExpr* expr);
+    uint32_t buildVariableExpr(VariableExpr* expr);
+    uint32_t buildAssignExpr(AssignExpr* expr);
+    uint32_t buildCallExpr(CallExpr* expr);
+
+    // Statements
+    void buildStmt(Stmt* stmt);
+    void buildLetStmt(LetStmt* stmt);
+    void buildFunctionStmt(FunctionStmt* stmt);
+    void buildIfStmt(IfStmt* stmt);
+    void buildWhileStmt(WhileStmt* stmt);
+    void buildReturnStmt(ReturnStmt* stmt);
+    void buildBlockStmt(BlockStmt* stmt);
+
+    // Clean-up shared by the script and every function
+    void finishFunction();
+
+    // Error handling
+    void error(const std::string& message);
+};
+
+} // namespace minilang
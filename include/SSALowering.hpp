@@ -0,0 +1,61 @@
+#pragma once
+
+#include "IRGenerator.hpp"
+#include "Peephole.hpp"
+#include "SSA.hpp"
+#include <string>
+
+namespace minilang {
+
+/**
+ * SSA lowering - Translates SSA back into stack bytecode
+ *
+ * A value used once, by the next instructions of its own block in stack
+ * order, is left on the operand stack as part of its user's expression
+ * tree; every other value gets a frame slot. Slots come from a liveness-
+ * based interference graph: phis are coalesced with their operands when
+ * they do not interfere, and the remaining phi moves are sequenced as
+ * parallel copies at the end of each predecessor. Frame slots beyond the
+ * parameters are reserved with OP_NIL on entry.
+ *
+ * The resulting chunks go through the same peephole pass as IRGenerator's.
+ */
+class SSALowering {
+public:
+    /**
+     * Functions created for nested declarations are allocated on the given heap
+     */
+    explicit SSALowering(Heap& heap) : m_heap(heap) {}
+    ~SSALowering() = default;
+
+    /**
+     * Lower a script and its nested functions; critical edges are split in place
+     */
+    Chunk lower(SSAFunction& function);
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Check if lowering was successful
+     */
+    bool hadError() const { return m_hadError; }
+
+    /**
+     * Peephole counters for every chunk lowered so far
+     */
+    const PeepholeStats& peepholeStats() const { return m_peephole.stats(); }
+
+private:
+    Heap& m_heap;
+    Peephole m_peephole;
+    bool m_hadError = false;
+    std::string m_error;
+
+    // Error handling
+    void error(const std::string& message);
+};
+
+} // namespace minilang
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace minilang {
+
+/**
+ * Read-only view of a source file's contents
+ * On POSIX systems the file is memory-mapped, so the lexer tokenizes the
+ * page cache directly instead of a heap copy; elsewhere it is read into a
+ * buffer. Token lexemes view this memory: keep the file open until the
+ * program compiled from it no longer needs them.
+ */
+class SourceFile {
+public:
+    SourceFile() = default;
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    /**
+     * Open a file, replacing any open one; false on error
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Release the file's contents
+     */
+    void close();
+
+    /**
+     * The file's contents; empty when nothing is open
+     */
+    std::string_view text() const { return m_text; }
+
+    /**
+     * Get the last error message
+     */
+    const std::string& getError() const { return m_error; }
+
+    /**
+     * Check if there was an error
+     */
+    bool hadError() const { return !m_error.empty(); }
+
+private:
+    std::string_view m_text;
+    void* m_mapping = nullptr; // Mapped pages, null when m_buffer holds the text
+    size_t m_mappingSize = 0;
+    std::string m_buffer;
+    std::string m_error;
+
+    bool error(const std::string& message);
+};
+
+} // namespace minilang
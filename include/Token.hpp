@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <variant>
 
 namespace minilang {
@@ -68,28 +69,32 @@ enum class TokenType : uint8_t {
 using Literal = std::variant<double, std::string, bool>;
 
 /**
- * Token representing a lexical unit
+ * Token representing a lexical unit, packed into 32 bytes
+ *
+ * The lexeme is a view into the source buffer, which must outlive every
+ * token (and AST node) made from it. Literal values live in a side table
+ * owned by the lexer: number and string tokens, and error tokens whose
+ * message is the literal, hold an index into it.
  */
 struct Token {
-    TokenType type;
-    std::string lexeme;
-    size_t line;
-    size_t column;
-    std::variant<std::monostate, double, std::string, bool> literal;
+    static constexpr uint32_t NO_LITERAL = UINT32_MAX;
 
-    Token() = default;
-
-    Token(TokenType t, std::string lex, size_t l, size_t c)
-        : type(t), lexeme(std::move(lex)), line(l), column(c), literal(std::monostate{}) {}
+    const char* start = nullptr;
+    uint32_t length = 0;
+    uint32_t line = 0;
+    uint32_t column = 0;
+    uint32_t literal = NO_LITERAL; // Index into the lexer's literal table
+    TokenType type = TokenType::EOF_TOKEN;
 
-    Token(TokenType t, std::string lex, size_t l, size_t c, double lit)
-        : type(t), lexeme(std::move(lex)), line(l), column(c), literal(lit) {}
+    Token() = default;
 
-    Token(TokenType t, std::string lex, size_t l, size_t c, std::string lit)
-        : type(t), lexeme(std::move(lex)), line(l), column(c), literal(std::move(lit)) {}
+    Token(TokenType t, std::string_view lex, uint32_t l, uint32_t c, uint32_t lit = NO_LITERAL)
+        : start(lex.data()), length(static_cast<uint32_t>(lex.size())), line(l), column(c), literal(lit), type(t) {}
 
-    Token(TokenType t, std::string lex, size_t l, size_t c, bool lit)
-        : type(t), lexeme(std::move(lex)), line(l), column(c), literal(lit) {}
+    /**
+     * Source text of the token
+     */
+    std::string_view lexeme() const { return {start, length}; }
 
     /**
      * Get the token type as a string for debugging
@@ -97,4 +102,6 @@ struct Token {
     std::string typeString() const;
 };
 
+static_assert(sizeof(Token) == 32, "Token must stay packed");
+
 } // namespace minilang
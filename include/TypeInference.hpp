@@ -0,0 +1,136 @@
+#pragma once
+
+#include "AST.hpp"
+#include "Value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace minilang {
+
+struct GlobalTable;
+
+/**
+ * Set of value types, one bit per ValueType; numbers are split in two
+ * by whether their value is integral
+ */
+using TypeSet = uint8_t;
+
+constexpr TypeSet typeBit(ValueType type) {
+    return static_cast<TypeSet>(1u << static_cast<uint8_t>(type));
+}
+
+constexpr TypeSet TYPE_NIL = typeBit(ValueType::NIL);
+constexpr TypeSet TYPE_BOOL = typeBit(ValueType::BOOL);
+constexpr TypeSet TYPE_FRACTIONAL = typeBit(ValueType::NUMBER); // Finite number with a fractional part
+constexpr TypeSet TYPE_STRING = typeBit(ValueType::STRING);
+constexpr TypeSet TYPE_FUNCTION = typeBit(ValueType::FUNCTION);
+constexpr TypeSet TYPE_INTEGER = TYPE_FUNCTION << 1; // Integral number, or infinity/NaN after overflow
+constexpr TypeSet TYPE_NUMBER = TYPE_FRACTIONAL | TYPE_INTEGER;
+constexpr TypeSet TYPE_ANY = TYPE_NIL | TYPE_BOOL | TYPE_NUMBER | TYPE_STRING | TYPE_FUNCTION;
+
+/**
+ * Static type inference - Finds the expressions that always produce a number
+ * and the numbers that are always integral
+ *
+ * A flow-sensitive pass over the AST: each variable carries the set of
+ * types it may hold at every point of the program, branches join their
+ * outcomes and loops are iterated to a fixed point. Every expression is
+ * annotated with the types it may produce on any visit. An operator that
+ * only accepts numbers narrows a variable operand to a number once it has
+ * succeeded, since the VM stops on the error otherwise. Integer literals
+ * stay integral through +, -, * and %, which never produce a fraction
+ * from integral operands (overflow goes to infinity, not a fraction).
+ *
+ * Parameters, call results and globals read inside functions are unknown.
+ * Top-level code tracks globals until a call that may assign them: any
+ * global assigned in a function body, or defined by an earlier compilation
+ * (whose functions this pass cannot see).
+ */
+class TypeInference {
+public:
+    TypeInference() = default;
+    ~TypeInference() = default;
+
+    /**
+     * Infer types for a program; globals defined so far count as written by every call
+     */
+    void infer(const Program& program, const GlobalTable& globals);
+
+    /**
+     * Forget every annotation
+     */
+    void clear();
+
+    /**
+     * Types an expression may produce; TYPE_ANY for expressions never analyzed
+     */
+    TypeSet typeOf(const Expr* expr) const;
+
+    /**
+     * Whether an expression is proven to produce a number
+     */
+    bool isNumber(const Expr* expr) const {
+        TypeSet type = typeOf(expr);
+        return type != 0 && (type & ~TYPE_NUMBER) == 0;
+    }
+
+    /**
+     * Whether an expression is proven to produce an integral number
+     */
+    bool isInteger(const Expr* expr) const { return typeOf(expr) == TYPE_INTEGER; }
+
+private:
+    /**
+     * Local variable in scope and the types it may hold
+     */
+    struct Binding {
+        std::string_view name;
+        size_t depth;
+        TypeSet type;
+    };
+
+    /**
+     * Abstract state at one program point; globals absent from the map may hold anything
+     */
+    struct State {
+        std::vector<Binding> locals;
+        std::unordered_map<std::string_view, TypeSet> globals;
+
+        bool operator==(const State& other) const;
+    };
+
+    std::unordered_map<const Expr*, TypeSet> m_types;
+    std::unordered_set<std::string_view> m_clobbered; // Globals a call may assign
+    State m_state;
+    size_t m_depth = 0;
+    bool m_trackGlobals = true; // False inside function bodies
+
+    // Scope management
+    void beginScope();
+    void endScope();
+    void declare(std::string_view name, TypeSet type);
+    Binding* resolve(std::string_view name);
+
+    // Variable types
+    TypeSet load(std::string_view name);
+    void store(std::string_view name, TypeSet type);
+    void narrow(const Expr* operand, TypeSet type);
+
+    // Joins another state into the current one
+    void join(const State& other);
+
+    // Traversal
+    void collectClobbered(const Stmt* stmt, bool inFunction);
+    void collectClobbered(const Expr* expr, bool inFunction);
+    void visitStmts(const std::vector<std::unique_ptr<Stmt>>& stmts);
+    void visitStmt(const Stmt* stmt);
+    void visitFunction(const FunctionStmt* stmt);
+    TypeSet visitExpr(const Expr* expr);
+    TypeSet visitBinary(const BinaryExpr* expr);
+};
+
+} // namespace minilang
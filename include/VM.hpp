@@ -1,13 +1,39 @@
 #pragma once
 
 #include "IRGenerator.hpp"
+#include "Jit.hpp"
+#include <algorithm>
 #include <iostream>
-#include <stack>
+#include <memory>
 #include <string>
 #include <vector>
 
+// Dispatch through a jump table of label addresses where the compiler
+// supports it; CMake overrides this with -DMINILANG_COMPUTED_GOTO=OFF
+#ifndef MINILANG_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define MINILANG_COMPUTED_GOTO 1
+#else
+#define MINILANG_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Count executed opcode pairs to guide superinstruction selection
+#ifndef MINILANG_PROFILE_OPCODES
+#define MINILANG_PROFILE_OPCODES 0
+#endif
+
 namespace minilang {
 
+/**
+ * Activation record for a chunk being executed
+ */
+struct CallFrame {
+    const Chunk* chunk;      // Code and constants of the running function
+    Instruction* ip;         // Next instruction to execute
+    Value* slots;            // First stack slot owned by this frame (the callee)
+};
+
 /**
  * Interpret result
  */
@@ -23,6 +49,12 @@ enum class InterpretResult : uint8_t {
  */
 class VM {
 public:
+    static constexpr size_t FRAMES_MAX = 256;
+    static constexpr size_t STACK_MAX = FRAMES_MAX * (UINT8_MAX + 1);
+
+    // Type misses after which a generic op stops re-specializing itself
+    static constexpr uint32_t QUICKEN_MISS_LIMIT = 4;
+
     VM();
     ~VM() = default;
 
@@ -41,27 +73,105 @@ public:
      */
     void setOutput(std::ostream& output) { m_output = &output; }
 
+    /**
+     * Heap owning every string and function object this VM can reach
+     */
+    Heap& heap() { return m_heap; }
+
+    /**
+     * Name -> slot table for the globals this VM holds
+     */
+    GlobalTable& globals() { return m_globalNames; }
+
+    /**
+     * Print the most frequent executed opcode pairs
+     * Only populated when built with MINILANG_PROFILE_OPCODES
+     */
+    void dumpOpcodeProfile(std::ostream& out, size_t limit = 20) const;
+
+    /**
+     * Instructions executed so far
+     * Only counted when built with MINILANG_PROFILE_OPCODES
+     */
+    uint64_t executedCount() const;
+
+    /**
+     * Turn native compilation of hot chunks on or off
+     * On by default where the JIT is available
+     */
+    void setJitEnabled(bool enabled) { m_jitEnabled = enabled && MINILANG_JIT; }
+
+    /**
+     * Native code generated for this VM's hot chunks
+     */
+    const Jit& jit() const { return m_jit; }
+
 private:
-    std::stack<Value> m_stack;
-    size_t m_ip = 0; // Instruction pointer
-    const Chunk* m_chunk = nullptr;
+    Heap m_heap;
+    GlobalTable m_globalNames;
+    std::vector<Value> m_globals; // Indexed by GlobalTable slot
+    std::unique_ptr<Value[]> m_stack;
+    Value* m_stackTop = nullptr;
+    CallFrame m_frames[FRAMES_MAX];
+    size_t m_frameCount = 0;
     std::string m_error;
     std::ostream* m_output = &std::cout;
+    Jit m_jit;
+    bool m_jitEnabled = MINILANG_JIT;
+
+#if MINILANG_PROFILE_OPCODES
+    // Opcode pair profile, indexed by previous * OPCODE_COUNT + current
+    std::vector<uint64_t> m_opcodePairs = std::vector<uint64_t>(OPCODE_COUNT * OPCODE_COUNT);
+    OpCode m_lastOpcode = OpCode::OP_RETURN;
+    void recordOpcode(OpCode op) {
+        m_opcodePairs[static_cast<size_t>(m_lastOpcode) * OPCODE_COUNT + static_cast<size_t>(op)]++;
+        m_lastOpcode = op;
+    }
+#endif
 
     // Stack operations
-    void push(Value value);
-    Value pop();
-    Value peek(size_t distance = 0);
-    size_t stackSize() const { return m_stack.size(); }
+    void push(Value value) { *m_stackTop++ = value; }
+    Value pop() { return *--m_stackTop; }
+    Value peek(size_t distance = 0) const { return m_stackTop[-1 - static_cast<ptrdiff_t>(distance)]; }
+    size_t stackSize() const { return static_cast<size_t>(m_stackTop - m_stack.get()); }
+    void resetStack();
+
+    // Quickening: generic ops keep their type-miss count in the operand
+    static void quicken(Instruction* instruction, OpCode specialized) {
+        if (instruction->operand < QUICKEN_MISS_LIMIT) {
+            instruction->opcode = specialized;
+        }
+    }
+    static void deoptimize(Instruction* instruction, OpCode generic) {
+        instruction->opcode = generic;
+        instruction->operand = instruction->operand + 1;
+    }
+
+    // Native code: compiled once a chunk turns hot, entered at calls and loop back-edges
+    bool nativeReady(const Chunk& chunk) {
+        if (!m_jitEnabled) return false;
+        if (chunk.jit) return true;
+        if (++chunk.hotness != Jit::HOT_THRESHOLD) return false;
+        chunk.jit = m_jit.compile(chunk);
+        return chunk.jit != nullptr;
+    }
+    void runNative(CallFrame* frame);
+
+    // Loop tracing: taken back-edges run, record or fall back to the chunk's native code
+    void loopBackEdge(CallFrame* frame, const Instruction* backEdge);
+    bool recordTrace(CallFrame* frame, size_t backEdge, Trace& trace);
+    void runTrace(CallFrame* frame, const JitCode* code);
 
-    // Instruction fetching
-    Instruction readInstruction();
-    uint8_t readByte();
+    // Calls
+    bool callValue(Value callee, uint8_t argCount);
+    bool hasStackRoom(const Value* slots, const Chunk& chunk) const {
+        size_t height = std::max(chunk.localCount, chunk.stackMax);
+        return height <= STACK_MAX - static_cast<size_t>(slots - m_stack.get());
+    }
 
     // Operations
-    bool isFalsey(const Value& value);
-    bool valuesEqual(const Value& a, const Value& b);
-    void concatenate();
+    void concatenate(Value a, Value b); // Pushes a + b; may collect garbage afterwards
+    void collectGarbage();
     void runtimeError(const std::string& message);
 
     // Binary operations
@@ -70,7 +180,6 @@ private:
 
     // Debug
     void dumpStack();
-    std::string valueToString(const Value& value);
 };
 
 } // namespace minilang
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+namespace minilang {
+
+/**
+ * Value types in the VM
+ */
+enum class ValueType : uint8_t {
+    NIL,
+    BOOL,
+    NUMBER,
+    STRING,
+    FUNCTION,
+};
+
+/**
+ * Heap object kinds referenced from a Value
+ */
+enum class ObjType : uint8_t {
+    STRING,
+    FUNCTION,
+};
+
+/**
+ * Base heap object, linked into the owning Heap for bulk release
+ */
+struct Obj {
+    ObjType type;
+    Obj* next = nullptr;
+
+    explicit Obj(ObjType t) : type(t) {}
+    virtual ~Obj() = default;
+};
+
+/**
+ * Immutable heap string
+ */
+struct ObjString : Obj {
+    std::string chars;
+
+    explicit ObjString(std::string s) : Obj(ObjType::STRING), chars(std::move(s)) {}
+};
+
+struct ObjFunction;
+
+/**
+ * Runtime value, NaN-boxed into a single 64-bit word
+ *
+ * Numbers are stored as raw doubles. Every other value lives in the
+ * payload of a quiet NaN: nil, false, true and the undefined-global
+ * marker use small tags in the low bits, and objects set the sign bit and
+ * store the pointer in the low 48 bits.
+ */
+class Value {
+public:
+    Value() : m_bits(QNAN | TAG_NIL) {}
+    explicit Value(bool b) : m_bits(b ? TRUE_BITS : FALSE_BITS) {}
+    explicit Value(double n) : m_bits(std::bit_cast<uint64_t>(n)) {}
+    explicit Value(Obj* obj) : m_bits(SIGN_BIT | QNAN | reinterpret_cast<uintptr_t>(obj)) {}
+
+    /**
+     * Content of a global slot before its first assignment; programs never see it
+     */
+    static Value undefined() { return Value(QNAN | TAG_UNDEFINED, 0); }
+
+    bool isNil() const { return m_bits == (QNAN | TAG_NIL); }
+    bool isUndefined() const { return m_bits == (QNAN | TAG_UNDEFINED); }
+    bool isBool() const { return (m_bits | 1) == TRUE_BITS; }
+    bool isNumber() const { return (m_bits & QNAN) != QNAN; }
+    bool isObj() const { return (m_bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+    bool isString() const { return isObjType(ObjType::STRING); }
+    bool isFunction() const { return isObjType(ObjType::FUNCTION); }
+
+    bool asBool() const { return m_bits == TRUE_BITS; }
+    double asNumber() const { return std::bit_cast<double>(m_bits); }
+    Obj* asObj() const { return reinterpret_cast<Obj*>(static_cast<uintptr_t>(m_bits & ~(SIGN_BIT | QNAN))); }
+    const std::string& asString() const { return static_cast<ObjString*>(asObj())->chars; }
+    const ObjFunction* asFunction() const; // Defined alongside ObjFunction
+
+    ValueType type() const;
+
+    /**
+     * Identity comparison of the raw encodings
+     */
+    bool sameBits(Value other) const { return m_bits == other.m_bits; }
+
+private:
+    friend class Jit; // Emits type guards against the raw encoding
+
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t TAG_NIL = 1;
+    static constexpr uint64_t TAG_FALSE = 2;
+    static constexpr uint64_t TAG_TRUE = 3;
+    static constexpr uint64_t TAG_UNDEFINED = 4;
+    static constexpr uint64_t FALSE_BITS = QNAN | TAG_FALSE;
+    static constexpr uint64_t TRUE_BITS = QNAN | TAG_TRUE;
+
+    uint64_t m_bits;
+
+    Value(uint64_t bits, int) : m_bits(bits) {}
+    bool isObjType(ObjType t) const { return isObj() && asObj()->type == t; }
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay one machine word");
+
+/**
+ * nil, false and 0 are falsey; everything else is truthy
+ */
+bool isFalsey(Value value);
+
+/**
+ * Language-level equality: same type and same contents
+ */
+bool valuesEqual(Value a, Value b);
+
+/**
+ * Remainder of two integral numbers, b nonzero; same result as std::fmod,
+ * through an int64 division while both fit
+ */
+double integerModulo(double a, double b);
+
+/**
+ * Remainder of any two numbers, b nonzero; same result as std::fmod,
+ * through integerModulo when both are integral
+ */
+double numberModulo(double a, double b);
+
+/**
+ * Format a value the way print shows it
+ */
+std::string valueToString(Value value);
+
+/**
+ * Owner of every heap object created during compilation and execution
+ *
+ * Objects made by the compilers (constants and functions) are released
+ * together when the heap is destroyed. Strings a program builds while it
+ * runs are collectable: once enough bytes of them are allocated, the VM
+ * marks the values its stack, registers and globals hold, and sweep()
+ * frees the unmarked ones. Marks record addresses only and never read the
+ * object, so a stale register that still names a freed string is harmless.
+ */
+class Heap {
+public:
+    // Bytes of runtime strings allocated before the first collection
+    static constexpr size_t FIRST_COLLECTION = 1024 * 1024;
+
+    Heap() = default;
+    ~Heap();
+
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        T* obj = new T(std::forward<Args>(args)...);
+        obj->next = m_objects;
+        m_objects = obj;
+        return obj;
+    }
+
+    ObjString* makeString(std::string chars) { return allocate<ObjString>(std::move(chars)); }
+
+    /**
+     * String built by a running program; freed by the first sweep() that
+     * finds it unmarked
+     */
+    ObjString* makeRuntimeString(std::string chars);
+
+    /**
+     * Enough runtime strings were allocated since the last sweep
+     */
+    bool shouldCollect() const { return m_runtimeBytes >= m_nextCollection; }
+
+    /**
+     * Keep the runtime string a value refers to, if any, through the next sweep
+     */
+    void mark(Value value) {
+        if (value.isObj()) m_marked.insert(value.asObj());
+    }
+
+    /**
+     * Free every runtime string not marked since the last sweep
+     */
+    void sweep();
+
+    /**
+     * Runtime strings currently allocated
+     */
+    size_t runtimeCount() const { return m_runtimeCount; }
+
+private:
+    Obj* m_objects = nullptr;
+    Obj* m_runtime = nullptr; // Collectable strings
+    size_t m_runtimeCount = 0;
+    size_t m_runtimeBytes = 0;
+    size_t m_nextCollection = FIRST_COLLECTION;
+    std::unordered_set<const Obj*> m_marked;
+};
+
+} // namespace minilang
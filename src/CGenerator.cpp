@@ -0,0 +1,770 @@
+#include "CGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+namespace minilang {
+
+/**
+ * Runtime emitted at the top of every generated program
+ * Mirrors the VM: the same truthiness, equality, number formatting and
+ * runtime error messages, reported on stderr with exit status 1.
+ */
+static const char* RUNTIME = R"(#include <math.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ML_FRAMES_MAX 256
+
+/* ML_UNDEFINED marks a global that has not been assigned yet; reads check
+   for it, so it never reaches the other helpers */
+typedef enum { ML_NIL, ML_BOOL, ML_NUMBER, ML_STRING, ML_FUNCTION, ML_UNDEFINED } MlType;
+
+typedef struct MlString {
+    struct MlString* next; /* Collected strings only */
+    bool marked;
+    size_t length;
+    char chars[];
+} MlString;
+
+typedef struct MlFunction MlFunction;
+
+typedef struct MlValue {
+    MlType type;
+    union {
+        bool boolean;
+        double number;
+        const MlString* string;
+        const MlFunction* function;
+    } as;
+} MlValue;
+
+struct MlFunction {
+    const char* name;
+    int arity;
+    MlValue (*code)(const MlValue* args);
+};
+
+static int ml_depth = 1;
+
+static _Noreturn void ml_error(const char* message) {
+    fflush(stdout);
+    fprintf(stderr, "Runtime Error: %s\n", message);
+    exit(1);
+}
+
+static inline MlValue ml_global(MlValue v, const char* name) {
+    if (v.type == ML_UNDEFINED) {
+        fflush(stdout);
+        fprintf(stderr, "Runtime Error: Undefined variable '%s'.\n", name);
+        exit(1);
+    }
+    return v;
+}
+
+static inline MlValue ml_nil(void) { MlValue v; v.type = ML_NIL; v.as.number = 0; return v; }
+static inline MlValue ml_bool(bool b) { MlValue v; v.type = ML_BOOL; v.as.boolean = b; return v; }
+static inline MlValue ml_number(double n) { MlValue v; v.type = ML_NUMBER; v.as.number = n; return v; }
+static inline MlValue ml_function(const MlFunction* f) { MlValue v; v.type = ML_FUNCTION; v.as.function = f; return v; }
+
+/* Strings are immutable. Literals live until exit; strings built at run
+   time are reclaimed by a conservative mark-sweep: one stays alive while
+   a global or any word on the C stack (callee-saved registers included)
+   points into it. */
+#define ML_FIRST_COLLECTION (1024 * 1024)
+
+static MlString* ml_strings = NULL;      /* Every collected string */
+static size_t ml_string_count = 0;
+static size_t ml_string_bytes = 0;
+static size_t ml_next_collection = ML_FIRST_COLLECTION;
+static void* ml_stack_base = NULL;       /* Set in main(), above every frame of the program */
+static MlValue* const* ml_roots = NULL;  /* Null-terminated list of globals */
+
+static MlString* ml_alloc_string(size_t length) {
+    MlString* s = (MlString*)malloc(sizeof(MlString) + length + 1);
+    if (!s) ml_error("Out of memory.");
+    s->next = NULL;
+    s->marked = false;
+    s->length = length;
+    s->chars[length] = '\0';
+    return s;
+}
+
+static int ml_compare_strings(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(MlString* const*)a;
+    uintptr_t y = (uintptr_t)*(MlString* const*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Mark the string, if any, that the word points into */
+static void ml_mark_word(MlString** sorted, size_t count, uintptr_t word) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)sorted[mid] <= word) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return;
+    MlString* s = sorted[lo - 1];
+    if (word <= (uintptr_t)(s->chars + s->length)) s->marked = true;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void ml_collect(void) {
+    /* Spill callee-saved registers into this frame so the scan sees them */
+    jmp_buf registers;
+    setjmp(registers);
+#if defined(__GNUC__)
+    __builtin_unwind_init();
+#endif
+
+    MlString** sorted = (MlString**)malloc(ml_string_count * sizeof(MlString*));
+    if (!sorted) return;
+    size_t count = 0;
+    for (MlString* s = ml_strings; s; s = s->next) sorted[count++] = s;
+    qsort(sorted, count, sizeof(MlString*), ml_compare_strings);
+
+    char* lo = (char*)&registers;
+    char* hi = (char*)ml_stack_base;
+    if (lo > hi) {
+        char* swap = lo;
+        lo = hi;
+        hi = swap;
+    }
+    lo += (sizeof(uintptr_t) - (uintptr_t)lo % sizeof(uintptr_t)) % sizeof(uintptr_t);
+    for (; lo + sizeof(uintptr_t) <= hi; lo += sizeof(uintptr_t)) {
+        uintptr_t word;
+        memcpy(&word, lo, sizeof word);
+        ml_mark_word(sorted, count, word);
+    }
+    for (MlValue* const* root = ml_roots; *root; root++) {
+        if ((*root)->type == ML_STRING) ml_mark_word(sorted, count, (uintptr_t)(*root)->as.string);
+    }
+    free(sorted);
+
+    MlString** link = &ml_strings;
+    while (*link) {
+        MlString* s = *link;
+        if (s->marked) {
+            s->marked = false;
+            link = &s->next;
+            continue;
+        }
+        *link = s->next;
+        ml_string_count--;
+        ml_string_bytes -= sizeof(MlString) + s->length + 1;
+        free(s);
+    }
+    ml_next_collection = ml_string_bytes * 2 > ML_FIRST_COLLECTION ? ml_string_bytes * 2 : ML_FIRST_COLLECTION;
+}
+
+static MlValue ml_string(const char* chars, size_t length) {
+    MlString* s = ml_alloc_string(length);
+    memcpy(s->chars, chars, length);
+    MlValue v;
+    v.type = ML_STRING;
+    v.as.string = s;
+    return v;
+}
+
+static MlValue ml_concat(const MlString* a, const MlString* b) {
+    /* a and b stay live across the collection, so the scan finds them */
+    if (ml_string_bytes >= ml_next_collection) ml_collect();
+    MlString* s = ml_alloc_string(a->length + b->length);
+    s->next = ml_strings;
+    ml_strings = s;
+    ml_string_count++;
+    ml_string_bytes += sizeof(MlString) + s->length + 1;
+    memcpy(s->chars, a->chars, a->length);
+    memcpy(s->chars + a->length, b->chars, b->length);
+    MlValue v;
+    v.type = ML_STRING;
+    v.as.string = s;
+    return v;
+}
+
+static inline bool ml_falsey(MlValue v) {
+    switch (v.type) {
+        case ML_NIL: return true;
+        case ML_BOOL: return !v.as.boolean;
+        case ML_NUMBER: return v.as.number == 0.0;
+        default: return false;
+    }
+}
+
+static inline bool ml_equal(MlValue a, MlValue b) {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case ML_NIL: return true;
+        case ML_BOOL: return a.as.boolean == b.as.boolean;
+        case ML_NUMBER: return a.as.number == b.as.number;
+        case ML_STRING:
+            return a.as.string->length == b.as.string->length &&
+                   memcmp(a.as.string->chars, b.as.string->chars, a.as.string->length) == 0;
+        case ML_FUNCTION: return a.as.function == b.as.function;
+        case ML_UNDEFINED: break;
+    }
+    return false;
+}
+
+static inline void ml_numbers(MlValue a, MlValue b) {
+    if (a.type != ML_NUMBER || b.type != ML_NUMBER) ml_error("Operands must be numbers.");
+}
+
+static inline MlValue ml_add(MlValue a, MlValue b) {
+    if (a.type == ML_NUMBER && b.type == ML_NUMBER) return ml_number(a.as.number + b.as.number);
+    if (a.type == ML_STRING && b.type == ML_STRING) return ml_concat(a.as.string, b.as.string);
+    ml_error("Operands must be two numbers or two strings.");
+}
+
+static inline MlValue ml_sub(MlValue a, MlValue b) { ml_numbers(a, b); return ml_number(a.as.number - b.as.number); }
+static inline MlValue ml_mul(MlValue a, MlValue b) { ml_numbers(a, b); return ml_number(a.as.number * b.as.number); }
+
+static inline MlValue ml_div(MlValue a, MlValue b) {
+    ml_numbers(a, b);
+    if (b.as.number == 0.0) ml_error("Division by zero.");
+    return ml_number(a.as.number / b.as.number);
+}
+
+/* Integral operands (the common case for loop counters) take an integer
+   division instead of libm's fmod */
+static inline MlValue ml_mod(MlValue a, MlValue b) {
+    ml_numbers(a, b);
+    double x = a.as.number;
+    double y = b.as.number;
+    if (y == 0.0) ml_error("Modulo by zero.");
+    if (fabs(x) < 9007199254740992.0 && fabs(y) < 9007199254740992.0 && (double)(int64_t)x == x &&
+        (double)(int64_t)y == y) {
+        return ml_number(copysign((double)((int64_t)x % (int64_t)y), x));
+    }
+    return ml_number(fmod(x, y));
+}
+
+static inline MlValue ml_neg(MlValue a) {
+    if (a.type != ML_NUMBER) ml_error("Operand must be a number.");
+    return ml_number(-a.as.number);
+}
+
+static inline MlValue ml_lt(MlValue a, MlValue b) { ml_numbers(a, b); return ml_bool(a.as.number < b.as.number); }
+static inline MlValue ml_le(MlValue a, MlValue b) { ml_numbers(a, b); return ml_bool(a.as.number <= b.as.number); }
+static inline MlValue ml_gt(MlValue a, MlValue b) { ml_numbers(a, b); return ml_bool(a.as.number > b.as.number); }
+static inline MlValue ml_ge(MlValue a, MlValue b) { ml_numbers(a, b); return ml_bool(a.as.number >= b.as.number); }
+
+static inline MlValue ml_call(MlValue callee, int argc, const MlValue* args) {
+    if (callee.type != ML_FUNCTION) ml_error("Can only call functions.");
+    const MlFunction* f = callee.as.function;
+    if (f->arity != argc) {
+        char message[64];
+        snprintf(message, sizeof message, "Expected %d arguments but got %d.", f->arity, argc);
+        ml_error(message);
+    }
+    if (ml_depth == ML_FRAMES_MAX) ml_error("Stack overflow.");
+    ml_depth++;
+    MlValue result = f->code(args);
+    ml_depth--;
+    return result;
+}
+
+/* Shortest round-trip digits in fixed or exponent form, whichever is
+   shorter, then the VM's trailing-zero trim */
+static void ml_format_number(double x, char* out, size_t size) {
+    if (isnan(x) || isinf(x)) {
+        snprintf(out, size, "%s%s", signbit(x) ? "-" : "", isnan(x) ? "nan" : "inf");
+        return;
+    }
+
+    char sci[32];
+    for (int precision = 0; precision < 17; precision++) {
+        snprintf(sci, sizeof sci, "%.*e", precision, x);
+        if (strtod(sci, NULL) == x) break;
+    }
+
+    const char* p = sci;
+    char fixed[400];
+    size_t n = 0;
+    if (*p == '-') fixed[n++] = *p++;
+
+    char digits[20];
+    int count = 0;
+    for (; *p != 'e'; p++) {
+        if (*p != '.') digits[count++] = *p;
+    }
+    int exponent = atoi(p + 1);
+
+    if (exponent < 0) {
+        fixed[n++] = '0';
+        fixed[n++] = '.';
+        for (int i = -1; i > exponent; i--) fixed[n++] = '0';
+        for (int i = 0; i < count; i++) fixed[n++] = digits[i];
+    } else {
+        for (int i = 0; i < count || i <= exponent; i++) {
+            if (i == exponent + 1) fixed[n++] = '.';
+            fixed[n++] = i < count ? digits[i] : '0';
+        }
+    }
+    fixed[n] = '\0';
+
+    snprintf(out, size, "%s", n <= strlen(sci) ? fixed : sci);
+
+    char* dot = strchr(out, '.');
+    if (dot) {
+        char* end = out + strlen(out);
+        while (end > dot + 1 && end[-1] == '0') end--;
+        if (end == dot + 1) end--;
+        *end = '\0';
+    }
+}
+
+static void ml_print(MlValue v) {
+    char buffer[400];
+    switch (v.type) {
+        case ML_NIL: puts("nil"); break;
+        case ML_BOOL: puts(v.as.boolean ? "true" : "false"); break;
+        case ML_NUMBER:
+            ml_format_number(v.as.number, buffer, sizeof buffer);
+            puts(buffer);
+            break;
+        case ML_STRING:
+            fwrite(v.as.string->chars, 1, v.as.string->length, stdout);
+            putchar('\n');
+            break;
+        case ML_FUNCTION: printf("<fn %s>\n", v.as.function->name); break;
+        case ML_UNDEFINED: break;
+    }
+}
+)";
+
+/**
+ * C string literal with the same bytes as the given string
+ */
+static std::string quote(std::string_view text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20 || c >= 0x7f || c == '?') {
+            // Fixed-width octal cannot run into a following digit (or form a trigraph)
+            out += std::format("\\{:03o}", c);
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+/**
+ * C floating literal for the given number
+ * The shortest round-trip form reads back as the same double; a decimal
+ * point keeps long integral values from being read as integer literals.
+ */
+static std::string number(double value) {
+    if (std::isinf(value)) {
+        return value < 0 ? "-HUGE_VAL" : "HUGE_VAL";
+    }
+
+    std::string text = std::format("{}", value);
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
+}
+
+std::string CGenerator::compile(const Program& program) {
+    m_hadError = false;
+    m_error.clear();
+    m_function = FunctionState();
+    m_declarations.clear();
+    m_definitions.clear();
+    m_strings.clear();
+    m_globals.clear();
+    m_globalRefs.clear();
+    m_functionCount = 0;
+
+    for (const auto& stmt : program) {
+        compileStmt(stmt.get());
+        if (m_hadError) {
+            return "";
+        }
+    }
+
+    checkGlobalsDefined();
+    if (m_hadError) {
+        return "";
+    }
+
+    std::string out = RUNTIME;
+
+    out += "\n/* Globals */\n";
+    for (const std::string& name : m_globals) {
+        out += std::format("static MlValue g_{} = {{ML_UNDEFINED, {{0}}}};\n", name);
+    }
+
+    out += "static MlValue* const ml_global_roots[] = {";
+    for (const std::string& name : m_globals) {
+        out += std::format("&g_{}, ", name);
+    }
+    out += "NULL};\n";
+
+    out += "\n/* String literals */\n";
+    out += std::format("static MlValue ml_literals[{}];\n", std::max<size_t>(m_strings.size(), 1));
+
+    out += "\n/* Functions */\n";
+    out += m_declarations;
+    out += m_definitions;
+
+    out += "\nstatic void ml_main(void) {\n";
+    out += m_function.body;
+    out += "}\n";
+
+    // The script runs in a frame of its own, below the collector's stack base;
+    // the volatile pointer keeps it from being inlined into main()
+    out += "\nint main(void) {\n";
+    out += "    int base;\n";
+    out += "    ml_stack_base = &base;\n";
+    out += "    ml_roots = ml_global_roots;\n";
+    for (size_t i = 0; i < m_strings.size(); i++) {
+        out += std::format("    ml_literals[{}] = ml_string({}, {});\n", i, quote(m_strings[i]), m_strings[i].size());
+    }
+    out += "    void (*volatile run)(void) = ml_main;\n";
+    out += "    run();\n";
+    out += "    return 0;\n}\n";
+    return out;
+}
+
+void CGenerator::beginScope() {
+    m_function.scopeDepth++;
+}
+
+void CGenerator::endScope() {
+    m_function.scopeDepth--;
+
+    while (!m_function.locals.empty() && m_function.locals.back().depth > m_function.scopeDepth) {
+        m_function.locals.pop_back();
+    }
+}
+
+std::string CGenerator::declareLocal(std::string_view name) {
+    for (auto it = m_function.locals.rbegin(); it != m_function.locals.rend(); ++it) {
+        if (it->depth != m_function.scopeDepth) break;
+        if (it->name == name) {
+            error(std::format("Variable '{}' already declared in this scope.", name));
+            return "";
+        }
+    }
+
+    // Every local gets its own C variable, so shadowing needs no care
+    std::string variable = std::format("l{}", m_function.nextLocal++);
+    m_function.locals.push_back({name, m_function.scopeDepth, variable});
+    return variable;
+}
+
+const CGenerator::CLocal* CGenerator::resolveLocal(std::string_view name) const {
+    for (auto it = m_function.locals.rbegin(); it != m_function.locals.rend(); ++it) {
+        if (it->name == name) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+std::string CGenerator::resolveGlobal(std::string_view name) {
+    if (std::find(m_globalRefs.begin(), m_globalRefs.end(), name) == m_globalRefs.end()) {
+        m_globalRefs.emplace_back(name);
+    }
+    return std::format("g_{}", name);
+}
+
+void CGenerator::declareGlobal(std::string_view name) {
+    if (std::find(m_globals.begin(), m_globals.end(), name) != m_globals.end()) {
+        error(std::format("Variable '{}' already declared in this scope.", name));
+        return;
+    }
+    m_globals.emplace_back(name);
+}
+
+void CGenerator::checkGlobalsDefined() {
+    for (const std::string& name : m_globalRefs) {
+        if (std::find(m_globals.begin(), m_globals.end(), name) == m_globals.end()) {
+            error(std::format("Undefined variable: {}", name));
+            return;
+        }
+    }
+}
+
+void CGenerator::line(const std::string& code) {
+    m_function.body.append(static_cast<size_t>(m_function.indent) * 4, ' ');
+    m_function.body += code;
+    m_function.body += '\n';
+}
+
+std::string CGenerator::temp(const std::string& value) {
+    std::string name = std::format("t{}", m_function.nextTemp++);
+    line(std::format("MlValue {} = {};", name, value));
+    return name;
+}
+
+std::string CGenerator::literal(const std::string& value) {
+    auto it = std::find(m_strings.begin(), m_strings.end(), value);
+    size_t index = static_cast<size_t>(it - m_strings.begin());
+    if (it == m_strings.end()) {
+        m_strings.push_back(value);
+    }
+    return std::format("ml_literals[{}]", index);
+}
+
+std::string CGenerator::compileExpr(Expr* expr) {
+    if (!expr) {
+        return temp("ml_nil()");
+    }
+
+    switch (expr->getType()) {
+        case ExprType::Literal: {
+            auto* lit = static_cast<LiteralExpr*>(expr);
+            if (std::holds_alternative<double>(lit->value)) {
+                return temp(std::format("ml_number({})", number(std::get<double>(lit->value))));
+            }
+            if (std::holds_alternative<std::string>(lit->value)) {
+                return temp(literal(std::get<std::string>(lit->value)));
+            }
+            if (std::holds_alternative<bool>(lit->value)) {
+                return temp(std::get<bool>(lit->value) ? "ml_bool(true)" : "ml_bool(false)");
+            }
+            return temp("ml_nil()");
+        }
+        case ExprType::Variable: {
+            // Copied, so a later assignment in the same expression is not observed
+            std::string_view name = static_cast<VariableExpr*>(expr)->name.lexeme();
+            const CLocal* local = resolveLocal(name);
+            if (local) return temp(local->variable);
+            return temp(std::format("ml_global({}, {})", resolveGlobal(name), quote(name)));
+        }
+        case ExprType::Assignment:
+            return compileAssign(static_cast<AssignExpr*>(expr));
+        case ExprType::Binary:
+            return compileBinaryExpr(static_cast<BinaryExpr*>(expr));
+        case ExprType::Unary: {
+            auto* unary = static_cast<UnaryExpr*>(expr);
+            std::string operand = compileExpr(unary->right.get());
+            switch (unary->op.type) {
+                case TokenType::MINUS: return temp(std::format("ml_neg({})", operand));
+                case TokenType::BANG: return temp(std::format("ml_bool(ml_falsey({}))", operand));
+                default:
+                    error(std::format("Unknown unary operator: {}", unary->op.lexeme()));
+                    return operand;
+            }
+        }
+        case ExprType::Call:
+            return compileCallExpr(static_cast<CallExpr*>(expr));
+        case ExprType::Grouping:
+            return compileExpr(static_cast<GroupingExpr*>(expr)->expression.get());
+    }
+
+    return temp("ml_nil()");
+}
+
+std::string CGenerator::compileBinaryExpr(BinaryExpr* expr) {
+    std::string left = compileExpr(expr->left.get());
+    std::string right = compileExpr(expr->right.get());
+
+    auto call = [&](const char* function) { return temp(std::format("{}({}, {})", function, left, right)); };
+    switch (expr->op.type) {
+        case TokenType::PLUS: return call("ml_add");
+        case TokenType::MINUS: return call("ml_sub");
+        case TokenType::STAR: return call("ml_mul");
+        case TokenType::SLASH: return call("ml_div");
+        case TokenType::PERCENT: return call("ml_mod");
+
+        case TokenType::EQUAL_EQUAL: return temp(std::format("ml_bool(ml_equal({}, {}))", left, right));
+        case TokenType::BANG_EQUAL: return temp(std::format("ml_bool(!ml_equal({}, {}))", left, right));
+        case TokenType::LESS: return call("ml_lt");
+        case TokenType::LESS_EQUAL: return call("ml_le");
+        case TokenType::GREATER: return call("ml_gt");
+        case TokenType::GREATER_EQUAL: return call("ml_ge");
+
+        // Both operands are always evaluated, as on the VM
+        case TokenType::AND: return temp(std::format("ml_bool(!ml_falsey({}) && !ml_falsey({}))", left, right));
+        case TokenType::OR: return temp(std::format("ml_bool(!ml_falsey({}) || !ml_falsey({}))", left, right));
+
+        default:
+            error(std::format("Unknown binary operator: {}", expr->op.lexeme()));
+            return left;
+    }
+}
+
+std::string CGenerator::compileCallExpr(CallExpr* expr) {
+    std::string callee = compileExpr(expr->callee.get());
+
+    std::string args;
+    for (const auto& arg : expr->arguments) {
+        args += args.empty() ? "" : ", ";
+        args += compileExpr(arg.get());
+    }
+
+    if (expr->arguments.empty()) {
+        return temp(std::format("ml_call({}, 0, NULL)", callee));
+    }
+    return temp(std::format("ml_call({}, {}, (MlValue[]){{{}}})", callee, expr->arguments.size(), args));
+}
+
+std::string CGenerator::compileAssign(AssignExpr* expr) {
+    std::string value = compileExpr(expr->value.get());
+
+    const CLocal* local = resolveLocal(expr->name.lexeme());
+    line(std::format("{} = {};", local ? local->variable : resolveGlobal(expr->name.lexeme()), value));
+    return value;
+}
+
+void CGenerator::compileStmt(Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            compileExpr(static_cast<ExpressionStmt*>(stmt)->expression.get());
+            break;
+        case StmtType::Let:
+            compileLetStmt(static_cast<LetStmt*>(stmt));
+            break;
+        case StmtType::Function:
+            compileFunctionStmt(static_cast<FunctionStmt*>(stmt));
+            break;
+        case StmtType::If:
+            compileIfStmt(static_cast<IfStmt*>(stmt));
+            break;
+        case StmtType::While:
+            compileWhileStmt(static_cast<WhileStmt*>(stmt));
+            break;
+        case StmtType::Return: {
+            std::string value = compileExpr(static_cast<ReturnStmt*>(stmt)->value.get());
+            // The script's return value is discarded, as on the VM
+            line(m_function.isScript ? "return;" : std::format("return {};", value));
+            break;
+        }
+        case StmtType::Print:
+            line(std::format("ml_print({});", compileExpr(static_cast<PrintStmt*>(stmt)->expression.get())));
+            break;
+        case StmtType::Block:
+            compileBlockStmt(static_cast<BlockStmt*>(stmt));
+            break;
+    }
+}
+
+void CGenerator::compileLetStmt(LetStmt* stmt) {
+    std::string value = compileExpr(stmt->initializer.get());
+
+    if (m_function.scopeDepth == 0) {
+        declareGlobal(stmt->name.lexeme());
+        line(std::format("g_{} = {};", stmt->name.lexeme(), value));
+        return;
+    }
+
+    std::string variable = declareLocal(stmt->name.lexeme());
+    line(std::format("MlValue {} = {};", variable, value));
+}
+
+void CGenerator::compileFunctionStmt(FunctionStmt* stmt) {
+    std::string_view name = stmt->name.lexeme();
+    std::string code = std::format("ml_fn{}_{}", m_functionCount++, name);
+
+    m_declarations += std::format("static MlValue {}(const MlValue* args);\n", code);
+    m_declarations += std::format("static const MlFunction {}_info = {{{}, {}, {}}};\n", code, quote(name),
+                                  stmt->params.size(), code);
+
+    // Compile the body into its own C function with a fresh set of locals
+    FunctionState enclosing = std::move(m_function);
+    m_function = FunctionState();
+
+    m_function.isScript = false;
+
+    // Local 0 holds the function itself, which makes recursion resolve locally
+    std::string self = declareLocal(name);
+    line(std::format("MlValue {} = ml_function(&{}_info);", self, code));
+    line(std::format("(void){};", self));
+
+    beginScope();
+    for (size_t i = 0; i < stmt->params.size(); i++) {
+        std::string variable = declareLocal(stmt->params[i].lexeme());
+        line(std::format("MlValue {} = args[{}];", variable, i));
+    }
+    for (const auto& s : stmt->body) {
+        compileStmt(s.get());
+    }
+    line("return ml_nil();");
+
+    m_definitions += std::format("\nstatic MlValue {}(const MlValue* args) {{\n", code);
+    if (stmt->params.empty()) {
+        m_definitions += "    (void)args;\n";
+    }
+    m_definitions += m_function.body;
+    m_definitions += "}\n";
+    m_function = std::move(enclosing);
+
+    std::string value = std::format("ml_function(&{}_info)", code);
+    if (m_function.scopeDepth == 0) {
+        declareGlobal(name);
+        line(std::format("g_{} = {};", name, value));
+        return;
+    }
+
+    std::string variable = declareLocal(name);
+    line(std::format("MlValue {} = {};", variable, value));
+}
+
+void CGenerator::compileIfStmt(IfStmt* stmt) {
+    std::string condition = compileExpr(stmt->condition.get());
+
+    line(std::format("if (!ml_falsey({})) {{", condition));
+    m_function.indent++;
+    compileStmt(stmt->thenBranch.get());
+    m_function.indent--;
+
+    if (stmt->elseBranch) {
+        line("} else {");
+        m_function.indent++;
+        compileStmt(stmt->elseBranch.get());
+        m_function.indent--;
+    }
+    line("}");
+}
+
+void CGenerator::compileWhileStmt(WhileStmt* stmt) {
+    line("for (;;) {");
+    m_function.indent++;
+
+    std::string condition = compileExpr(stmt->condition.get());
+    line(std::format("if (ml_falsey({})) break;", condition));
+    compileStmt(stmt->body.get());
+
+    m_function.indent--;
+    line("}");
+}
+
+void CGenerator::compileBlockStmt(BlockStmt* stmt) {
+    line("{");
+    m_function.indent++;
+    beginScope();
+    for (const auto& s : stmt->statements) {
+        compileStmt(s.get());
+    }
+    endScope();
+    m_function.indent--;
+    line("}");
+}
+
+void CGenerator::error(const std::string& message) {
+    m_hadError = true;
+    m_error = message;
+}
+
+} // namespace minilang
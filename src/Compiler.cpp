@@ -1,4 +1,10 @@
 #include "Compiler.hpp"
+#include "CGenerator.hpp"
+#include "Optimizer.hpp"
+#include "RegisterGenerator.hpp"
+#include "SSABuilder.hpp"
+#include "SSALowering.hpp"
+#include <format>
 
 namespace minilang {
 
@@ -6,18 +12,27 @@ Compiler::Compiler() {
     m_lexer = nullptr;
     m_parser = nullptr;
     m_irgen = nullptr;
-    m_vm = new VM();
+    m_vm = std::make_unique<VM>();
+    m_regvm = std::make_unique<RegisterVM>();
 }
 
-InterpretResult Compiler::run(const std::string& source) {
-    Chunk chunk = compile(source);
+InterpretResult Compiler::run(std::string_view source) {
+    if (m_backend == Backend::REGISTER) {
+        RegisterChunk chunk = compileRegister(source);
+        if (hadError()) {
+            return InterpretResult::COMPILE_ERROR;
+        }
+        return run(chunk);
+    }
+
+    Chunk chunk = m_backend == Backend::SSA ? compileSSA(source) : compile(source);
     if (hadError()) {
         return InterpretResult::COMPILE_ERROR;
     }
     return run(chunk);
 }
 
-Chunk Compiler::compile(const std::string& source) {
+bool Compiler::parse(std::string_view source, Program& program) {
     m_error.clear();
 
     // Lexical analysis
@@ -27,21 +42,36 @@ Chunk Compiler::compile(const std::string& source) {
     // Check for lexer errors
     for (const auto& token : tokens) {
         if (token.type == TokenType::ERROR) {
-            m_error = std::format("[Line {}] Lexer Error: {}", token.line, token.lexeme);
-            return Chunk();
+            m_error = std::format("[Line {}] Lexer Error: {}", token.line,
+                                  std::get<std::string>(lexer.literals()[token.literal]));
+            return false;
         }
     }
 
     // Parsing
-    Parser parser(tokens);
-    Program program = parser.parse();
+    Parser parser(tokens, lexer.literals());
+    program = parser.parse();
 
     // Check for parse errors (parser synchronizes and continues)
     // In a full implementation, we'd collect all errors
 
+    // AST-level optimization shared by every backend
+    Optimizer optimizer;
+    optimizer.optimize(program);
+    return true;
+}
+
+Chunk Compiler::compile(std::string_view source) {
+    Program program;
+    if (!parse(source, program)) {
+        return Chunk();
+    }
+
     // IR Generation
-    IRGenerator irgen;
+    IRGenerator irgen(m_vm->heap(), m_vm->globals());
+    irgen.setInlining(m_inlining);
     Chunk chunk = irgen.compile(program);
+    m_peepholeStats = irgen.peepholeStats();
 
     if (irgen.hadError()) {
         m_error = irgen.getError();
@@ -51,6 +81,91 @@ Chunk Compiler::compile(const std::string& source) {
     return chunk;
 }
 
+std::unique_ptr<SSAFunction> Compiler::buildSSA(const Program& program) {
+    SSABuilder builder(m_vm->heap(), m_vm->globals());
+    std::unique_ptr<SSAFunction> function = builder.build(program);
+
+    if (builder.hadError()) {
+        m_error = builder.getError();
+        return nullptr;
+    }
+
+    std::string problem = verifySSA(*function);
+    if (!problem.empty()) {
+        m_error = std::format("Internal Error: malformed SSA: {}", problem);
+        return nullptr;
+    }
+
+    return function;
+}
+
+Chunk Compiler::compileSSA(std::string_view source) {
+    Program program;
+    if (!parse(source, program)) {
+        return Chunk();
+    }
+
+    std::unique_ptr<SSAFunction> function = buildSSA(program);
+    if (!function) {
+        return Chunk();
+    }
+
+    SSALowering lowering(m_vm->heap());
+    Chunk chunk = lowering.lower(*function);
+    m_peepholeStats = lowering.peepholeStats();
+
+    if (lowering.hadError()) {
+        m_error = lowering.getError();
+        return Chunk();
+    }
+
+    return chunk;
+}
+
+std::string Compiler::dumpSSA(std::string_view source) {
+    Program program;
+    if (!parse(source, program)) {
+        return "";
+    }
+
+    std::unique_ptr<SSAFunction> function = buildSSA(program);
+    return function ? minilang::dumpSSA(*function) : "";
+}
+
+RegisterChunk Compiler::compileRegister(std::string_view source) {
+    Program program;
+    if (!parse(source, program)) {
+        return RegisterChunk();
+    }
+
+    RegisterGenerator regen(m_regvm->heap(), m_regvm->globals());
+    RegisterChunk chunk = regen.compile(program);
+
+    if (regen.hadError()) {
+        m_error = regen.getError();
+        return RegisterChunk();
+    }
+
+    return chunk;
+}
+
+std::string Compiler::compileToC(std::string_view source) {
+    Program program;
+    if (!parse(source, program)) {
+        return "";
+    }
+
+    CGenerator cgen;
+    std::string code = cgen.compile(program);
+
+    if (cgen.hadError()) {
+        m_error = cgen.getError();
+        return "";
+    }
+
+    return code;
+}
+
 InterpretResult Compiler::run(const Chunk& chunk) {
     if (!m_vm) {
         m_error = "VM not initialized";
@@ -65,4 +180,13 @@ InterpretResult Compiler::run(const Chunk& chunk) {
     return result;
 }
 
+InterpretResult Compiler::run(const RegisterChunk& chunk) {
+    InterpretResult result = m_regvm->interpret(chunk);
+    if (result != InterpretResult::OK) {
+        m_error = m_regvm->getError();
+    }
+
+    return result;
+}
+
 } // namespace minilang
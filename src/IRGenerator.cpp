@@ -1,9 +1,211 @@
 #include "IRGenerator.hpp"
+#include <algorithm>
 #include <format>
 
 namespace minilang {
 
-IRGenerator::IRGenerator() {
+const char* opcodeName(OpCode op) {
+    switch (op) {
+        case OpCode::OP_CONSTANT: return "OP_CONSTANT";
+        case OpCode::OP_NIL: return "OP_NIL";
+        case OpCode::OP_TRUE: return "OP_TRUE";
+        case OpCode::OP_FALSE: return "OP_FALSE";
+        case OpCode::OP_ADD: return "OP_ADD";
+        case OpCode::OP_SUBTRACT: return "OP_SUBTRACT";
+        case OpCode::OP_MULTIPLY: return "OP_MULTIPLY";
+        case OpCode::OP_DIVIDE: return "OP_DIVIDE";
+        case OpCode::OP_MODULO: return "OP_MODULO";
+        case OpCode::OP_NEGATE: return "OP_NEGATE";
+        case OpCode::OP_EQUAL: return "OP_EQUAL";
+        case OpCode::OP_NOT_EQUAL: return "OP_NOT_EQUAL";
+        case OpCode::OP_LESS: return "OP_LESS";
+        case OpCode::OP_LESS_EQUAL: return "OP_LESS_EQUAL";
+        case OpCode::OP_GREATER: return "OP_GREATER";
+        case OpCode::OP_GREATER_EQUAL: return "OP_GREATER_EQUAL";
+        case OpCode::OP_NOT: return "OP_NOT";
+        case OpCode::OP_AND: return "OP_AND";
+        case OpCode::OP_OR: return "OP_OR";
+        case OpCode::OP_GET_LOCAL: return "OP_GET_LOCAL";
+        case OpCode::OP_SET_LOCAL: return "OP_SET_LOCAL";
+        case OpCode::OP_GET_GLOBAL: return "OP_GET_GLOBAL";
+        case OpCode::OP_SET_GLOBAL: return "OP_SET_GLOBAL";
+        case OpCode::OP_POP: return "OP_POP";
+        case OpCode::OP_JUMP: return "OP_JUMP";
+        case OpCode::OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
+        case OpCode::OP_LOOP: return "OP_LOOP";
+        case OpCode::OP_CALL: return "OP_CALL";
+        case OpCode::OP_RETURN: return "OP_RETURN";
+        case OpCode::OP_POP_JUMP_IF_FALSE: return "OP_POP_JUMP_IF_FALSE";
+        case OpCode::OP_POP_JUMP_IF_TRUE: return "OP_POP_JUMP_IF_TRUE";
+        case OpCode::OP_JUMP_IF_NOT_LESS: return "OP_JUMP_IF_NOT_LESS";
+        case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL: return "OP_JUMP_IF_NOT_LESS_EQUAL";
+        case OpCode::OP_JUMP_IF_NOT_GREATER: return "OP_JUMP_IF_NOT_GREATER";
+        case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL: return "OP_JUMP_IF_NOT_GREATER_EQUAL";
+        case OpCode::OP_SET_LOCAL_POP: return "OP_SET_LOCAL_POP";
+        case OpCode::OP_SET_GLOBAL_POP: return "OP_SET_GLOBAL_POP";
+        case OpCode::OP_ADD_LOCAL_CONSTANT: return "OP_ADD_LOCAL_CONSTANT";
+        case OpCode::OP_ADD_GLOBAL_CONSTANT: return "OP_ADD_GLOBAL_CONSTANT";
+        case OpCode::OP_ADD_NUM: return "OP_ADD_NUM";
+        case OpCode::OP_ADD_STR: return "OP_ADD_STR";
+        case OpCode::OP_EQUAL_NUM: return "OP_EQUAL_NUM";
+        case OpCode::OP_NOT_EQUAL_NUM: return "OP_NOT_EQUAL_NUM";
+        case OpCode::OP_NUM_ADD: return "OP_NUM_ADD";
+        case OpCode::OP_NUM_SUBTRACT: return "OP_NUM_SUBTRACT";
+        case OpCode::OP_NUM_MULTIPLY: return "OP_NUM_MULTIPLY";
+        case OpCode::OP_NUM_DIVIDE: return "OP_NUM_DIVIDE";
+        case OpCode::OP_NUM_MODULO: return "OP_NUM_MODULO";
+        case OpCode::OP_NUM_NEGATE: return "OP_NUM_NEGATE";
+        case OpCode::OP_NUM_EQUAL: return "OP_NUM_EQUAL";
+        case OpCode::OP_NUM_NOT_EQUAL: return "OP_NUM_NOT_EQUAL";
+        case OpCode::OP_NUM_LESS: return "OP_NUM_LESS";
+        case OpCode::OP_NUM_LESS_EQUAL: return "OP_NUM_LESS_EQUAL";
+        case OpCode::OP_NUM_GREATER: return "OP_NUM_GREATER";
+        case OpCode::OP_NUM_GREATER_EQUAL: return "OP_NUM_GREATER_EQUAL";
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS: return "OP_NUM_JUMP_IF_NOT_LESS";
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS_EQUAL: return "OP_NUM_JUMP_IF_NOT_LESS_EQUAL";
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER: return "OP_NUM_JUMP_IF_NOT_GREATER";
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER_EQUAL: return "OP_NUM_JUMP_IF_NOT_GREATER_EQUAL";
+        case OpCode::OP_NUM_ADD_LOCAL_CONSTANT: return "OP_NUM_ADD_LOCAL_CONSTANT";
+        case OpCode::OP_NUM_ADD_GLOBAL_CONSTANT: return "OP_NUM_ADD_GLOBAL_CONSTANT";
+        case OpCode::OP_INT_MODULO: return "OP_INT_MODULO";
+        case OpCode::OP_PRINT: return "OP_PRINT";
+        default: return "OP_UNKNOWN";
+    }
+}
+
+OpCode untypedOpcode(OpCode op) {
+    switch (op) {
+        case OpCode::OP_NUM_ADD: return OpCode::OP_ADD;
+        case OpCode::OP_NUM_SUBTRACT: return OpCode::OP_SUBTRACT;
+        case OpCode::OP_NUM_MULTIPLY: return OpCode::OP_MULTIPLY;
+        case OpCode::OP_NUM_DIVIDE: return OpCode::OP_DIVIDE;
+        case OpCode::OP_NUM_MODULO: return OpCode::OP_MODULO;
+        case OpCode::OP_NUM_NEGATE: return OpCode::OP_NEGATE;
+        case OpCode::OP_NUM_EQUAL: return OpCode::OP_EQUAL;
+        case OpCode::OP_NUM_NOT_EQUAL: return OpCode::OP_NOT_EQUAL;
+        case OpCode::OP_NUM_LESS: return OpCode::OP_LESS;
+        case OpCode::OP_NUM_LESS_EQUAL: return OpCode::OP_LESS_EQUAL;
+        case OpCode::OP_NUM_GREATER: return OpCode::OP_GREATER;
+        case OpCode::OP_NUM_GREATER_EQUAL: return OpCode::OP_GREATER_EQUAL;
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS: return OpCode::OP_JUMP_IF_NOT_LESS;
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS_EQUAL: return OpCode::OP_JUMP_IF_NOT_LESS_EQUAL;
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER: return OpCode::OP_JUMP_IF_NOT_GREATER;
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER_EQUAL: return OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL;
+        case OpCode::OP_NUM_ADD_LOCAL_CONSTANT: return OpCode::OP_ADD_LOCAL_CONSTANT;
+        case OpCode::OP_NUM_ADD_GLOBAL_CONSTANT: return OpCode::OP_ADD_GLOBAL_CONSTANT;
+        case OpCode::OP_INT_MODULO: return OpCode::OP_MODULO;
+        default: return op;
+    }
+}
+
+// Values an instruction leaves on the stack minus the values it takes
+static int stackEffect(const Instruction& instruction) {
+    switch (untypedOpcode(instruction.opcode)) {
+        case OpCode::OP_CONSTANT:
+        case OpCode::OP_NIL:
+        case OpCode::OP_TRUE:
+        case OpCode::OP_FALSE:
+        case OpCode::OP_GET_LOCAL:
+        case OpCode::OP_GET_GLOBAL:
+        case OpCode::OP_ADD_LOCAL_CONSTANT:
+        case OpCode::OP_ADD_GLOBAL_CONSTANT:
+            return 1;
+        case OpCode::OP_NEGATE:
+        case OpCode::OP_NOT:
+        case OpCode::OP_SET_LOCAL:
+        case OpCode::OP_SET_GLOBAL:
+        case OpCode::OP_JUMP:
+        case OpCode::OP_JUMP_IF_FALSE:
+        case OpCode::OP_LOOP:
+        case OpCode::OP_RETURN:
+            return 0;
+        case OpCode::OP_JUMP_IF_NOT_LESS:
+        case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+        case OpCode::OP_JUMP_IF_NOT_GREATER:
+        case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL:
+            return -2;
+        case OpCode::OP_CALL:
+            return -static_cast<int>(instruction.operand); // Callee and arguments become the result
+        default:
+            return -1; // Binary operators, pops and stores that pop
+    }
+}
+
+size_t stackHeight(const Chunk& chunk, size_t entry) {
+    constexpr size_t UNSEEN = SIZE_MAX;
+    std::vector<size_t> heights(chunk.code.size(), UNSEEN);
+    std::vector<size_t> pending;
+    size_t highest = entry;
+
+    auto reach = [&](size_t pc, size_t height) {
+        if (pc < heights.size() && heights[pc] == UNSEEN) {
+            heights[pc] = height;
+            pending.push_back(pc);
+        }
+    };
+
+    // Every path into an instruction arrives with the same height
+    reach(0, entry);
+    while (!pending.empty()) {
+        size_t pc = pending.back();
+        pending.pop_back();
+        const Instruction& instruction = chunk.code[pc];
+        size_t height = static_cast<size_t>(static_cast<ptrdiff_t>(heights[pc]) + stackEffect(instruction));
+        highest = std::max(highest, height);
+
+        switch (untypedOpcode(instruction.opcode)) {
+            case OpCode::OP_RETURN:
+                break;
+            case OpCode::OP_JUMP:
+                reach(pc + 1 + instruction.operand, height);
+                break;
+            case OpCode::OP_LOOP:
+                reach(pc + 1 - instruction.operand, height);
+                break;
+            case OpCode::OP_JUMP_IF_FALSE:
+            case OpCode::OP_POP_JUMP_IF_FALSE:
+            case OpCode::OP_POP_JUMP_IF_TRUE:
+            case OpCode::OP_JUMP_IF_NOT_LESS:
+            case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+            case OpCode::OP_JUMP_IF_NOT_GREATER:
+            case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL:
+                reach(pc + 1 + instruction.operand, height);
+                reach(pc + 1, height);
+                break;
+            default:
+                reach(pc + 1, height);
+                break;
+        }
+    }
+    return highest;
+}
+
+// Typed form of a generic opcode; opcodes without one map to themselves
+static OpCode typedOpcode(OpCode op) {
+    switch (op) {
+        case OpCode::OP_ADD: return OpCode::OP_NUM_ADD;
+        case OpCode::OP_SUBTRACT: return OpCode::OP_NUM_SUBTRACT;
+        case OpCode::OP_MULTIPLY: return OpCode::OP_NUM_MULTIPLY;
+        case OpCode::OP_DIVIDE: return OpCode::OP_NUM_DIVIDE;
+        case OpCode::OP_MODULO: return OpCode::OP_NUM_MODULO;
+        case OpCode::OP_NEGATE: return OpCode::OP_NUM_NEGATE;
+        case OpCode::OP_EQUAL: return OpCode::OP_NUM_EQUAL;
+        case OpCode::OP_NOT_EQUAL: return OpCode::OP_NUM_NOT_EQUAL;
+        case OpCode::OP_LESS: return OpCode::OP_NUM_LESS;
+        case OpCode::OP_LESS_EQUAL: return OpCode::OP_NUM_LESS_EQUAL;
+        case OpCode::OP_GREATER: return OpCode::OP_NUM_GREATER;
+        case OpCode::OP_GREATER_EQUAL: return OpCode::OP_NUM_GREATER_EQUAL;
+        case OpCode::OP_JUMP_IF_NOT_LESS: return OpCode::OP_NUM_JUMP_IF_NOT_LESS;
+        case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL: return OpCode::OP_NUM_JUMP_IF_NOT_LESS_EQUAL;
+        case OpCode::OP_JUMP_IF_NOT_GREATER: return OpCode::OP_NUM_JUMP_IF_NOT_GREATER;
+        case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL: return OpCode::OP_NUM_JUMP_IF_NOT_GREATER_EQUAL;
+        case OpCode::OP_ADD_LOCAL_CONSTANT: return OpCode::OP_NUM_ADD_LOCAL_CONSTANT;
+        case OpCode::OP_ADD_GLOBAL_CONSTANT: return OpCode::OP_NUM_ADD_GLOBAL_CONSTANT;
+        default: return op;
+    }
+}
+
+IRGenerator::IRGenerator(Heap& heap, GlobalTable& globals) : m_heap(heap), m_globals(globals) {
     // Reserve space for locals
     m_locals.reserve(256);
 }
@@ -13,10 +215,19 @@ Chunk IRGenerator::compile(const Program& program) {
     m_error.clear();
     m_chunk = Chunk();
     m_locals.clear();
+    m_pendingGlobals.clear();
+    m_hoisted.clear();
+    m_inlineCandidates.clear();
+    m_inlineFrames.clear();
+    m_temps = 0;
     m_scopeDepth = 0;
+    findInlineSafe(program);
+    m_types.infer(program, m_globals);
 
-    beginScope();
+    // Slot 0 of every frame holds the callee; the script's is unnamed
+    m_locals.push_back({"", 0, false});
 
+    // Top-level declarations stay at depth 0 and become globals
     for (const auto& stmt : program) {
         compileStmt(stmt.get());
         if (m_hadError) {
@@ -24,8 +235,10 @@ Chunk IRGenerator::compile(const Program& program) {
         }
     }
 
-    endScope();
-    emitByte(OpCode::OP_RETURN);
+    checkGlobalsDefined();
+    emitReturn();
+    m_peephole.optimize(m_chunk);
+    m_chunk.stackMax = stackHeight(m_chunk, 1);
     return m_chunk;
 }
 
@@ -34,12 +247,23 @@ Chunk IRGenerator::compileExpression(std::unique_ptr<Expr> expr) {
     m_error.clear();
     m_chunk = Chunk();
     m_locals.clear();
+    m_pendingGlobals.clear();
+    m_hoisted.clear();
+    m_inlineSafe.clear();
+    m_inlineCandidates.clear();
+    m_inlineFrames.clear();
+    m_types.clear();
+    m_temps = 0;
     m_scopeDepth = 0;
+    m_locals.push_back({"", 0, false});
 
     beginScope();
     compileExpr(expr.get());
     endScope();
+    checkGlobalsDefined();
     emitByte(OpCode::OP_RETURN);
+    m_peephole.optimize(m_chunk);
+    m_chunk.stackMax = stackHeight(m_chunk, 1);
 
     return m_chunk;
 }
@@ -58,7 +282,7 @@ void IRGenerator::endScope() {
     }
 }
 
-void IRGenerator::declareVariable(const std::string& name) {
+void IRGenerator::declareVariable(std::string_view name) {
     if (m_scopeDepth == 0) return;
 
     // Check for duplicate in current scope
@@ -70,10 +294,16 @@ void IRGenerator::declareVariable(const std::string& name) {
         }
     }
 
+    if (m_locals.size() >= LOCALS_MAX) {
+        error("Too many local variables in function.");
+        return;
+    }
+
     m_locals.push_back({name, m_scopeDepth, false});
+    m_chunk.localCount = std::max(m_chunk.localCount, m_locals.size());
 }
 
-int IRGenerator::resolveLocal(const std::string& name) {
+int IRGenerator::resolveLocal(std::string_view name) {
     for (int i = static_cast<int>(m_locals.size()) - 1; i >= 0; i--) {
         if (m_locals[i].name == name) {
             return i;
@@ -82,40 +312,190 @@ int IRGenerator::resolveLocal(const std::string& name) {
     return -1; // Not found, treat as global
 }
 
+IRGenerator::VariableRef IRGenerator::resolveVariable(std::string_view name, size_t frames) {
+    if (frames == 0) {
+        int local = resolveLocal(name);
+        if (local != -1) return {VariableRef::Kind::LOCAL, static_cast<uint32_t>(local), nullptr};
+        return {VariableRef::Kind::GLOBAL, resolveGlobal(name), nullptr};
+    }
+
+    // Inside an inlined body, names are parameters or globals
+    const InlineFrame& frame = m_inlineFrames[frames - 1];
+    const std::vector<Token>& params = frame.function->params;
+    for (size_t i = 0; i < params.size(); i++) {
+        if (params[i].lexeme() != name) continue;
+
+        Expr* argument = frame.arguments[i];
+        if (!argument) return {VariableRef::Kind::LOCAL, frame.slots[i], nullptr};
+        if (argument->getType() == ExprType::Variable) {
+            return resolveVariable(static_cast<VariableExpr*>(argument)->name.lexeme(), frames - 1);
+        }
+        return {VariableRef::Kind::ARGUMENT, 0, argument};
+    }
+    return {VariableRef::Kind::GLOBAL, resolveGlobal(name), nullptr};
+}
+
+uint32_t IRGenerator::resolveGlobal(std::string_view name) {
+    uint32_t slot = m_globals.slotFor(name);
+    if (!m_globals.defined[slot]) {
+        // May still be declared further down the program
+        m_pendingGlobals.push_back(slot);
+    }
+    return slot;
+}
+
+void IRGenerator::defineGlobal(std::string_view name) {
+    uint32_t slot = m_globals.define(name);
+    if (!m_declaredGlobals.insert(slot).second) {
+        error(std::format("Variable '{}' already declared in this scope.", name));
+        return;
+    }
+    emitByte(OpCode::OP_SET_GLOBAL_POP, slot);
+}
+
+void IRGenerator::checkGlobalsDefined() {
+    for (uint32_t slot : m_pendingGlobals) {
+        if (!m_globals.defined[slot]) {
+            error(std::format("Undefined variable: {}", m_globals.names[slot]));
+            return;
+        }
+    }
+}
+
 void IRGenerator::markInitialized() {
-    if (m_locals.empty()) return;
+    if (m_scopeDepth == 0 || m_locals.empty()) return;
     m_locals.back().depth = m_scopeDepth;
 }
 
-void IRGenerator::emitByte(OpCode op, uint8_t operand) {
+void IRGenerator::emitByte(OpCode op, uint32_t operand) {
     m_chunk.write(op, 0, operand);
 }
 
+size_t IRGenerator::findConstant(const Value& value) const {
+    // Reuse an identical number or string already in the pool
+    for (size_t i = 0; i < m_chunk.constants.size(); i++) {
+        const Value& constant = m_chunk.constants[i];
+        if (constant.sameBits(value) || (constant.isString() && value.isString() && constant.asString() == value.asString())) {
+            return i;
+        }
+    }
+    return m_chunk.constants.size();
+}
+
+void IRGenerator::emitConstant(Value value) {
+    size_t index = findConstant(value);
+    if (index == m_chunk.constants.size()) {
+        if (index > OPERAND_MAX) {
+            error("Too many constants in one chunk.");
+            return;
+        }
+        m_chunk.addConstant(value);
+    }
+    emitByte(OpCode::OP_CONSTANT, static_cast<uint32_t>(index));
+}
+
+void IRGenerator::emitReturn() {
+    emitByte(OpCode::OP_NIL);
+    emitByte(OpCode::OP_RETURN);
+}
+
 void IRGenerator::emitJump(OpCode op) {
-    m_chunk.write(op, 0, 255); // Placeholder
+    m_chunk.write(op, 0, OPERAND_MAX); // Placeholder
+}
+
+size_t IRGenerator::emitConditionJump(Expr* condition) {
+    while (condition && condition->getType() == ExprType::Grouping) {
+        condition = static_cast<GroupingExpr*>(condition)->expression.get();
+    }
+
+    // Relational conditions compare and branch in a single instruction
+    if (condition && condition->getType() == ExprType::Binary && !m_hoisted.contains(condition)) {
+        auto* binary = static_cast<BinaryExpr*>(condition);
+        OpCode fused = OpCode::OP_POP_JUMP_IF_FALSE;
+        switch (binary->op.type) {
+            case TokenType::LESS: fused = OpCode::OP_JUMP_IF_NOT_LESS; break;
+            case TokenType::LESS_EQUAL: fused = OpCode::OP_JUMP_IF_NOT_LESS_EQUAL; break;
+            case TokenType::GREATER: fused = OpCode::OP_JUMP_IF_NOT_GREATER; break;
+            case TokenType::GREATER_EQUAL: fused = OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL; break;
+            default: break;
+        }
+        if (fused != OpCode::OP_POP_JUMP_IF_FALSE) {
+            compileExpr(binary->left.get());
+            compileExpr(binary->right.get());
+            if (m_types.isNumber(binary->left.get()) && m_types.isNumber(binary->right.get())) {
+                fused = typedOpcode(fused);
+            }
+            emitJump(fused);
+            return m_chunk.code.size() - 1;
+        }
+    }
+
+    compileExpr(condition);
+    emitJump(OpCode::OP_POP_JUMP_IF_FALSE);
+    return m_chunk.code.size() - 1;
+}
+
+bool IRGenerator::emitAddConstant(BinaryExpr* expr) {
+    // Fuse `variable + number` and `variable - number`
+    if (expr->op.type != TokenType::PLUS && expr->op.type != TokenType::MINUS) return false;
+    if (expr->left->getType() != ExprType::Variable || expr->right->getType() != ExprType::Literal) return false;
+
+    auto* literal = static_cast<LiteralExpr*>(expr->right.get());
+    if (!std::holds_alternative<double>(literal->value)) return false;
+
+    // The fused form reports a bad operand with ADD's message
+    bool number = m_types.isNumber(expr->left.get());
+    if (expr->op.type == TokenType::MINUS && !number) return false;
+
+    // x - k is exactly x + (-k) in IEEE arithmetic
+    double constant = std::get<double>(literal->value);
+    if (expr->op.type == TokenType::MINUS) constant = -constant;
+
+    VariableRef variable = resolveVariable(static_cast<VariableExpr*>(expr->left.get())->name.lexeme(), m_inlineFrames.size());
+    if (variable.kind == VariableRef::Kind::ARGUMENT) return false;
+    OpCode op = variable.kind == VariableRef::Kind::LOCAL ? OpCode::OP_ADD_LOCAL_CONSTANT : OpCode::OP_ADD_GLOBAL_CONSTANT;
+    if (number) op = typedOpcode(op);
+    uint32_t slot = variable.slot;
+
+    size_t index = findConstant(Value(constant));
+    if (slot > PAIR_OPERAND_MAX || index > PAIR_OPERAND_MAX) return false;
+
+    if (index == m_chunk.constants.size()) m_chunk.addConstant(Value(constant));
+    emitByte(op, slot | static_cast<uint32_t>(index) << PAIR_OPERAND_BITS);
+    return true;
 }
 
 void IRGenerator::emitLoop(size_t loopStart) {
-    size_t offset = m_chunk.code.size() - loopStart;
-    if (offset > 255) {
+    // The VM has already stepped past OP_LOOP when it applies the offset
+    size_t offset = m_chunk.code.size() + 1 - loopStart;
+    if (offset > OPERAND_MAX) {
         error("Loop body too large.");
         return;
     }
-    m_chunk.write(OpCode::OP_LOOP, 0, static_cast<uint8_t>(offset));
+    m_chunk.write(OpCode::OP_LOOP, 0, static_cast<uint32_t>(offset));
 }
 
 void IRGenerator::patchJump(size_t offset) {
     size_t jump = m_chunk.code.size() - 1 - offset;
-    if (jump > 255) {
+    if (jump > OPERAND_MAX) {
         error("Jump too far.");
         return;
     }
-    m_chunk.code[offset].operand = static_cast<uint8_t>(jump);
+    m_chunk.code[offset].operand = static_cast<uint32_t>(jump);
 }
 
 void IRGenerator::compileExpr(Expr* expr) {
+    // Every expression leaves exactly one value on the operand stack
+    size_t temps = m_temps;
     if (!expr) {
         emitByte(OpCode::OP_NIL);
+        m_temps = temps + 1;
+        return;
+    }
+
+    if (auto it = m_hoisted.find(expr); it != m_hoisted.end()) {
+        emitByte(OpCode::OP_GET_LOCAL, it->second);
+        m_temps = temps + 1;
         return;
     }
 
@@ -142,52 +522,65 @@ void IRGenerator::compileExpr(Expr* expr) {
             compileGroupingExpr(static_cast<GroupingExpr*>(expr));
             break;
     }
+    m_temps = temps + 1;
 }
 
 void IRGenerator::compileBinaryExpr(BinaryExpr* expr) {
+    if (emitAddConstant(expr)) return;
+
     compileExpr(expr->left.get());
     compileExpr(expr->right.get());
 
+    OpCode op;
     switch (expr->op.type) {
-        case TokenType::PLUS: emitByte(OpCode::OP_ADD); break;
-        case TokenType::MINUS: emitByte(OpCode::OP_SUBTRACT); break;
-        case TokenType::STAR: emitByte(OpCode::OP_MULTIPLY); break;
-        case TokenType::SLASH: emitByte(OpCode::OP_DIVIDE); break;
-        case TokenType::PERCENT: emitByte(OpCode::OP_MODULO); break;
-
-        case TokenType::EQUAL_EQUAL: emitByte(OpCode::OP_EQUAL); break;
-        case TokenType::BANG_EQUAL: emitByte(OpCode::OP_EQUAL); emitByte(OpCode::OP_NOT); break;
-        case TokenType::LESS: emitByte(OpCode::OP_LESS); break;
-        case TokenType::LESS_EQUAL: emitByte(OpCode::OP_GREATER); emitByte(OpCode::OP_NOT); break;
-        case TokenType::GREATER: emitByte(OpCode::OP_GREATER); break;
-        case TokenType::GREATER_EQUAL: emitByte(OpCode::OP_LESS); emitByte(OpCode::OP_NOT); break;
-
-        case TokenType::AND: emitByte(OpCode::OP_AND); break;
-        case TokenType::OR: emitByte(OpCode::OP_OR); break;
+        case TokenType::PLUS: op = OpCode::OP_ADD; break;
+        case TokenType::MINUS: op = OpCode::OP_SUBTRACT; break;
+        case TokenType::STAR: op = OpCode::OP_MULTIPLY; break;
+        case TokenType::SLASH: op = OpCode::OP_DIVIDE; break;
+        case TokenType::PERCENT: op = OpCode::OP_MODULO; break;
+
+        case TokenType::EQUAL_EQUAL: op = OpCode::OP_EQUAL; break;
+        case TokenType::BANG_EQUAL: op = OpCode::OP_NOT_EQUAL; break;
+        case TokenType::LESS: op = OpCode::OP_LESS; break;
+        case TokenType::LESS_EQUAL: op = OpCode::OP_LESS_EQUAL; break;
+        case TokenType::GREATER: op = OpCode::OP_GREATER; break;
+        case TokenType::GREATER_EQUAL: op = OpCode::OP_GREATER_EQUAL; break;
+
+        case TokenType::AND: op = OpCode::OP_AND; break;
+        case TokenType::OR: op = OpCode::OP_OR; break;
 
         default:
-            error(std::format("Unknown binary operator: {}", expr->op.lexeme));
-            break;
+            error(std::format("Unknown binary operator: {}", expr->op.lexeme()));
+            return;
+    }
+
+    if (op == OpCode::OP_MODULO && m_types.isInteger(expr->left.get()) && m_types.isInteger(expr->right.get())) {
+        op = OpCode::OP_INT_MODULO;
+    } else if (m_types.isNumber(expr->left.get()) && m_types.isNumber(expr->right.get())) {
+        op = typedOpcode(op);
     }
+    emitByte(op);
 }
 
 void IRGenerator::compileUnaryExpr(UnaryExpr* expr) {
     compileExpr(expr->right.get());
 
     switch (expr->op.type) {
-        case TokenType::MINUS: emitByte(OpCode::OP_NEGATE); break;
+        case TokenType::MINUS:
+            emitByte(m_types.isNumber(expr->right.get()) ? OpCode::OP_NUM_NEGATE : OpCode::OP_NEGATE);
+            break;
         case TokenType::BANG: emitByte(OpCode::OP_NOT); break;
         default:
-            error(std::format("Unknown unary operator: {}", expr->op.lexeme));
+            error(std::format("Unknown unary operator: {}", expr->op.lexeme()));
             break;
     }
 }
 
 void IRGenerator::compileLiteralExpr(LiteralExpr* expr) {
     if (std::holds_alternative<double>(expr->value)) {
-        m_chunk.writeConstant(Value(std::get<double>(expr->value)), 0);
+        emitConstant(Value(std::get<double>(expr->value)));
     } else if (std::holds_alternative<std::string>(expr->value)) {
-        m_chunk.writeConstant(Value(std::get<std::string>(expr->value)), 0);
+        emitConstant(Value(m_heap.makeString(std::get<std::string>(expr->value))));
     } else if (std::holds_alternative<bool>(expr->value)) {
         if (std::get<bool>(expr->value)) {
             emitByte(OpCode::OP_TRUE);
@@ -200,34 +593,39 @@ void IRGenerator::compileLiteralExpr(LiteralExpr* expr) {
 }
 
 void IRGenerator::compileVariableExpr(VariableExpr* expr) {
-    int local = resolveLocal(expr->name.lexeme);
-    if (local != -1) {
-        emitByte(OpCode::OP_GET_LOCAL, static_cast<uint8_t>(local));
-    } else {
-        // Global variable (not implemented in this simple version)
-        error(std::format("Undefined variable: {}", expr->name.lexeme));
+    VariableRef variable = resolveVariable(expr->name.lexeme(), m_inlineFrames.size());
+    switch (variable.kind) {
+        case VariableRef::Kind::LOCAL: emitByte(OpCode::OP_GET_LOCAL, variable.slot); break;
+        case VariableRef::Kind::GLOBAL: emitByte(OpCode::OP_GET_GLOBAL, variable.slot); break;
+        case VariableRef::Kind::ARGUMENT: compileExpr(variable.argument); break;
     }
 }
 
 void IRGenerator::compileAssignExpr(AssignExpr* expr) {
     compileExpr(expr->value.get());
 
-    int local = resolveLocal(expr->name.lexeme);
-    if (local != -1) {
-        emitByte(OpCode::OP_SET_LOCAL, static_cast<uint8_t>(local));
+    // Inlined bodies never assign their parameters
+    VariableRef variable = resolveVariable(expr->name.lexeme(), m_inlineFrames.size());
+    if (variable.kind == VariableRef::Kind::LOCAL) {
+        emitByte(OpCode::OP_SET_LOCAL, variable.slot);
     } else {
-        error(std::format("Undefined variable: {}", expr->name.lexeme));
+        emitByte(OpCode::OP_SET_GLOBAL, variable.slot);
     }
 }
 
 void IRGenerator::compileCallExpr(CallExpr* expr) {
+    if (const InlineCandidate* candidate = findInlineCandidate(expr)) {
+        compileInlineCall(expr, *candidate);
+        return;
+    }
+
     compileExpr(expr->callee.get());
 
     for (const auto& arg : expr->arguments) {
         compileExpr(arg.get());
     }
 
-    emitByte(OpCode::OP_CALL, static_cast<uint8_t>(expr->arguments.size()));
+    emitByte(OpCode::OP_CALL, static_cast<uint32_t>(expr->arguments.size()));
 }
 
 void IRGenerator::compileGroupingExpr(GroupingExpr* expr) {
@@ -236,6 +634,7 @@ void IRGenerator::compileGroupingExpr(GroupingExpr* expr) {
 
 void IRGenerator::compileStmt(Stmt* stmt) {
     if (!stmt) return;
+    m_temps = 0;
 
     switch (stmt->getType()) {
         case StmtType::Expression:
@@ -266,60 +665,143 @@ void IRGenerator::compileStmt(Stmt* stmt) {
 }
 
 void IRGenerator::compileExpressionStmt(ExpressionStmt* stmt) {
+    // Assignment statements store and discard in one instruction
+    if (stmt->expression && stmt->expression->getType() == ExprType::Assignment) {
+        auto* assign = static_cast<AssignExpr*>(stmt->expression.get());
+        compileExpr(assign->value.get());
+
+        int local = resolveLocal(assign->name.lexeme());
+        if (local != -1) {
+            emitByte(OpCode::OP_SET_LOCAL_POP, static_cast<uint32_t>(local));
+        } else {
+            emitByte(OpCode::OP_SET_GLOBAL_POP, resolveGlobal(assign->name.lexeme()));
+        }
+        return;
+    }
+
     compileExpr(stmt->expression.get());
     emitByte(OpCode::OP_POP); // Discard result
 }
 
 void IRGenerator::compileLetStmt(LetStmt* stmt) {
-    declareVariable(stmt->name.lexeme);
-
+    // The initializer sees the enclosing binding of the name, and is
+    // evaluated before the new local takes its stack slot
     if (stmt->initializer) {
         compileExpr(stmt->initializer.get());
     } else {
         emitByte(OpCode::OP_NIL);
     }
 
+    if (m_scopeDepth == 0) {
+        defineGlobal(stmt->name.lexeme());
+        return;
+    }
+    declareVariable(stmt->name.lexeme());
     markInitialized();
 }
 
 void IRGenerator::compileFunctionStmt(FunctionStmt* stmt) {
-    declareVariable(stmt->name.lexeme);
+    declareVariable(stmt->name.lexeme());
     markInitialized();
 
-    // In a full implementation, we'd compile the function body separately
-    // For now, just push nil as placeholder
-    emitByte(OpCode::OP_NIL);
+    auto* function = m_heap.allocate<ObjFunction>();
+    function->name = std::string(stmt->name.lexeme());
+    function->arity = static_cast<uint8_t>(stmt->params.size());
+
+    // Compile the body into its own chunk with a fresh set of locals
+    Chunk enclosingChunk = std::move(m_chunk);
+    std::vector<Local> enclosingLocals = std::move(m_locals);
+    size_t enclosingDepth = m_scopeDepth;
+
+    m_chunk = Chunk();
+    m_locals.clear();
+    m_scopeDepth = 0;
+
+    // Slot 0 holds the callee, so the function can refer to itself by name
+    m_locals.push_back({function->name, 0, false});
+
+    beginScope();
+    for (const auto& param : stmt->params) {
+        declareVariable(param.lexeme());
+        markInitialized();
+    }
+    for (const auto& s : stmt->body) {
+        compileStmt(s.get());
+    }
+    emitReturn();
+    m_peephole.optimize(m_chunk);
+    m_chunk.stackMax = stackHeight(m_chunk, stmt->params.size() + 1);
+
+    function->chunk = std::move(m_chunk);
+    m_chunk = std::move(enclosingChunk);
+    m_locals = std::move(enclosingLocals);
+    m_scopeDepth = enclosingDepth;
+
+    emitConstant(Value(function));
+    if (m_scopeDepth == 0) {
+        defineGlobal(function->name);
+        addInlineCandidate(stmt);
+    }
 }
 
 void IRGenerator::compileIfStmt(IfStmt* stmt) {
-    compileExpr(stmt->condition.get());
-    emitJump(OpCode::OP_JUMP_IF_FALSE);
-    size_t thenJump = m_chunk.code.size() - 1;
-
+    size_t thenJump = emitConditionJump(stmt->condition.get());
     compileStmt(stmt->thenBranch.get());
+
+    if (!stmt->elseBranch) {
+        patchJump(thenJump);
+        return;
+    }
+
     emitJump(OpCode::OP_JUMP);
     size_t elseJump = m_chunk.code.size() - 1;
 
     patchJump(thenJump);
-
-    if (stmt->elseBranch) {
-        compileStmt(stmt->elseBranch.get());
-    }
-
+    compileStmt(stmt->elseBranch.get());
     patchJump(elseJump);
 }
 
 void IRGenerator::compileWhileStmt(WhileStmt* stmt) {
-    size_t loopStart = m_chunk.code.size();
+    LoopWrites writes;
+    collectWrites(stmt->condition.get(), writes);
+    collectWrites(stmt->body.get(), writes);
+
+    bool observable = false;
+    std::vector<Expr*> invariants;
+    findInvariants(stmt->condition.get(), writes, observable, invariants);
+
+    // Evaluate each invariant once, in condition order, into a hidden local
+    std::vector<const Expr*> reused;
+    if (!invariants.empty()) {
+        beginScope();
+        for (size_t i = 0; i < invariants.size(); i++) {
+            Expr* invariant = invariants[i];
+            compileExpr(invariant);
+            if (m_hiddenNames.size() == i) {
+                m_hiddenNames.push_back(std::format(" invariant{}", i)); // Not a valid identifier
+            }
+            declareVariable(m_hiddenNames[i]);
+            markInitialized();
+            m_temps = 0;
+            m_hoisted[invariant] = static_cast<uint32_t>(m_locals.size() - 1);
+        }
+        reuseInvariants(stmt->condition.get(), invariants, reused);
+        reuseInvariants(stmt->body.get(), invariants, reused);
+    }
 
-    compileExpr(stmt->condition.get());
-    emitJump(OpCode::OP_JUMP_IF_FALSE);
-    size_t exitJump = m_chunk.code.size() - 1;
+    size_t loopStart = m_chunk.code.size();
 
+    size_t exitJump = emitConditionJump(stmt->condition.get());
     compileStmt(stmt->body.get());
     emitLoop(loopStart);
 
     patchJump(exitJump);
+
+    if (!invariants.empty()) {
+        for (const Expr* invariant : invariants) m_hoisted.erase(invariant);
+        for (const Expr* expr : reused) m_hoisted.erase(expr);
+        endScope();
+    }
 }
 
 void IRGenerator::compileReturnStmt(ReturnStmt* stmt) {
@@ -344,6 +826,462 @@ void IRGenerator::compileBlockStmt(BlockStmt* stmt) {
     endScope();
 }
 
+// Strip redundant parentheses
+static const Expr* unwrap(const Expr* expr) {
+    while (expr && expr->getType() == ExprType::Grouping) {
+        expr = static_cast<const GroupingExpr*>(expr)->expression.get();
+    }
+    return expr;
+}
+
+static Expr* unwrap(Expr* expr) {
+    return const_cast<Expr*>(unwrap(static_cast<const Expr*>(expr)));
+}
+
+// Whether evaluating the node itself, operands aside, can raise a runtime error or write a variable
+static bool isObservable(const Expr* expr) {
+    switch (expr->getType()) {
+        case ExprType::Binary:
+            switch (static_cast<const BinaryExpr*>(expr)->op.type) {
+                case TokenType::EQUAL_EQUAL:
+                case TokenType::BANG_EQUAL:
+                case TokenType::AND:
+                case TokenType::OR:
+                    return false;
+                default:
+                    return true;
+            }
+        case ExprType::Unary:
+            return static_cast<const UnaryExpr*>(expr)->op.type == TokenType::MINUS;
+        case ExprType::Assignment:
+        case ExprType::Call:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Structural equality of side-effect-free expressions
+static bool sameExpr(const Expr* a, const Expr* b) {
+    a = unwrap(a);
+    b = unwrap(b);
+    if (!a || !b || a->getType() != b->getType()) return false;
+
+    switch (a->getType()) {
+        case ExprType::Literal:
+            return static_cast<const LiteralExpr*>(a)->value == static_cast<const LiteralExpr*>(b)->value;
+        case ExprType::Variable:
+            return static_cast<const VariableExpr*>(a)->name.lexeme() == static_cast<const VariableExpr*>(b)->name.lexeme();
+        case ExprType::Unary: {
+            auto* ua = static_cast<const UnaryExpr*>(a);
+            auto* ub = static_cast<const UnaryExpr*>(b);
+            return ua->op.type == ub->op.type && sameExpr(ua->right.get(), ub->right.get());
+        }
+        case ExprType::Binary: {
+            auto* ba = static_cast<const BinaryExpr*>(a);
+            auto* bb = static_cast<const BinaryExpr*>(b);
+            return ba->op.type == bb->op.type && sameExpr(ba->left.get(), bb->left.get()) &&
+                   sameExpr(ba->right.get(), bb->right.get());
+        }
+        default:
+            return false;
+    }
+}
+
+void IRGenerator::collectWrites(const Expr* expr, LoopWrites& writes) {
+    if (!expr) return;
+
+    switch (expr->getType()) {
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            collectWrites(binary->left.get(), writes);
+            collectWrites(binary->right.get(), writes);
+            break;
+        }
+        case ExprType::Unary:
+            collectWrites(static_cast<const UnaryExpr*>(expr)->right.get(), writes);
+            break;
+        case ExprType::Assignment: {
+            auto* assign = static_cast<const AssignExpr*>(expr);
+            writes.names.insert(assign->name.lexeme());
+            writes.assigned.insert(assign->name.lexeme());
+            collectWrites(assign->value.get(), writes);
+            break;
+        }
+        case ExprType::Call: {
+            auto* call = static_cast<const CallExpr*>(expr);
+            writes.calls = true;
+            collectWrites(call->callee.get(), writes);
+            for (const auto& arg : call->arguments) {
+                collectWrites(arg.get(), writes);
+            }
+            break;
+        }
+        case ExprType::Grouping:
+            collectWrites(static_cast<const GroupingExpr*>(expr)->expression.get(), writes);
+            break;
+        case ExprType::Literal:
+        case ExprType::Variable:
+            break;
+    }
+}
+
+void IRGenerator::collectWrites(const Stmt* stmt, LoopWrites& writes) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            collectWrites(static_cast<const ExpressionStmt*>(stmt)->expression.get(), writes);
+            break;
+        case StmtType::Let: {
+            // A declaration may shadow a variable the condition reads
+            auto* let = static_cast<const LetStmt*>(stmt);
+            writes.names.insert(let->name.lexeme());
+            collectWrites(let->initializer.get(), writes);
+            break;
+        }
+        case StmtType::Function: {
+            // Writes in the body happen only through calls, but may reach globals
+            auto* function = static_cast<const FunctionStmt*>(stmt);
+            writes.names.insert(function->name.lexeme());
+            for (const auto& s : function->body) {
+                collectWrites(s.get(), writes);
+            }
+            break;
+        }
+        case StmtType::If: {
+            auto* ifStmt = static_cast<const IfStmt*>(stmt);
+            collectWrites(ifStmt->condition.get(), writes);
+            collectWrites(ifStmt->thenBranch.get(), writes);
+            collectWrites(ifStmt->elseBranch.get(), writes);
+            break;
+        }
+        case StmtType::While: {
+            auto* whileStmt = static_cast<const WhileStmt*>(stmt);
+            collectWrites(whileStmt->condition.get(), writes);
+            collectWrites(whileStmt->body.get(), writes);
+            break;
+        }
+        case StmtType::Return:
+            collectWrites(static_cast<const ReturnStmt*>(stmt)->value.get(), writes);
+            break;
+        case StmtType::Print:
+            collectWrites(static_cast<const PrintStmt*>(stmt)->expression.get(), writes);
+            break;
+        case StmtType::Block:
+            for (const auto& s : static_cast<const BlockStmt*>(stmt)->statements) {
+                collectWrites(s.get(), writes);
+            }
+            break;
+    }
+}
+
+bool IRGenerator::isLoopInvariant(const Expr* expr, const LoopWrites& writes) {
+    if (!expr) return false;
+    if (m_hoisted.contains(expr)) return true; // Hoisted by an enclosing loop
+
+    switch (expr->getType()) {
+        case ExprType::Literal:
+            return true;
+        case ExprType::Variable: {
+            std::string_view name = static_cast<const VariableExpr*>(expr)->name.lexeme();
+            if (writes.names.contains(name)) return false;
+            return resolveLocal(name) != -1 || !writes.calls;
+        }
+        case ExprType::Unary:
+            return isLoopInvariant(static_cast<const UnaryExpr*>(expr)->right.get(), writes);
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            return isLoopInvariant(binary->left.get(), writes) && isLoopInvariant(binary->right.get(), writes);
+        }
+        case ExprType::Grouping:
+            return isLoopInvariant(static_cast<const GroupingExpr*>(expr)->expression.get(), writes);
+        default:
+            return false;
+    }
+}
+
+void IRGenerator::findInvariants(Expr* expr, const LoopWrites& writes, bool& observable,
+                                 std::vector<Expr*>& invariants) {
+    expr = unwrap(expr);
+    if (!expr || m_hoisted.contains(expr)) return;
+
+    // Only operators are worth a local; a lone variable or literal is already one load
+    bool isOperator = expr->getType() == ExprType::Binary || expr->getType() == ExprType::Unary;
+    if (isOperator && isLoopInvariant(expr, writes)) {
+        if (observable) return;
+        bool repeated = std::any_of(invariants.begin(), invariants.end(),
+                                    [&](const Expr* invariant) { return sameExpr(invariant, expr); });
+        if (!repeated) invariants.push_back(expr);
+        return;
+    }
+
+    // Visit operands in evaluation order
+    switch (expr->getType()) {
+        case ExprType::Binary: {
+            auto* binary = static_cast<BinaryExpr*>(expr);
+            findInvariants(binary->left.get(), writes, observable, invariants);
+            findInvariants(binary->right.get(), writes, observable, invariants);
+            break;
+        }
+        case ExprType::Unary:
+            findInvariants(static_cast<UnaryExpr*>(expr)->right.get(), writes, observable, invariants);
+            break;
+        case ExprType::Assignment:
+            findInvariants(static_cast<AssignExpr*>(expr)->value.get(), writes, observable, invariants);
+            break;
+        case ExprType::Call: {
+            auto* call = static_cast<CallExpr*>(expr);
+            findInvariants(call->callee.get(), writes, observable, invariants);
+            for (const auto& arg : call->arguments) {
+                findInvariants(arg.get(), writes, observable, invariants);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    observable = observable || isObservable(expr);
+}
+
+void IRGenerator::reuseInvariants(Expr* expr, const std::vector<Expr*>& invariants,
+                                  std::vector<const Expr*>& reused) {
+    expr = unwrap(expr);
+    if (!expr || m_hoisted.contains(expr)) return;
+
+    for (const Expr* invariant : invariants) {
+        if (sameExpr(invariant, expr)) {
+            m_hoisted[expr] = m_hoisted[invariant];
+            reused.push_back(expr);
+            return;
+        }
+    }
+
+    switch (expr->getType()) {
+        case ExprType::Binary: {
+            auto* binary = static_cast<BinaryExpr*>(expr);
+            reuseInvariants(binary->left.get(), invariants, reused);
+            reuseInvariants(binary->right.get(), invariants, reused);
+            break;
+        }
+        case ExprType::Unary:
+            reuseInvariants(static_cast<UnaryExpr*>(expr)->right.get(), invariants, reused);
+            break;
+        case ExprType::Assignment:
+            reuseInvariants(static_cast<AssignExpr*>(expr)->value.get(), invariants, reused);
+            break;
+        case ExprType::Call: {
+            auto* call = static_cast<CallExpr*>(expr);
+            reuseInvariants(call->callee.get(), invariants, reused);
+            for (const auto& arg : call->arguments) {
+                reuseInvariants(arg.get(), invariants, reused);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void IRGenerator::reuseInvariants(Stmt* stmt, const std::vector<Expr*>& invariants,
+                                  std::vector<const Expr*>& reused) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            reuseInvariants(static_cast<ExpressionStmt*>(stmt)->expression.get(), invariants, reused);
+            break;
+        case StmtType::Let:
+            reuseInvariants(static_cast<LetStmt*>(stmt)->initializer.get(), invariants, reused);
+            break;
+        case StmtType::Function:
+            break; // Different frame
+        case StmtType::If: {
+            auto* ifStmt = static_cast<IfStmt*>(stmt);
+            reuseInvariants(ifStmt->condition.get(), invariants, reused);
+            reuseInvariants(ifStmt->thenBranch.get(), invariants, reused);
+            reuseInvariants(ifStmt->elseBranch.get(), invariants, reused);
+            break;
+        }
+        case StmtType::While: {
+            auto* whileStmt = static_cast<WhileStmt*>(stmt);
+            reuseInvariants(whileStmt->condition.get(), invariants, reused);
+            reuseInvariants(whileStmt->body.get(), invariants, reused);
+            break;
+        }
+        case StmtType::Return:
+            reuseInvariants(static_cast<ReturnStmt*>(stmt)->value.get(), invariants, reused);
+            break;
+        case StmtType::Print:
+            reuseInvariants(static_cast<PrintStmt*>(stmt)->expression.get(), invariants, reused);
+            break;
+        case StmtType::Block:
+            for (const auto& s : static_cast<BlockStmt*>(stmt)->statements) {
+                reuseInvariants(s.get(), invariants, reused);
+            }
+            break;
+    }
+}
+
+// Size of an inlinable expression in nodes, or 0 if it cannot be inlined
+// into `function`: it calls the function itself or assigns a parameter
+static size_t inlineCost(const Expr* expr, const FunctionStmt* function, bool& pure) {
+    if (!expr) return 1;
+
+    switch (expr->getType()) {
+        case ExprType::Literal:
+        case ExprType::Variable:
+            return 1;
+        case ExprType::Grouping:
+            return inlineCost(static_cast<const GroupingExpr*>(expr)->expression.get(), function, pure);
+        case ExprType::Unary: {
+            size_t cost = inlineCost(static_cast<const UnaryExpr*>(expr)->right.get(), function, pure);
+            return cost == 0 ? 0 : cost + 1;
+        }
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            size_t left = inlineCost(binary->left.get(), function, pure);
+            size_t right = inlineCost(binary->right.get(), function, pure);
+            return left == 0 || right == 0 ? 0 : left + right + 1;
+        }
+        case ExprType::Assignment: {
+            auto* assign = static_cast<const AssignExpr*>(expr);
+            for (const Token& param : function->params) {
+                if (param.lexeme() == assign->name.lexeme()) return 0;
+            }
+            pure = false;
+            size_t cost = inlineCost(assign->value.get(), function, pure);
+            return cost == 0 ? 0 : cost + 1;
+        }
+        case ExprType::Call: {
+            auto* call = static_cast<const CallExpr*>(expr);
+            const Expr* callee = unwrap(call->callee.get());
+            if (callee->getType() == ExprType::Variable &&
+                static_cast<const VariableExpr*>(callee)->name.lexeme() == function->name.lexeme()) {
+                return 0;
+            }
+            pure = false;
+            size_t cost = inlineCost(call->callee.get(), function, pure);
+            for (const auto& arg : call->arguments) {
+                size_t argCost = inlineCost(arg.get(), function, pure);
+                if (cost == 0 || argCost == 0) return 0;
+                cost += argCost;
+            }
+            return cost == 0 ? 0 : cost + 1;
+        }
+    }
+    return 0;
+}
+
+void IRGenerator::findInlineSafe(const Program& program) {
+    m_inlineSafe.clear();
+    if (!m_inlining) return;
+
+    LoopWrites writes;
+    std::unordered_map<std::string_view, size_t> declarations;
+    for (const auto& stmt : program) {
+        collectWrites(stmt.get(), writes);
+        if (stmt->getType() == StmtType::Let) {
+            declarations[static_cast<LetStmt*>(stmt.get())->name.lexeme()]++;
+        } else if (stmt->getType() == StmtType::Function) {
+            declarations[static_cast<FunctionStmt*>(stmt.get())->name.lexeme()]++;
+        }
+    }
+
+    // Earlier compilations may hold calls to a previous definition
+    for (const auto& stmt : program) {
+        if (stmt->getType() != StmtType::Function) continue;
+        std::string_view name = static_cast<FunctionStmt*>(stmt.get())->name.lexeme();
+        auto slot = m_globals.slots.find(name);
+        bool definedBefore = slot != m_globals.slots.end() && m_globals.defined[slot->second];
+        if (declarations[name] == 1 && !writes.assigned.contains(name) && !definedBefore) {
+            m_inlineSafe.insert(name);
+        }
+    }
+}
+
+void IRGenerator::addInlineCandidate(const FunctionStmt* stmt) {
+    if (!m_inlineSafe.contains(stmt->name.lexeme()) || stmt->body.size() != 1) return;
+    if (stmt->body[0]->getType() != StmtType::Return) return;
+
+    Expr* body = static_cast<ReturnStmt*>(stmt->body[0].get())->value.get();
+    bool pure = true;
+    size_t cost = inlineCost(body, stmt, pure);
+    if (cost == 0 || cost > INLINE_BUDGET) return;
+
+    m_inlineCandidates[stmt->name.lexeme()] = {stmt, body, pure};
+}
+
+const IRGenerator::InlineCandidate* IRGenerator::findInlineCandidate(const CallExpr* expr) {
+    const Expr* callee = unwrap(expr->callee.get());
+    if (m_inlineCandidates.empty() || callee->getType() != ExprType::Variable) return nullptr;
+
+    std::string_view name = static_cast<const VariableExpr*>(callee)->name.lexeme();
+    auto it = m_inlineCandidates.find(name);
+    if (it == m_inlineCandidates.end()) return nullptr;
+
+    // A local or parameter of the same name shadows the function
+    if (resolveVariable(name, m_inlineFrames.size()).kind != VariableRef::Kind::GLOBAL) return nullptr;
+
+    const InlineCandidate& candidate = it->second;
+    if (expr->arguments.size() != candidate.function->params.size()) return nullptr; // Arity error at runtime
+    for (const InlineFrame& frame : m_inlineFrames) {
+        if (frame.function == candidate.function) return nullptr; // Mutual recursion
+    }
+    return &candidate;
+}
+
+void IRGenerator::compileInlineCall(CallExpr* expr, const InlineCandidate& candidate) {
+    bool argsAssign = false;
+    bool argsCall = false;
+    {
+        LoopWrites writes;
+        for (const auto& arg : expr->arguments) {
+            collectWrites(arg.get(), writes);
+        }
+        argsAssign = !writes.assigned.empty();
+        argsCall = writes.calls || argsAssign;
+    }
+
+    // Slots of pushed arguments start at the current top of the stack
+    uint32_t base = static_cast<uint32_t>(m_locals.size() + m_temps);
+    InlineFrame frame{candidate.function, {}, {}};
+    uint32_t pushed = 0;
+    for (const auto& arg : expr->arguments) {
+        Expr* argument = unwrap(arg.get());
+
+        // Reading the argument at each use gives the value it had at the call
+        bool substitute = argument->getType() == ExprType::Literal;
+        if (argument->getType() == ExprType::Variable) {
+            VariableRef variable =
+                resolveVariable(static_cast<VariableExpr*>(argument)->name.lexeme(), m_inlineFrames.size());
+            substitute = variable.kind == VariableRef::Kind::GLOBAL ? !argsCall && candidate.pure : !argsAssign;
+        }
+
+        if (substitute) {
+            frame.arguments.push_back(argument);
+            frame.slots.push_back(0);
+        } else {
+            compileExpr(argument);
+            frame.arguments.push_back(nullptr);
+            frame.slots.push_back(base + pushed++);
+        }
+    }
+    m_chunk.localCount = std::max(m_chunk.localCount, static_cast<size_t>(base + pushed));
+
+    m_inlineFrames.push_back(std::move(frame));
+    compileExpr(candidate.body);
+    m_inlineFrames.pop_back();
+
+    // Move the result down over the pushed arguments
+    if (pushed > 0) {
+        emitByte(OpCode::OP_SET_LOCAL_POP, base);
+        for (uint32_t i = 1; i < pushed; i++) {
+            emitByte(OpCode::OP_POP);
+        }
+    }
+}
+
 void IRGenerator::error(const std::string& message) {
     m_hadError = true;
     m_error = message;
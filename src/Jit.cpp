@@ -0,0 +1,1075 @@
+#include "Jit.hpp"
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+
+#if MINILANG_JIT
+#include <sys/mman.h>
+#endif
+
+namespace minilang {
+
+#if MINILANG_JIT
+
+/**
+ * Raw NaN-box encodings the templates compare against
+ */
+struct JitEncoding {
+    uint64_t qnan;
+    uint64_t nil;
+    uint64_t falseBits;
+    uint64_t trueBits;
+    uint64_t undefined;
+};
+
+namespace {
+
+// x86-64 general purpose registers by encoding
+enum Reg : uint8_t {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R12 = 12, R13 = 13, R14 = 14, R15 = 15,
+};
+
+// Condition codes for jcc/setcc
+enum Cond : uint8_t {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_P = 0xA, CC_NP = 0xB,
+};
+
+// Register roles inside native code; all callee-saved so they survive helper calls
+constexpr Reg STACK_TOP = RBX;
+constexpr Reg CONTEXT = RBP;
+constexpr Reg QNAN_REG = R12;
+constexpr Reg SLOTS = R13;
+constexpr Reg GLOBALS = R14;
+constexpr Reg CONSTANTS = R15;
+
+constexpr int32_t SLOT = static_cast<int32_t>(sizeof(Value));
+
+/**
+ * Minimal x86-64 encoder covering the instructions the templates use
+ */
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    size_t size() const { return code.size(); }
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> bs) { code.insert(code.end(), bs); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    // REX prefix; omitted when it would carry no bits
+    void rex(bool wide, uint8_t reg, uint8_t rm) {
+        uint8_t prefix = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+        if (prefix != 0x40) byte(prefix);
+    }
+    void modrmReg(uint8_t reg, uint8_t rm) { byte(static_cast<uint8_t>(0xC0 | ((reg & 7) << 3) | (rm & 7))); }
+    void modrmMem(uint8_t reg, Reg base, int32_t disp) {
+        byte(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP) byte(0x24);
+        u32(static_cast<uint32_t>(disp));
+    }
+
+    // mov dst, [base + disp]
+    void load(Reg dst, Reg base, int32_t disp) {
+        rex(true, dst, base);
+        byte(0x8B);
+        modrmMem(dst, base, disp);
+    }
+    // mov [base + disp], src
+    void store(Reg base, int32_t disp, Reg src) {
+        rex(true, src, base);
+        byte(0x89);
+        modrmMem(src, base, disp);
+    }
+    // mov dst, imm64
+    void movImm(Reg dst, uint64_t imm) {
+        rex(true, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        u64(imm);
+    }
+    // Two-register ALU op in the "op r/m64, r64" form: 0x89 mov, 0x01 add, 0x09 or, 0x21 and, 0x39 cmp
+    void alu(uint8_t opcode, Reg dst, Reg src) {
+        rex(true, src, dst);
+        byte(opcode);
+        modrmReg(src, dst);
+    }
+    void mov(Reg dst, Reg src) { alu(0x89, dst, src); }
+    // add/sub dst, imm32
+    void addImm(Reg dst, int32_t imm) {
+        rex(true, 0, dst);
+        byte(0x81);
+        modrmReg(0, dst);
+        u32(static_cast<uint32_t>(imm));
+    }
+    void subImm(Reg dst, int32_t imm) {
+        rex(true, 0, dst);
+        byte(0x81);
+        modrmReg(5, dst);
+        u32(static_cast<uint32_t>(imm));
+    }
+    // lea dst, [dst + disp]: adjusts a pointer without touching flags
+    void leaSelf(Reg dst, int32_t disp) {
+        rex(true, dst, dst);
+        byte(0x8D);
+        modrmMem(dst, dst, disp);
+    }
+
+    void push(Reg r) {
+        rex(false, 0, r);
+        byte(static_cast<uint8_t>(0x50 + (r & 7)));
+    }
+    void pop(Reg r) {
+        rex(false, 0, r);
+        byte(static_cast<uint8_t>(0x58 + (r & 7)));
+    }
+
+    // movq xmm, r64 / movq r64, xmm
+    void movqToXmm(uint8_t xmm, Reg src) {
+        byte(0x66);
+        rex(true, xmm, src);
+        bytes({0x0F, 0x6E});
+        modrmReg(xmm, src);
+    }
+    void movqFromXmm(Reg dst, uint8_t xmm) {
+        byte(0x66);
+        rex(true, xmm, dst);
+        bytes({0x0F, 0x7E});
+        modrmReg(xmm, dst);
+    }
+    // Scalar double op xmm-dst, xmm-src: prefix 0xF2 with 0x58 add, 0x5C sub, 0x59 mul, 0x5E div;
+    // prefix 0x66 with 0x2E ucomisd
+    void sse(uint8_t prefix, uint8_t opcode, uint8_t dst, uint8_t src) {
+        bytes({prefix, 0x0F, opcode});
+        modrmReg(dst, src);
+    }
+
+    // setcc on the low byte of rax (al) or rcx (cl)
+    void setcc(Cond cc, Reg r) {
+        bytes({0x0F, static_cast<uint8_t>(0x90 | cc)});
+        modrmReg(0, r);
+    }
+
+    // Jumps with a 32-bit displacement; return where to patch it
+    size_t jcc(Cond cc) {
+        bytes({0x0F, static_cast<uint8_t>(0x80 | cc)});
+        u32(0);
+        return size() - 4;
+    }
+    size_t jmp() {
+        byte(0xE9);
+        u32(0);
+        return size() - 4;
+    }
+    void patch(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(&code[at], &rel, sizeof(rel));
+    }
+};
+
+/**
+ * Machine-code templates shared by the method and trace compilers
+ *
+ * Code starts with an entry stub that loads the interpreter state into
+ * fixed registers and jumps to the requested entry point. Guards record
+ * the bytecode index to resume at; finish() turns those into exit stubs,
+ * resolves jumps to labels and maps the result executable.
+ */
+class Emitter {
+public:
+    Assembler a;
+
+    explicit Emitter(const JitEncoding& encoding) : m_enc(encoding) {
+        // Save callee-saved registers, load the context, then jump to the
+        // entry point in rsi. Six pushes plus the adjustment keep rsp
+        // 16-byte aligned for helper calls.
+        a.push(RBX);
+        a.push(RBP);
+        a.push(R12);
+        a.push(R13);
+        a.push(R14);
+        a.push(R15);
+        a.subImm(RSP, 8);
+        a.mov(CONTEXT, RDI);
+        a.load(STACK_TOP, CONTEXT, offsetof(JitContext, stackTop));
+        a.load(SLOTS, CONTEXT, offsetof(JitContext, slots));
+        a.load(GLOBALS, CONTEXT, offsetof(JitContext, globals));
+        a.load(CONSTANTS, CONTEXT, offsetof(JitContext, constants));
+        a.movImm(QNAN_REG, m_enc.qnan);
+        a.bytes({0xFF, 0xE6}); // jmp rsi
+
+        // Shared exit: eax holds the instruction index to resume at
+        m_commonExit = a.size();
+        a.store(CONTEXT, offsetof(JitContext, stackTop), STACK_TOP);
+        a.addImm(RSP, 8);
+        a.pop(R15);
+        a.pop(R14);
+        a.pop(R13);
+        a.pop(R12);
+        a.pop(RBP);
+        a.pop(RBX);
+        a.byte(0xC3); // ret
+    }
+
+    const JitEncoding& encoding() const { return m_enc; }
+
+    // Control transfers, resolved by finish()
+    void jumpTo(size_t label) { m_labelFixups.emplace_back(a.jmp(), label); }
+    void branchTo(Cond cc, size_t label) { m_labelFixups.emplace_back(a.jcc(cc), label); }
+    void exitIf(Cond cc, size_t pc) { m_exitFixups.emplace_back(a.jcc(cc), pc); }
+    void exitAt(size_t pc) { m_exitFixups.emplace_back(a.jmp(), pc); }
+
+    // Type guard: leave native code at pc unless reg holds a number
+    void guardNumber(Reg reg, size_t pc) {
+        a.mov(RCX, reg);
+        a.alu(0x21, RCX, QNAN_REG);
+        a.alu(0x39, RCX, QNAN_REG);
+        exitIf(CC_E, pc);
+    }
+
+    // Leave native code at pc when a global has not been assigned yet
+    void guardDefined(Reg reg, size_t pc) {
+        a.movImm(RDX, m_enc.undefined);
+        a.alu(0x39, reg, RDX);
+        exitIf(CC_E, pc);
+    }
+
+    // Type guard for the value types traces specialize on
+    void guardType(Reg reg, ValueType type, size_t pc) {
+        switch (type) {
+            case ValueType::NUMBER:
+                guardNumber(reg, pc);
+                break;
+            case ValueType::BOOL:
+                a.mov(RCX, reg);
+                a.bytes({0x48, 0x83, 0xC9, 0x01}); // or rcx, 1
+                a.movImm(RDX, m_enc.trueBits);
+                a.alu(0x39, RCX, RDX);
+                exitIf(CC_NE, pc);
+                break;
+            default:
+                a.movImm(RDX, m_enc.nil);
+                a.alu(0x39, reg, RDX);
+                exitIf(CC_NE, pc);
+                break;
+        }
+    }
+
+    // Load the top two stack values into xmm0 (left) and xmm1 (right),
+    // keeping the raw right operand in rdx
+    void loadNumbers(size_t pc, bool guard = true) {
+        a.load(RAX, STACK_TOP, -2 * SLOT);
+        a.load(RDX, STACK_TOP, -SLOT);
+        if (guard) {
+            guardNumber(RAX, pc);
+            guardNumber(RDX, pc);
+        }
+        a.movqToXmm(0, RAX);
+        a.movqToXmm(1, RDX);
+    }
+
+    // Leave native code at pc when the right operand in rdx is +/-0.0
+    void guardNonZero(size_t pc) {
+        a.mov(RCX, RDX);
+        a.alu(0x01, RCX, RCX);
+        exitIf(CC_E, pc);
+    }
+
+    // Scalar double ops on xmm0, xmm1; sse opcode 0x58 add, 0x5C sub, 0x59 mul, 0x5E div
+    void arithmetic(uint8_t opcode) { a.sse(0xF2, opcode, 0, 1); }
+    // Operands proven integral skip the check for a fraction
+    void remainder(bool integer) {
+        a.movImm(RAX, reinterpret_cast<uint64_t>(integer ? &integerModulo : &numberModulo));
+        a.bytes({0xFF, 0xD0}); // call rax
+    }
+    void negate() { a.bytes({0x48, 0x0F, 0xBA, 0xF8, 0x3F}); } // btc rax, 63
+
+    // Compare xmm0 with xmm1 and leave the result in al
+    void compare(OpCode op) {
+        switch (op) {
+            case OpCode::OP_EQUAL:
+            case OpCode::OP_EQUAL_NUM:
+                a.sse(0x66, 0x2E, 0, 1);
+                a.setcc(CC_E, RAX);
+                a.setcc(CC_NP, RCX);
+                a.bytes({0x20, 0xC8}); // and al, cl
+                break;
+            case OpCode::OP_NOT_EQUAL:
+            case OpCode::OP_NOT_EQUAL_NUM:
+                a.sse(0x66, 0x2E, 0, 1);
+                a.setcc(CC_NE, RAX);
+                a.setcc(CC_P, RCX);
+                a.bytes({0x08, 0xC8}); // or al, cl
+                break;
+            case OpCode::OP_LESS:
+                a.sse(0x66, 0x2E, 1, 0);
+                a.setcc(CC_A, RAX);
+                break;
+            case OpCode::OP_LESS_EQUAL:
+                a.sse(0x66, 0x2E, 1, 0);
+                a.setcc(CC_AE, RAX);
+                break;
+            case OpCode::OP_GREATER:
+                a.sse(0x66, 0x2E, 0, 1);
+                a.setcc(CC_A, RAX);
+                break;
+            default:
+                a.sse(0x66, 0x2E, 0, 1);
+                a.setcc(CC_AE, RAX);
+                break;
+        }
+    }
+
+    // Compare xmm0 with xmm1 for a fused OP_JUMP_IF_NOT_* and pop both
+    // operands; returns the condition under which the branch is taken
+    Cond compareAndPop(OpCode op) {
+        bool less = op == OpCode::OP_JUMP_IF_NOT_LESS || op == OpCode::OP_JUMP_IF_NOT_LESS_EQUAL;
+        bool orEqual = op == OpCode::OP_JUMP_IF_NOT_LESS_EQUAL || op == OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL;
+        a.sse(0x66, 0x2E, less ? 1 : 0, less ? 0 : 1);
+        a.leaSelf(STACK_TOP, -2 * SLOT); // lea leaves the flags alone
+        return orEqual ? CC_B : CC_BE;
+    }
+
+    // Replace the top two stack values with xmm0
+    void storeNumber() {
+        a.movqFromXmm(RAX, 0);
+        a.store(STACK_TOP, -2 * SLOT, RAX);
+        a.subImm(STACK_TOP, SLOT);
+    }
+
+    // Turn eax (0 or 1) into a boolean Value
+    void boolFromEax() {
+        a.movImm(RCX, m_enc.falseBits);
+        a.alu(0x01, RAX, RCX);
+    }
+
+    // Replace the top two stack values with the boolean in al
+    void storeCompare() {
+        a.bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+        boolFromEax();
+        a.store(STACK_TOP, -2 * SLOT, RAX);
+        a.subImm(STACK_TOP, SLOT);
+    }
+
+    // eax = isFalsey(rax); clobbers rcx and rdx. A known boolean skips
+    // the checks for the other types.
+    void falsey(bool knownBool = false) {
+        if (knownBool) {
+            a.movImm(RDX, m_enc.trueBits);
+            a.alu(0x39, RAX, RDX);
+            a.setcc(CC_NE, RAX);
+            a.bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+            return;
+        }
+
+        a.mov(RCX, RAX);
+        a.bytes({0x48, 0x83, 0xC9, 0x01}); // or rcx, 1
+        a.movImm(RDX, m_enc.trueBits);
+        a.alu(0x39, RCX, RDX);
+        size_t notBool = a.jcc(CC_NE);
+        a.alu(0x39, RAX, RDX);
+        a.setcc(CC_NE, RAX);
+        size_t boolDone = a.jmp();
+
+        a.patch(notBool, a.size());
+        a.movImm(RDX, m_enc.nil);
+        a.alu(0x39, RAX, RDX);
+        size_t notNil = a.jcc(CC_NE);
+        a.bytes({0xB0, 0x01}); // mov al, 1
+        size_t nilDone = a.jmp();
+
+        a.patch(notNil, a.size());
+        a.mov(RCX, RAX);
+        a.alu(0x21, RCX, QNAN_REG);
+        a.alu(0x39, RCX, QNAN_REG);
+        size_t isNumber = a.jcc(CC_NE);
+        a.bytes({0x31, 0xC0}); // xor eax, eax: objects are truthy
+        size_t objDone = a.jmp();
+
+        a.patch(isNumber, a.size());
+        a.mov(RCX, RAX);
+        a.alu(0x01, RCX, RCX); // Zero flag set for +/-0.0
+        a.setcc(CC_E, RAX);
+
+        a.patch(boolDone, a.size());
+        a.patch(nilDone, a.size());
+        a.patch(objDone, a.size());
+        a.bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+    }
+
+    // Combine isFalsey of the top two values (eax, r8) into a boolean for OP_AND/OP_OR
+    void logical(OpCode op) {
+        if (op == OpCode::OP_AND) {
+            a.bytes({0x44, 0x09, 0xC0}); // or eax, r8d: either falsey
+        } else {
+            a.bytes({0x44, 0x21, 0xC0}); // and eax, r8d: both falsey
+        }
+        a.bytes({0x83, 0xF0, 0x01}); // xor eax, 1
+        boolFromEax();
+        a.store(STACK_TOP, -2 * SLOT, RAX);
+        a.subImm(STACK_TOP, SLOT);
+    }
+
+    void pushRax() {
+        a.store(STACK_TOP, 0, RAX);
+        a.addImm(STACK_TOP, SLOT);
+    }
+
+    /**
+     * Emit exit stubs, resolve labels and map the code executable
+     * entries are the native offsets JitCode::run() may start at
+     */
+    std::unique_ptr<JitCode> finish(std::vector<uint32_t> entries, const std::vector<uint32_t>& labels) {
+        // One exit stub per instruction index that can leave native code
+        std::unordered_map<size_t, size_t> exitStubs;
+        for (const auto& [at, pc] : m_exitFixups) {
+            auto [it, inserted] = exitStubs.try_emplace(pc, a.size());
+            if (inserted) {
+                a.byte(0xB8); // mov eax, imm32
+                a.u32(static_cast<uint32_t>(pc));
+                a.patch(a.jmp(), m_commonExit);
+            }
+            a.patch(at, it->second);
+        }
+        for (const auto& [at, label] : m_labelFixups) {
+            a.patch(at, labels[label]);
+        }
+
+        // Map writable, copy, then flip to executable
+        size_t size = a.size();
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        std::memcpy(memory, a.code.data(), size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+        return std::make_unique<JitCode>(static_cast<uint8_t*>(memory), size, std::move(entries));
+    }
+
+private:
+    JitEncoding m_enc;
+    size_t m_commonExit = 0;
+    std::vector<std::pair<size_t, size_t>> m_labelFixups; // Patch site, label index
+    std::vector<std::pair<size_t, size_t>> m_exitFixups;  // Patch site, instruction index
+};
+
+} // namespace
+
+JitCode::~JitCode() {
+    munmap(m_memory, m_size);
+}
+
+size_t JitCode::run(JitContext& context, size_t entry) const {
+    using Entry = uint32_t (*)(JitContext*, const void*);
+    auto stub = reinterpret_cast<Entry>(m_memory);
+    return stub(&context, m_memory + m_entries[entry]);
+}
+
+JitEncoding Jit::encoding() {
+    return {Value::QNAN, Value::QNAN | Value::TAG_NIL, Value::FALSE_BITS, Value::TRUE_BITS,
+            Value::QNAN | Value::TAG_UNDEFINED};
+}
+
+const JitCode* Jit::install(std::unique_ptr<JitCode> code) {
+    if (!code) {
+        return nullptr;
+    }
+    m_codeSize += code->size();
+    m_code.push_back(std::move(code));
+    return m_code.back().get();
+}
+
+const JitCode* Jit::compile(const Chunk& chunk) {
+    Emitter e(encoding());
+    Assembler& a = e.a;
+    const size_t count = chunk.code.size();
+
+    // Every instruction is an entry point and a jump label
+    std::vector<uint32_t> offsets(count + 1);
+
+    for (size_t pc = 0; pc < count; pc++) {
+        offsets[pc] = static_cast<uint32_t>(a.size());
+        const Instruction& instruction = chunk.code[pc];
+        const uint32_t operand = instruction.operand;
+        const int32_t operandDisp = static_cast<int32_t>(operand) * SLOT;
+
+        // Typed forms share their generic template without the type guards
+        const OpCode opcode = untypedOpcode(instruction.opcode);
+        const bool guard = opcode == instruction.opcode;
+
+        switch (opcode) {
+            case OpCode::OP_CONSTANT:
+                a.load(RAX, CONSTANTS, operandDisp);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_NIL:
+                a.movImm(RAX, e.encoding().nil);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_TRUE:
+                a.movImm(RAX, e.encoding().trueBits);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_FALSE:
+                a.movImm(RAX, e.encoding().falseBits);
+                e.pushRax();
+                break;
+
+            // Arithmetic: numbers only, anything else is left to the interpreter
+            case OpCode::OP_ADD:
+            case OpCode::OP_ADD_NUM:
+                e.loadNumbers(pc, guard);
+                e.arithmetic(0x58);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_SUBTRACT:
+                e.loadNumbers(pc, guard);
+                e.arithmetic(0x5C);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_MULTIPLY:
+                e.loadNumbers(pc, guard);
+                e.arithmetic(0x59);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_DIVIDE:
+                e.loadNumbers(pc, guard);
+                e.guardNonZero(pc);
+                e.arithmetic(0x5E);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_MODULO:
+                e.loadNumbers(pc, guard);
+                e.guardNonZero(pc);
+                e.remainder(instruction.opcode == OpCode::OP_INT_MODULO);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_NEGATE:
+                a.load(RAX, STACK_TOP, -SLOT);
+                if (guard) e.guardNumber(RAX, pc);
+                e.negate();
+                a.store(STACK_TOP, -SLOT, RAX);
+                break;
+
+            // Comparison
+            case OpCode::OP_EQUAL:
+            case OpCode::OP_EQUAL_NUM:
+            case OpCode::OP_NOT_EQUAL:
+            case OpCode::OP_NOT_EQUAL_NUM:
+            case OpCode::OP_LESS:
+            case OpCode::OP_LESS_EQUAL:
+            case OpCode::OP_GREATER:
+            case OpCode::OP_GREATER_EQUAL:
+                e.loadNumbers(pc, guard);
+                e.compare(opcode);
+                e.storeCompare();
+                break;
+
+            // Logical
+            case OpCode::OP_NOT:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.falsey();
+                e.boolFromEax();
+                a.store(STACK_TOP, -SLOT, RAX);
+                break;
+
+            case OpCode::OP_AND:
+            case OpCode::OP_OR:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.falsey();
+                a.mov(R8, RAX);
+                a.load(RAX, STACK_TOP, -2 * SLOT);
+                e.falsey();
+                e.logical(opcode);
+                break;
+
+            // Variables
+            case OpCode::OP_GET_LOCAL:
+                a.load(RAX, SLOTS, operandDisp);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_SET_LOCAL:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.store(SLOTS, operandDisp, RAX);
+                break;
+
+            case OpCode::OP_SET_LOCAL_POP:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.store(SLOTS, operandDisp, RAX);
+                a.subImm(STACK_TOP, SLOT);
+                break;
+
+            case OpCode::OP_GET_GLOBAL:
+                a.load(RAX, GLOBALS, operandDisp);
+                e.guardDefined(RAX, pc);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_SET_GLOBAL:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.store(GLOBALS, operandDisp, RAX);
+                break;
+
+            case OpCode::OP_SET_GLOBAL_POP:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.store(GLOBALS, operandDisp, RAX);
+                a.subImm(STACK_TOP, SLOT);
+                break;
+
+            case OpCode::OP_POP:
+                a.subImm(STACK_TOP, SLOT);
+                break;
+
+            // Control flow
+            case OpCode::OP_JUMP:
+                e.jumpTo(pc + 1 + operand);
+                break;
+
+            case OpCode::OP_LOOP:
+                e.jumpTo(pc + 1 - operand);
+                break;
+
+            case OpCode::OP_JUMP_IF_FALSE:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.falsey();
+                a.bytes({0x84, 0xC0}); // test al, al
+                e.branchTo(CC_NE, pc + 1 + operand);
+                break;
+
+            case OpCode::OP_POP_JUMP_IF_FALSE:
+            case OpCode::OP_POP_JUMP_IF_TRUE:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.subImm(STACK_TOP, SLOT);
+                e.falsey();
+                a.bytes({0x84, 0xC0}); // test al, al
+                e.branchTo(opcode == OpCode::OP_POP_JUMP_IF_FALSE ? CC_NE : CC_E, pc + 1 + operand);
+                break;
+
+            // Fused compare-and-branch
+            case OpCode::OP_JUMP_IF_NOT_LESS:
+            case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+            case OpCode::OP_JUMP_IF_NOT_GREATER:
+            case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL:
+                e.loadNumbers(pc, guard);
+                e.branchTo(e.compareAndPop(opcode), pc + 1 + operand);
+                break;
+
+            case OpCode::OP_ADD_LOCAL_CONSTANT:
+            case OpCode::OP_ADD_GLOBAL_CONSTANT: {
+                Reg base = opcode == OpCode::OP_ADD_LOCAL_CONSTANT ? SLOTS : GLOBALS;
+                uint32_t constant = operand >> PAIR_OPERAND_BITS;
+                if (!chunk.constants[constant].isNumber()) {
+                    e.exitAt(pc);
+                    break;
+                }
+                a.load(RAX, base, static_cast<int32_t>(operand & PAIR_OPERAND_MAX) * SLOT);
+                if (guard) e.guardNumber(RAX, pc);
+                a.load(RDX, CONSTANTS, static_cast<int32_t>(constant) * SLOT);
+                a.movqToXmm(0, RAX);
+                a.movqToXmm(1, RDX);
+                e.arithmetic(0x58);
+                a.movqFromXmm(RAX, 0);
+                e.pushRax();
+                break;
+            }
+
+            // Calls, returns, strings and printing stay in the interpreter
+            default:
+                e.exitAt(pc);
+                break;
+        }
+    }
+
+    // Falling off the end resumes the interpreter there too
+    offsets[count] = static_cast<uint32_t>(a.size());
+    e.exitAt(count);
+
+    std::vector<uint32_t> labels = offsets;
+    return install(e.finish(std::move(offsets), labels));
+}
+
+namespace {
+
+// Variables are keyed by kind and slot
+uint64_t variableKey(bool global, uint32_t slot) {
+    return static_cast<uint64_t>(global) << 32 | slot;
+}
+
+bool isGlobalAccess(OpCode op) {
+    return op == OpCode::OP_GET_GLOBAL || op == OpCode::OP_SET_GLOBAL || op == OpCode::OP_SET_GLOBAL_POP ||
+           op == OpCode::OP_ADD_GLOBAL_CONSTANT;
+}
+
+uint32_t variableSlot(const TraceStep& step) {
+    bool paired = step.opcode == OpCode::OP_ADD_LOCAL_CONSTANT || step.opcode == OpCode::OP_ADD_GLOBAL_CONSTANT;
+    return paired ? step.operand & PAIR_OPERAND_MAX : step.operand;
+}
+
+/**
+ * Apply a traced instruction's effect to the types on the value stack
+ * Every type is known: constants and operators have fixed result types
+ * and variable reads are guarded to the type observed while recording
+ */
+void applyTypes(const Chunk& chunk, const TraceStep& step, std::vector<ValueType>& stack) {
+    auto pop = [&](size_t n) { stack.resize(stack.size() - n); };
+
+    switch (step.opcode) {
+        case OpCode::OP_CONSTANT: stack.push_back(chunk.constants[step.operand].type()); break;
+        case OpCode::OP_NIL: stack.push_back(ValueType::NIL); break;
+        case OpCode::OP_TRUE:
+        case OpCode::OP_FALSE: stack.push_back(ValueType::BOOL); break;
+
+        case OpCode::OP_NEGATE: pop(1); stack.push_back(ValueType::NUMBER); break;
+        case OpCode::OP_NOT: pop(1); stack.push_back(ValueType::BOOL); break;
+
+        case OpCode::OP_ADD:
+        case OpCode::OP_ADD_NUM:
+        case OpCode::OP_SUBTRACT:
+        case OpCode::OP_MULTIPLY:
+        case OpCode::OP_DIVIDE:
+        case OpCode::OP_MODULO:
+            pop(2);
+            stack.push_back(ValueType::NUMBER);
+            break;
+
+        case OpCode::OP_EQUAL:
+        case OpCode::OP_EQUAL_NUM:
+        case OpCode::OP_NOT_EQUAL:
+        case OpCode::OP_NOT_EQUAL_NUM:
+        case OpCode::OP_LESS:
+        case OpCode::OP_LESS_EQUAL:
+        case OpCode::OP_GREATER:
+        case OpCode::OP_GREATER_EQUAL:
+        case OpCode::OP_AND:
+        case OpCode::OP_OR:
+            pop(2);
+            stack.push_back(ValueType::BOOL);
+            break;
+
+        case OpCode::OP_GET_LOCAL:
+        case OpCode::OP_GET_GLOBAL: stack.push_back(step.observed); break;
+        case OpCode::OP_ADD_LOCAL_CONSTANT:
+        case OpCode::OP_ADD_GLOBAL_CONSTANT: stack.push_back(ValueType::NUMBER); break;
+
+        case OpCode::OP_SET_LOCAL_POP:
+        case OpCode::OP_SET_GLOBAL_POP:
+        case OpCode::OP_POP:
+        case OpCode::OP_POP_JUMP_IF_FALSE:
+        case OpCode::OP_POP_JUMP_IF_TRUE: pop(1); break;
+
+        case OpCode::OP_JUMP_IF_NOT_LESS:
+        case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+        case OpCode::OP_JUMP_IF_NOT_GREATER:
+        case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL: pop(2); break;
+
+        default: break;
+    }
+}
+
+} // namespace
+
+const JitCode* Jit::compileTrace(const Chunk& chunk, const Trace& trace) {
+    // Find the variables whose type is the same on every trip around the
+    // loop: read before being written, and only ever written with the type
+    // first read. Those are guarded once before the loop instead of at
+    // every read.
+    struct Variable {
+        bool liveIn = false;
+        bool stable = true;
+        ValueType type = ValueType::NIL;
+        uint32_t slot = 0;
+        bool global = false;
+    };
+    std::unordered_map<uint64_t, Variable> variables;
+    std::vector<uint64_t> order; // Deterministic guard order
+
+    std::vector<ValueType> stack;
+    for (const TraceStep& step : trace.steps) {
+        bool global = isGlobalAccess(step.opcode);
+        uint32_t slot = variableSlot(step);
+        uint64_t key = variableKey(global, slot);
+
+        switch (step.opcode) {
+            case OpCode::OP_GET_LOCAL:
+            case OpCode::OP_GET_GLOBAL:
+            case OpCode::OP_ADD_LOCAL_CONSTANT:
+            case OpCode::OP_ADD_GLOBAL_CONSTANT:
+                if (!variables.count(key)) {
+                    ValueType type = step.opcode == OpCode::OP_GET_LOCAL || step.opcode == OpCode::OP_GET_GLOBAL
+                                         ? step.observed
+                                         : ValueType::NUMBER;
+                    variables[key] = {true, true, type, slot, global};
+                    order.push_back(key);
+                }
+                break;
+
+            case OpCode::OP_SET_LOCAL:
+            case OpCode::OP_SET_LOCAL_POP:
+            case OpCode::OP_SET_GLOBAL:
+            case OpCode::OP_SET_GLOBAL_POP: {
+                auto [it, inserted] = variables.try_emplace(key);
+                if (inserted) {
+                    it->second = {false, false, stack.back(), slot, global};
+                } else if (it->second.liveIn && it->second.type != stack.back()) {
+                    it->second.stable = false;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+        applyTypes(chunk, step, stack);
+    }
+
+    Emitter e(encoding());
+    Assembler& a = e.a;
+    const size_t header = trace.header;
+
+    // Pre-header: check the loop-invariant types, exiting to the header
+    std::unordered_map<uint64_t, ValueType> known;
+    uint32_t entry = static_cast<uint32_t>(a.size());
+    for (uint64_t key : order) {
+        const Variable& variable = variables[key];
+        if (variable.liveIn && variable.stable) {
+            a.load(RAX, variable.global ? GLOBALS : SLOTS, static_cast<int32_t>(variable.slot) * SLOT);
+            e.guardType(RAX, variable.type, header);
+            known[key] = variable.type;
+        }
+    }
+
+    // Loop body: one straight line, branches become guards on the
+    // direction seen while recording
+    uint32_t loop = static_cast<uint32_t>(a.size());
+    stack.clear();
+
+    for (const TraceStep& step : trace.steps) {
+        const size_t pc = step.pc;
+        const uint32_t operand = step.operand;
+        const bool global = isGlobalAccess(step.opcode);
+        const Reg base = global ? GLOBALS : SLOTS;
+        const uint32_t slot = variableSlot(step);
+        const uint64_t key = variableKey(global, slot);
+        const int32_t slotDisp = static_cast<int32_t>(slot) * SLOT;
+
+        // Read a variable into rax, guarding its type unless already known
+        auto readVariable = [&](ValueType type) {
+            a.load(RAX, base, slotDisp);
+            auto it = known.find(key);
+            if (it == known.end() || it->second != type) {
+                e.guardType(RAX, type, pc);
+                known[key] = type;
+            }
+        };
+
+        // Branch guard: stay on the trace only if the branch goes the recorded way
+        auto guardBranch = [&](Cond jumpIf) {
+            size_t target = pc + 1 + operand;
+            if (step.taken) {
+                e.exitIf(static_cast<Cond>(jumpIf ^ 1), pc + 1);
+            } else {
+                e.exitIf(jumpIf, target);
+            }
+        };
+
+        switch (step.opcode) {
+            case OpCode::OP_CONSTANT:
+                a.load(RAX, CONSTANTS, static_cast<int32_t>(operand) * SLOT);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_NIL:
+                a.movImm(RAX, e.encoding().nil);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_TRUE:
+                a.movImm(RAX, e.encoding().trueBits);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_FALSE:
+                a.movImm(RAX, e.encoding().falseBits);
+                e.pushRax();
+                break;
+
+            // Operand types are known numbers; no guards needed
+            case OpCode::OP_ADD:
+            case OpCode::OP_ADD_NUM:
+                e.loadNumbers(pc, false);
+                e.arithmetic(0x58);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_SUBTRACT:
+                e.loadNumbers(pc, false);
+                e.arithmetic(0x5C);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_MULTIPLY:
+                e.loadNumbers(pc, false);
+                e.arithmetic(0x59);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_DIVIDE:
+                e.loadNumbers(pc, false);
+                e.guardNonZero(pc);
+                e.arithmetic(0x5E);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_MODULO:
+                e.loadNumbers(pc, false);
+                e.guardNonZero(pc);
+                e.remainder(chunk.code[pc].opcode == OpCode::OP_INT_MODULO);
+                e.storeNumber();
+                break;
+
+            case OpCode::OP_NEGATE:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.negate();
+                a.store(STACK_TOP, -SLOT, RAX);
+                break;
+
+            case OpCode::OP_EQUAL:
+            case OpCode::OP_EQUAL_NUM:
+            case OpCode::OP_NOT_EQUAL:
+            case OpCode::OP_NOT_EQUAL_NUM:
+            case OpCode::OP_LESS:
+            case OpCode::OP_LESS_EQUAL:
+            case OpCode::OP_GREATER:
+            case OpCode::OP_GREATER_EQUAL:
+                e.loadNumbers(pc, false);
+                e.compare(step.opcode);
+                e.storeCompare();
+                break;
+
+            case OpCode::OP_NOT:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.falsey(stack.back() == ValueType::BOOL);
+                e.boolFromEax();
+                a.store(STACK_TOP, -SLOT, RAX);
+                break;
+
+            case OpCode::OP_AND:
+            case OpCode::OP_OR:
+                a.load(RAX, STACK_TOP, -SLOT);
+                e.falsey(stack.back() == ValueType::BOOL);
+                a.mov(R8, RAX);
+                a.load(RAX, STACK_TOP, -2 * SLOT);
+                e.falsey(stack[stack.size() - 2] == ValueType::BOOL);
+                e.logical(step.opcode);
+                break;
+
+            case OpCode::OP_GET_LOCAL:
+            case OpCode::OP_GET_GLOBAL:
+                readVariable(step.observed);
+                e.pushRax();
+                break;
+
+            case OpCode::OP_SET_LOCAL:
+            case OpCode::OP_SET_GLOBAL:
+            case OpCode::OP_SET_LOCAL_POP:
+            case OpCode::OP_SET_GLOBAL_POP:
+                a.load(RAX, STACK_TOP, -SLOT);
+                a.store(base, slotDisp, RAX);
+                if (step.opcode == OpCode::OP_SET_LOCAL_POP || step.opcode == OpCode::OP_SET_GLOBAL_POP) {
+                    a.subImm(STACK_TOP, SLOT);
+                }
+                known[key] = stack.back();
+                break;
+
+            case OpCode::OP_POP:
+                a.subImm(STACK_TOP, SLOT);
+                break;
+
+            case OpCode::OP_ADD_LOCAL_CONSTANT:
+            case OpCode::OP_ADD_GLOBAL_CONSTANT:
+                readVariable(ValueType::NUMBER);
+                a.load(RDX, CONSTANTS, static_cast<int32_t>(operand >> PAIR_OPERAND_BITS) * SLOT);
+                a.movqToXmm(0, RAX);
+                a.movqToXmm(1, RDX);
+                e.arithmetic(0x58);
+                a.movqFromXmm(RAX, 0);
+                e.pushRax();
+                break;
+
+            // Unconditional jumps vanish from a linear trace
+            case OpCode::OP_JUMP:
+                break;
+
+            case OpCode::OP_JUMP_IF_FALSE:
+            case OpCode::OP_POP_JUMP_IF_FALSE:
+            case OpCode::OP_POP_JUMP_IF_TRUE:
+                a.load(RAX, STACK_TOP, -SLOT);
+                if (step.opcode != OpCode::OP_JUMP_IF_FALSE) {
+                    a.subImm(STACK_TOP, SLOT);
+                }
+                e.falsey(stack.back() == ValueType::BOOL);
+                a.bytes({0x84, 0xC0}); // test al, al
+                guardBranch(step.opcode == OpCode::OP_POP_JUMP_IF_TRUE ? CC_E : CC_NE);
+                break;
+
+            case OpCode::OP_JUMP_IF_NOT_LESS:
+            case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+            case OpCode::OP_JUMP_IF_NOT_GREATER:
+            case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL:
+                e.loadNumbers(pc, false);
+                guardBranch(e.compareAndPop(step.opcode));
+                break;
+
+            // The back-edge closes the trace
+            case OpCode::OP_LOOP:
+                e.jumpTo(0);
+                break;
+
+            // The recorder only emits the opcodes above
+            default:
+                return nullptr;
+        }
+        applyTypes(chunk, step, stack);
+    }
+
+    return install(e.finish({entry}, {loop}));
+}
+
+#else
+
+JitCode::~JitCode() = default;
+
+size_t JitCode::run(JitContext&, size_t pc) const {
+    return pc;
+}
+
+const JitCode* Jit::compile(const Chunk&) {
+    return nullptr;
+}
+
+const JitCode* Jit::compileTrace(const Chunk&, const Trace&) {
+    return nullptr;
+}
+
+#endif
+
+} // namespace minilang
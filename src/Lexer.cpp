@@ -1,27 +1,102 @@
 #include "Lexer.hpp"
-#include <cctype>
-#include <cstring>
-#include <unordered_map>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+
+#if MINILANG_SIMD
+#include <emmintrin.h>
+#endif
 
 namespace minilang {
 
-// Keyword lookup table
-static const std::unordered_map<std::string, TokenType> KEYWORDS = {
-    {"let", TokenType::LET},
-    {"fn", TokenType::FN},
-    {"if", TokenType::IF},
-    {"else", TokenType::ELSE},
-    {"while", TokenType::WHILE},
-    {"return", TokenType::RETURN},
-    {"true", TokenType::TRUE},
-    {"false", TokenType::FALSE},
-    {"print", TokenType::PRINT},
+// ASCII character classes; bytes past 0x7F are in none of them
+static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static constexpr bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+static constexpr bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+enum class CharClass : uint8_t {
+    BLANK,
+    IDENTIFIER,
+    DIGIT,
 };
 
-Lexer::Lexer(std::string source) : m_source(std::move(source)) {}
+template <CharClass C>
+static constexpr bool inClass(char c) {
+    if constexpr (C == CharClass::BLANK) return isBlank(c);
+    if constexpr (C == CharClass::IDENTIFIER) return isAlpha(c) || isDigit(c);
+    return isDigit(c);
+}
+
+#if MINILANG_SIMD
+// Bytes in [lo, hi]; bytes past 0x7F compare as negative and never match
+static __m128i inRange(__m128i bytes, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+template <CharClass C>
+static __m128i classMask(__m128i bytes) {
+    if constexpr (C == CharClass::BLANK) {
+        __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+        __m128i breaks = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+        return _mm_or_si128(spaces, breaks);
+    }
+    if constexpr (C == CharClass::IDENTIFIER) {
+        // Setting bit 5 folds A-Z onto a-z and no other byte into it
+        __m128i letters = inRange(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i underscores = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(letters, underscores), inRange(bytes, '0', '9'));
+    }
+    return inRange(bytes, '0', '9');
+}
+#endif
+
+/**
+ * End of the run of class characters starting at from
+ */
+template <CharClass C>
+static size_t scanClass(std::string_view source, size_t from) {
+    size_t i = from;
+#if MINILANG_SIMD
+    for (; i + 16 <= source.size(); i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + i));
+        auto misses = static_cast<uint32_t>(~_mm_movemask_epi8(classMask<C>(bytes))) & 0xFFFF;
+        if (misses) return i + std::countr_zero(misses);
+    }
+#endif
+    while (i < source.size() && inClass<C>(source[i])) i++;
+    return i;
+}
+
+// Keyword matching: the first character picks the only candidate keyword
+// (two for 'f'), and one length-checked compare settles it
+static constexpr TokenType keywordType(std::string_view text) {
+    auto keyword = [text](std::string_view word, TokenType type) {
+        return text == word ? type : TokenType::IDENTIFIER;
+    };
+
+    switch (text[0]) {
+        case 'e': return keyword("else", TokenType::ELSE);
+        case 'f': return text.size() == 2 ? keyword("fn", TokenType::FN) : keyword("false", TokenType::FALSE);
+        case 'i': return keyword("if", TokenType::IF);
+        case 'l': return keyword("let", TokenType::LET);
+        case 'p': return keyword("print", TokenType::PRINT);
+        case 'r': return keyword("return", TokenType::RETURN);
+        case 't': return keyword("true", TokenType::TRUE);
+        case 'w': return keyword("while", TokenType::WHILE);
+        default: return TokenType::IDENTIFIER;
+    }
+}
+
+static_assert(keywordType("while") == TokenType::WHILE && keywordType("whilst") == TokenType::IDENTIFIER);
+static_assert(keywordType("fn") == TokenType::FN && keywordType("false") == TokenType::FALSE);
+
+Lexer::Lexer(std::string_view source) : m_source(source) {}
 
 std::vector<Token> Lexer::tokenize() {
     m_tokens.clear();
+    m_literals.clear();
     m_start = 0;
     m_current = 0;
     m_line = 1;
@@ -36,7 +111,7 @@ std::vector<Token> Lexer::tokenize() {
     }
 
     m_tokens.push_back(makeToken(TokenType::EOF_TOKEN));
-    return m_tokens;
+    return std::move(m_tokens);
 }
 
 Token Lexer::nextToken() {
@@ -57,64 +132,52 @@ bool Lexer::match(char expected) {
     return true;
 }
 
-void Lexer::skipWhitespace() {
-    while (!isAtEnd()) {
-        char c = peek();
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance();
-                break;
-            case '\n':
-                m_line++;
-                m_column = 1;
-                advance();
-                break;
-            default:
-                return;
-        }
+void Lexer::advanceLines(size_t count) {
+    std::string_view run = m_source.substr(m_current, count);
+    m_current += count;
+
+    size_t last = run.rfind('\n');
+    if (last == std::string_view::npos) {
+        m_column += count;
+        return;
     }
+
+    // A newline resets the column to 1 and is then consumed like any character
+    m_line += static_cast<size_t>(std::count(run.begin(), run.end(), '\n'));
+    m_column = count - last + 1;
 }
 
-void Lexer::skipComment() {
-    // Line comments: // to end of line
-    if (peek() == '/' && peekNext() == '/') {
-        while (!isAtEnd() && peek() != '\n') {
-            advance();
+void Lexer::skipWhitespace() {
+    // Blanks and line comments (// to end of line), in any order
+    while (!isAtEnd()) {
+        advanceLines(scanClass<CharClass::BLANK>(m_source, m_current) - m_current);
+        if (peek() != '/' || peekNext() != '/') {
+            return;
         }
+
+        size_t newline = m_source.find('\n', m_current);
+        advanceBy((newline == std::string_view::npos ? m_source.size() : newline) - m_current);
     }
 }
 
 Token Lexer::makeToken(TokenType type) const {
-    return Token(type, m_source.substr(m_start, m_current - m_start), m_line, m_column);
-}
-
-Token Lexer::makeToken(TokenType type, double literal) const {
-    return Token(type, m_source.substr(m_start, m_current - m_start), m_line, m_column, literal);
-}
-
-Token Lexer::makeToken(TokenType type, std::string literal) const {
-    return Token(type, m_source.substr(m_start, m_current - m_start), m_line, m_column, std::move(literal));
+    return Token(type, m_source.substr(m_start, m_current - m_start), static_cast<uint32_t>(m_line),
+                 static_cast<uint32_t>(m_column));
 }
 
-Token Lexer::makeToken(TokenType type, bool literal) const {
-    return Token(type, m_source.substr(m_start, m_current - m_start), m_line, m_column, literal);
+Token Lexer::makeToken(TokenType type, Literal literal) {
+    Token token = makeToken(type);
+    token.literal = static_cast<uint32_t>(m_literals.size());
+    m_literals.push_back(std::move(literal));
+    return token;
 }
 
-Token Lexer::errorToken(const std::string& message) const {
-    Token token;
-    token.type = TokenType::ERROR;
-    token.lexeme = message;
-    token.line = m_line;
-    token.column = m_column;
-    return token;
+Token Lexer::errorToken(std::string message) {
+    return makeToken(TokenType::ERROR, std::move(message));
 }
 
 Token Lexer::scanToken() {
     skipWhitespace();
-    skipComment();
-    skipWhitespace();
 
     m_start = m_current;
 
@@ -125,12 +188,12 @@ Token Lexer::scanToken() {
     char c = advance();
 
     // Identifiers and keywords
-    if (std::isalpha(c) || c == '_') {
+    if (isAlpha(c)) {
         return scanIdentifier();
     }
 
     // Numbers
-    if (std::isdigit(c)) {
+    if (isDigit(c)) {
         return scanNumber();
     }
 
@@ -199,53 +262,43 @@ Token Lexer::scanToken() {
 }
 
 Token Lexer::scanIdentifier() {
-    while (std::isalnum(peek()) || peek() == '_') {
-        advance();
-    }
+    advanceBy(scanClass<CharClass::IDENTIFIER>(m_source, m_current) - m_current);
 
-    std::string text = m_source.substr(m_start, m_current - m_start);
-    auto it = KEYWORDS.find(text);
-    if (it != KEYWORDS.end()) {
-        return makeToken(it->second);
-    }
-    return makeToken(TokenType::IDENTIFIER);
+    return makeToken(keywordType(m_source.substr(m_start, m_current - m_start)));
 }
 
 Token Lexer::scanNumber() {
-    while (std::isdigit(peek())) {
-        advance();
-    }
+    advanceBy(scanClass<CharClass::DIGIT>(m_source, m_current) - m_current);
 
     // Handle decimal point
-    if (peek() == '.' && std::isdigit(peekNext())) {
+    if (peek() == '.' && isDigit(peekNext())) {
         advance(); // consume '.'
-        while (std::isdigit(peek())) {
-            advance();
-        }
+        advanceBy(scanClass<CharClass::DIGIT>(m_source, m_current) - m_current);
     }
 
-    std::string numStr = m_source.substr(m_start, m_current - m_start);
-    double value = std::stod(numStr);
+    const char* first = m_source.data() + m_start;
+    const char* last = m_source.data() + m_current;
+    double value = 0.0;
+    if (std::from_chars(first, last, value).ec == std::errc::result_out_of_range) {
+        // Too large for a double when the integer part is not zero, too small otherwise
+        const char* point = std::find(first, last, '.');
+        value = std::find_if(first, point, [](char c) { return c != '0'; }) != point ? HUGE_VAL : 0.0;
+    }
     return makeToken(TokenType::NUMBER, value);
 }
 
 Token Lexer::scanString() {
-    std::string value;
-
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n') {
-            m_line++;
-            m_column = 1;
-        }
-        value += advance();
-    }
+    size_t quote = m_source.find('"', m_current);
+    advanceLines((quote == std::string_view::npos ? m_source.size() : quote) - m_current);
 
     if (isAtEnd()) {
         return errorToken("Unterminated string");
     }
 
     advance(); // consume closing '"'
-    return makeToken(TokenType::STRING, value);
+
+    // No escapes: the value is the text between the quotes
+    return makeToken(TokenType::STRING, std::string(m_source.substr(m_start + 1, m_current - m_start - 2)));
 }
 
 } // namespace minilang
@@ -0,0 +1,476 @@
+#include "Optimizer.hpp"
+#include <cmath>
+
+namespace minilang {
+
+using LiteralValue = decltype(LiteralExpr::value);
+
+/**
+ * Truthiness of a literal, matching isFalsey() on the VM
+ */
+static bool isFalsey(const LiteralValue& value) {
+    if (std::holds_alternative<std::monostate>(value)) return true;
+    if (const bool* b = std::get_if<bool>(&value)) return !*b;
+    if (const double* n = std::get_if<double>(&value)) return *n == 0.0;
+    return false;
+}
+
+static const LiteralExpr* asLiteral(const std::unique_ptr<Expr>& expr) {
+    return expr && expr->getType() == ExprType::Literal ? static_cast<const LiteralExpr*>(expr.get()) : nullptr;
+}
+
+/**
+ * Whether a statement returns on every path, leaving the statements after it unreachable
+ */
+static bool alwaysReturns(const Stmt* stmt) {
+    if (!stmt) return false;
+
+    switch (stmt->getType()) {
+        case StmtType::Return:
+            return true;
+        case StmtType::Block: {
+            // Pruned blocks end at their first returning statement
+            const auto& statements = static_cast<const BlockStmt*>(stmt)->statements;
+            return !statements.empty() && alwaysReturns(statements.back().get());
+        }
+        case StmtType::If: {
+            auto* ifStmt = static_cast<const IfStmt*>(stmt);
+            return alwaysReturns(ifStmt->thenBranch.get()) && alwaysReturns(ifStmt->elseBranch.get());
+        }
+        default:
+            return false;
+    }
+}
+
+void Optimizer::optimize(Program& program) {
+    // Find the locals that are ever assigned before touching anything, so
+    // a read is never replaced ahead of a later write in a loop
+    m_assigned.clear();
+    m_scope.clear();
+    m_depth = 0;
+    m_resolving = true;
+    visitStmts(program);
+
+    m_read.clear();
+    m_scope.clear();
+    m_depth = 0;
+    m_resolving = false;
+    visitStmts(program);
+
+    // Reads are final only once propagation has replaced the constant ones
+    m_scope.clear();
+    m_depth = 0;
+    pruneStmts(program);
+}
+
+void Optimizer::beginScope() {
+    m_depth++;
+}
+
+void Optimizer::endScope() {
+    m_depth--;
+
+    while (!m_scope.empty() && m_scope.back().depth > m_depth) {
+        m_scope.pop_back();
+    }
+}
+
+void Optimizer::declare(std::string_view name, const LetStmt* let) {
+    m_scope.push_back({name, m_depth, let, false});
+}
+
+const Optimizer::Binding* Optimizer::resolve(std::string_view name) const {
+    for (auto it = m_scope.rbegin(); it != m_scope.rend(); ++it) {
+        if (it->name == name) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+void Optimizer::visitStmts(std::vector<std::unique_ptr<Stmt>>& stmts) {
+    for (auto& stmt : stmts) {
+        visitStmt(stmt.get());
+    }
+}
+
+void Optimizer::visitStmt(Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            visitExpr(static_cast<ExpressionStmt*>(stmt)->expression);
+            break;
+        case StmtType::Let: {
+            auto* let = static_cast<LetStmt*>(stmt);
+            if (m_depth == 0) {
+                visitExpr(let->initializer);
+                break;
+            }
+
+            // Both declarations stay for the backends to report a redeclaration
+            const Binding* previous = resolve(let->name.lexeme());
+            if (!m_resolving && previous && previous->depth == m_depth) {
+                if (previous->let) m_read.insert(previous->let);
+                m_read.insert(let);
+            }
+
+            // Visible but opaque inside its own initializer
+            declare(let->name.lexeme(), let);
+            size_t index = m_scope.size() - 1;
+            visitExpr(let->initializer);
+            if (!let->initializer || let->initializer->getType() == ExprType::Literal) {
+                m_scope[index].constant = true;
+            }
+            break;
+        }
+        case StmtType::Function: {
+            auto* function = static_cast<FunctionStmt*>(stmt);
+            if (m_depth > 0) {
+                declare(function->name.lexeme());
+            }
+            visitFunction(function);
+            break;
+        }
+        case StmtType::If: {
+            auto* ifStmt = static_cast<IfStmt*>(stmt);
+            visitExpr(ifStmt->condition);
+            visitStmt(ifStmt->thenBranch.get());
+            visitStmt(ifStmt->elseBranch.get());
+            break;
+        }
+        case StmtType::While: {
+            auto* whileStmt = static_cast<WhileStmt*>(stmt);
+            visitExpr(whileStmt->condition);
+            visitStmt(whileStmt->body.get());
+            break;
+        }
+        case StmtType::Return:
+            visitExpr(static_cast<ReturnStmt*>(stmt)->value);
+            break;
+        case StmtType::Print:
+            visitExpr(static_cast<PrintStmt*>(stmt)->expression);
+            break;
+        case StmtType::Block:
+            beginScope();
+            visitStmts(static_cast<BlockStmt*>(stmt)->statements);
+            endScope();
+            break;
+    }
+}
+
+void Optimizer::visitFunction(FunctionStmt* stmt) {
+    // Functions do not capture: the body sees only its own locals
+    std::vector<Binding> enclosing = std::move(m_scope);
+    size_t enclosingDepth = m_depth;
+
+    m_scope.clear();
+    m_depth = 0;
+    declare(stmt->name.lexeme());
+
+    beginScope();
+    for (const Token& param : stmt->params) {
+        declare(param.lexeme());
+    }
+    visitStmts(stmt->body);
+
+    m_scope = std::move(enclosing);
+    m_depth = enclosingDepth;
+}
+
+void Optimizer::visitExpr(std::unique_ptr<Expr>& expr) {
+    if (!expr) return;
+
+    switch (expr->getType()) {
+        case ExprType::Literal:
+            break;
+        case ExprType::Variable: {
+            if (m_resolving) break;
+            std::string_view name = static_cast<VariableExpr*>(expr.get())->name.lexeme();
+            const Binding* binding = resolve(name);
+            if (binding && binding->constant && !m_assigned.count(binding->let)) {
+                const LiteralExpr* value = asLiteral(binding->let->initializer);
+                expr = std::make_unique<LiteralExpr>(value ? value->value : LiteralValue(std::monostate()));
+                break;
+            }
+
+            // Every visible binding of the name, as for assignments below
+            for (const Binding& visible : m_scope) {
+                if (visible.name == name && visible.let) {
+                    m_read.insert(visible.let);
+                }
+            }
+            break;
+        }
+        case ExprType::Assignment: {
+            auto* assign = static_cast<AssignExpr*>(expr.get());
+            visitExpr(assign->value);
+            if (!m_resolving) break;
+
+            // Every visible binding of the name: backends disagree on whether a
+            // `let` initializer sees the new or the enclosing variable
+            for (const Binding& binding : m_scope) {
+                if (binding.name == assign->name.lexeme() && binding.let) {
+                    m_assigned.insert(binding.let);
+                }
+            }
+            break;
+        }
+        case ExprType::Binary: {
+            auto* binary = static_cast<BinaryExpr*>(expr.get());
+            visitExpr(binary->left);
+            visitExpr(binary->right);
+            if (!m_resolving) foldBinary(expr);
+            break;
+        }
+        case ExprType::Unary:
+            visitExpr(static_cast<UnaryExpr*>(expr.get())->right);
+            if (!m_resolving) foldUnary(expr);
+            break;
+        case ExprType::Call: {
+            auto* call = static_cast<CallExpr*>(expr.get());
+            visitExpr(call->callee);
+            for (auto& arg : call->arguments) {
+                visitExpr(arg);
+            }
+            break;
+        }
+        case ExprType::Grouping: {
+            auto* grouping = static_cast<GroupingExpr*>(expr.get());
+            visitExpr(grouping->expression);
+            if (asLiteral(grouping->expression)) {
+                expr = std::move(grouping->expression);
+            }
+            break;
+        }
+    }
+}
+
+void Optimizer::foldBinary(std::unique_ptr<Expr>& expr) {
+    auto* binary = static_cast<BinaryExpr*>(expr.get());
+    const LiteralExpr* left = asLiteral(binary->left);
+    const LiteralExpr* right = asLiteral(binary->right);
+    if (!left || !right) return;
+
+    const LiteralValue& a = left->value;
+    const LiteralValue& b = right->value;
+    const double* x = std::get_if<double>(&a);
+    const double* y = std::get_if<double>(&b);
+    bool numbers = x && y;
+
+    LiteralValue result;
+    switch (binary->op.type) {
+        case TokenType::PLUS:
+            if (numbers) {
+                result = *x + *y;
+            } else if (std::holds_alternative<std::string>(a) && std::holds_alternative<std::string>(b)) {
+                result = std::get<std::string>(a) + std::get<std::string>(b);
+            } else {
+                return;
+            }
+            break;
+        case TokenType::MINUS:
+            if (!numbers) return;
+            result = *x - *y;
+            break;
+        case TokenType::STAR:
+            if (!numbers) return;
+            result = *x * *y;
+            break;
+        // A zero divisor is a runtime error; leave it to the VM
+        case TokenType::SLASH:
+            if (!numbers || *y == 0.0) return;
+            result = *x / *y;
+            break;
+        case TokenType::PERCENT:
+            if (!numbers || *y == 0.0) return;
+            result = std::fmod(*x, *y);
+            break;
+
+        // Literals of different types are unequal, as in valuesEqual()
+        case TokenType::EQUAL_EQUAL: result = a == b; break;
+        case TokenType::BANG_EQUAL: result = a != b; break;
+        case TokenType::LESS:
+            if (!numbers) return;
+            result = *x < *y;
+            break;
+        case TokenType::LESS_EQUAL:
+            if (!numbers) return;
+            result = *x <= *y;
+            break;
+        case TokenType::GREATER:
+            if (!numbers) return;
+            result = *x > *y;
+            break;
+        case TokenType::GREATER_EQUAL:
+            if (!numbers) return;
+            result = *x >= *y;
+            break;
+
+        case TokenType::AND: result = !isFalsey(a) && !isFalsey(b); break;
+        case TokenType::OR: result = !isFalsey(a) || !isFalsey(b); break;
+
+        default:
+            return;
+    }
+
+    expr = std::make_unique<LiteralExpr>(std::move(result));
+}
+
+void Optimizer::foldUnary(std::unique_ptr<Expr>& expr) {
+    auto* unary = static_cast<UnaryExpr*>(expr.get());
+    const LiteralExpr* operand = asLiteral(unary->right);
+    if (!operand) return;
+
+    if (unary->op.type == TokenType::MINUS) {
+        const double* n = std::get_if<double>(&operand->value);
+        if (!n) return;
+        expr = std::make_unique<LiteralExpr>(-*n);
+    } else if (unary->op.type == TokenType::BANG) {
+        expr = std::make_unique<LiteralExpr>(isFalsey(operand->value));
+    }
+}
+
+void Optimizer::pruneStmts(std::vector<std::unique_ptr<Stmt>>& stmts) {
+    size_t kept = 0;
+    for (size_t i = 0; i < stmts.size(); i++) {
+        pruneStmt(stmts[i]);
+        if (!stmts[i]) continue;
+
+        bool returns = alwaysReturns(stmts[i].get());
+        if (kept != i) stmts[kept] = std::move(stmts[i]);
+        kept++;
+        if (returns) break;
+    }
+    stmts.resize(kept);
+}
+
+void Optimizer::pruneBranch(std::unique_ptr<Stmt>& branch) {
+    pruneStmt(branch);
+    if (!branch) {
+        branch = std::make_unique<BlockStmt>(std::vector<std::unique_ptr<Stmt>>());
+    }
+}
+
+void Optimizer::pruneStmt(std::unique_ptr<Stmt>& stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            if (isPure(static_cast<ExpressionStmt*>(stmt.get())->expression.get())) {
+                stmt.reset();
+            }
+            break;
+        case StmtType::Let: {
+            auto* let = static_cast<LetStmt*>(stmt.get());
+            if (m_depth == 0) break;
+
+            declare(let->name.lexeme(), let);
+            if (m_read.count(let) || m_assigned.count(let)) break;
+
+            // Never read: only the effects of the initializer remain
+            if (isPure(let->initializer.get())) {
+                stmt.reset();
+            } else {
+                stmt = std::make_unique<ExpressionStmt>(std::move(let->initializer));
+            }
+            break;
+        }
+        case StmtType::Function: {
+            auto* function = static_cast<FunctionStmt*>(stmt.get());
+            if (m_depth > 0) {
+                declare(function->name.lexeme());
+            }
+            pruneFunction(function);
+            break;
+        }
+        case StmtType::If: {
+            auto* ifStmt = static_cast<IfStmt*>(stmt.get());
+            if (const LiteralExpr* condition = asLiteral(ifStmt->condition)) {
+                // Only the branch taken is compiled; a missing else leaves nothing
+                std::unique_ptr<Stmt> taken =
+                    isFalsey(condition->value) ? std::move(ifStmt->elseBranch) : std::move(ifStmt->thenBranch);
+                stmt = std::move(taken);
+                pruneStmt(stmt);
+                break;
+            }
+            pruneBranch(ifStmt->thenBranch);
+            if (ifStmt->elseBranch) pruneBranch(ifStmt->elseBranch);
+            break;
+        }
+        case StmtType::While: {
+            auto* whileStmt = static_cast<WhileStmt*>(stmt.get());
+            const LiteralExpr* condition = asLiteral(whileStmt->condition);
+            if (condition && isFalsey(condition->value)) {
+                stmt.reset();
+                break;
+            }
+            pruneBranch(whileStmt->body);
+            break;
+        }
+        case StmtType::Return:
+        case StmtType::Print:
+            break;
+        case StmtType::Block: {
+            auto* block = static_cast<BlockStmt*>(stmt.get());
+            beginScope();
+            pruneStmts(block->statements);
+            endScope();
+            if (block->statements.empty()) stmt.reset();
+            break;
+        }
+    }
+}
+
+void Optimizer::pruneFunction(FunctionStmt* stmt) {
+    std::vector<Binding> enclosing = std::move(m_scope);
+    size_t enclosingDepth = m_depth;
+
+    m_scope.clear();
+    m_depth = 0;
+    declare(stmt->name.lexeme());
+
+    beginScope();
+    for (const Token& param : stmt->params) {
+        declare(param.lexeme());
+    }
+    pruneStmts(stmt->body);
+
+    m_scope = std::move(enclosing);
+    m_depth = enclosingDepth;
+}
+
+bool Optimizer::isPure(const Expr* expr) const {
+    if (!expr) return true;
+
+    switch (expr->getType()) {
+        case ExprType::Literal:
+            return true;
+        case ExprType::Variable:
+            // Reading an undefined global is an error
+            return resolve(static_cast<const VariableExpr*>(expr)->name.lexeme()) != nullptr;
+        case ExprType::Grouping:
+            return isPure(static_cast<const GroupingExpr*>(expr)->expression.get());
+        case ExprType::Unary: {
+            auto* unary = static_cast<const UnaryExpr*>(expr);
+            return unary->op.type == TokenType::BANG && isPure(unary->right.get());
+        }
+        case ExprType::Binary: {
+            // Only operators that accept every type
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            switch (binary->op.type) {
+                case TokenType::EQUAL_EQUAL:
+                case TokenType::BANG_EQUAL:
+                case TokenType::AND:
+                case TokenType::OR:
+                    return isPure(binary->left.get()) && isPure(binary->right.get());
+                default:
+                    return false;
+            }
+        }
+        default:
+            return false;
+    }
+}
+
+} // namespace minilang
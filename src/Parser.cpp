@@ -1,9 +1,11 @@
 #include "Parser.hpp"
 #include <format>
+#include <iostream>
 
 namespace minilang {
 
-Parser::Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
+Parser::Parser(const std::vector<Token>& tokens, const std::vector<Literal>& literals)
+    : m_tokens(tokens), m_literals(literals) {}
 
 Program Parser::parse() {
     Program program;
@@ -61,6 +63,10 @@ Token Parser::consume(TokenType type, const std::string& message) {
     throw error(peek(), message);
 }
 
+const Literal* Parser::literalOf(const Token& token) const {
+    return token.literal < m_literals.size() ? &m_literals[token.literal] : nullptr;
+}
+
 ParseError Parser::error(Token token, const std::string& message) {
     return ParseError(message, token.line, token.column);
 }
@@ -354,16 +360,16 @@ std::unique_ptr<Expr> Parser::primary() {
         return std::make_unique<LiteralExpr>(true);
     }
     if (match({TokenType::NUMBER})) {
-        Token num = previous();
-        if (std::holds_alternative<double>(num.literal)) {
-            return std::make_unique<LiteralExpr>(std::get<double>(num.literal));
+        const Literal* num = literalOf(previous());
+        if (num && std::holds_alternative<double>(*num)) {
+            return std::make_unique<LiteralExpr>(std::get<double>(*num));
         }
         return std::make_unique<LiteralExpr>(0.0);
     }
     if (match({TokenType::STRING})) {
-        Token str = previous();
-        if (std::holds_alternative<std::string>(str.literal)) {
-            return std::make_unique<LiteralExpr>(std::get<std::string>(str.literal));
+        const Literal* str = literalOf(previous());
+        if (str && std::holds_alternative<std::string>(*str)) {
+            return std::make_unique<LiteralExpr>(std::get<std::string>(*str));
         }
         return std::make_unique<LiteralExpr>(std::string(""));
     }
@@ -0,0 +1,324 @@
+#include "Peephole.hpp"
+#include "IRGenerator.hpp"
+#include <vector>
+
+namespace minilang {
+
+namespace {
+
+/**
+ * Working form of an instruction: jump targets are absolute instruction
+ * indices while rules run and are re-encoded as offsets at the end
+ */
+struct Slot {
+    OpCode opcode;
+    uint32_t operand;
+    size_t line;
+    size_t target = 0;
+    bool removed = false;
+};
+
+bool isForwardJump(OpCode op) {
+    switch (op) {
+        case OpCode::OP_JUMP:
+        case OpCode::OP_JUMP_IF_FALSE:
+        case OpCode::OP_POP_JUMP_IF_FALSE:
+        case OpCode::OP_POP_JUMP_IF_TRUE:
+        case OpCode::OP_JUMP_IF_NOT_LESS:
+        case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+        case OpCode::OP_JUMP_IF_NOT_GREATER:
+        case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL:
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS:
+        case OpCode::OP_NUM_JUMP_IF_NOT_LESS_EQUAL:
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER:
+        case OpCode::OP_NUM_JUMP_IF_NOT_GREATER_EQUAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isJump(OpCode op) {
+    return isForwardJump(op) || op == OpCode::OP_LOOP;
+}
+
+// Pushes a value without side effects (reading a global may raise an error)
+bool isPurePush(OpCode op) {
+    switch (op) {
+        case OpCode::OP_CONSTANT:
+        case OpCode::OP_NIL:
+        case OpCode::OP_TRUE:
+        case OpCode::OP_FALSE:
+        case OpCode::OP_GET_LOCAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Window rule: rewrites a matching window in place, marking the
+ * instructions it drops as removed; returns false when it does not match.
+ * Only the first instruction of a window may be a jump target, so a rule
+ * that drops it is skipped there.
+ */
+struct Rule {
+    const char* name;
+    size_t length;
+    bool dropsFirst;
+    bool (*apply)(Slot** window);
+};
+
+const Rule RULES[] = {
+    // !x; jump-if-false  =>  jump-if-true, and the reverse
+    {"not-branch", 2, true,
+     [](Slot** w) {
+         if (w[0]->opcode != OpCode::OP_NOT) return false;
+         if (w[1]->opcode == OpCode::OP_POP_JUMP_IF_FALSE) {
+             w[1]->opcode = OpCode::OP_POP_JUMP_IF_TRUE;
+         } else if (w[1]->opcode == OpCode::OP_POP_JUMP_IF_TRUE) {
+             w[1]->opcode = OpCode::OP_POP_JUMP_IF_FALSE;
+         } else {
+             return false;
+         }
+         w[0]->removed = true;
+         return true;
+     }},
+
+    // !(a == b)  =>  a != b, and the reverse; both produce a bool
+    {"not-equal", 2, false,
+     [](Slot** w) {
+         if (w[1]->opcode != OpCode::OP_NOT) return false;
+         switch (w[0]->opcode) {
+             case OpCode::OP_EQUAL: w[0]->opcode = OpCode::OP_NOT_EQUAL; break;
+             case OpCode::OP_NOT_EQUAL: w[0]->opcode = OpCode::OP_EQUAL; break;
+             case OpCode::OP_NUM_EQUAL: w[0]->opcode = OpCode::OP_NUM_NOT_EQUAL; break;
+             case OpCode::OP_NUM_NOT_EQUAL: w[0]->opcode = OpCode::OP_NUM_EQUAL; break;
+             default: return false;
+         }
+         w[1]->removed = true;
+         return true;
+     }},
+
+    // A value pushed only to be discarded
+    {"push-pop", 2, true,
+     [](Slot** w) {
+         if (!isPurePush(w[0]->opcode) || w[1]->opcode != OpCode::OP_POP) return false;
+         w[0]->removed = true;
+         w[1]->removed = true;
+         return true;
+     }},
+
+    // Store then discard
+    {"set-pop", 2, false,
+     [](Slot** w) {
+         if (w[1]->opcode != OpCode::OP_POP) return false;
+         if (w[0]->opcode == OpCode::OP_SET_LOCAL) {
+             w[0]->opcode = OpCode::OP_SET_LOCAL_POP;
+         } else if (w[0]->opcode == OpCode::OP_SET_GLOBAL) {
+             w[0]->opcode = OpCode::OP_SET_GLOBAL_POP;
+         } else {
+             return false;
+         }
+         w[1]->removed = true;
+         return true;
+     }},
+
+    // Store then reload the same variable  =>  store and keep the value
+    {"set-get", 2, false,
+     [](Slot** w) {
+         if (w[0]->operand != w[1]->operand) return false;
+         if (w[0]->opcode == OpCode::OP_SET_LOCAL_POP && w[1]->opcode == OpCode::OP_GET_LOCAL) {
+             w[0]->opcode = OpCode::OP_SET_LOCAL;
+         } else if (w[0]->opcode == OpCode::OP_SET_GLOBAL_POP && w[1]->opcode == OpCode::OP_GET_GLOBAL) {
+             w[0]->opcode = OpCode::OP_SET_GLOBAL;
+         } else {
+             return false;
+         }
+         w[1]->removed = true;
+         return true;
+     }},
+
+    // Load then store back the same local (a global read may raise an error)
+    {"self-store", 2, true,
+     [](Slot** w) {
+         if (w[0]->operand != w[1]->operand) return false;
+         if (w[0]->opcode != OpCode::OP_GET_LOCAL || w[1]->opcode != OpCode::OP_SET_LOCAL_POP) return false;
+         w[0]->removed = true;
+         w[1]->removed = true;
+         return true;
+     }},
+};
+
+constexpr size_t WINDOW_MAX = 2;
+
+/**
+ * Pass state over one chunk
+ */
+class Pass {
+public:
+    Pass(std::vector<Slot>& slots, PeepholeStats& stats) : m_slots(slots), m_stats(stats) {}
+
+    // Run every rule until none fires; returns whether anything changed
+    bool run() {
+        bool changed = false;
+        for (bool progress = true; progress;) {
+            findTargets();
+            progress = applyWindows() | threadJumps();
+
+            // Rewrites move jump targets; reachability needs the current ones
+            findTargets();
+            progress |= dropUnreachable();
+            changed |= progress;
+        }
+        return changed;
+    }
+
+private:
+    std::vector<Slot>& m_slots;
+    PeepholeStats& m_stats;
+    std::vector<bool> m_isTarget;
+
+    void fired(const char* rule) { m_stats.rules[rule]++; }
+
+    // First surviving instruction at or after i (m_slots.size() at the end)
+    size_t live(size_t i) const {
+        while (i < m_slots.size() && m_slots[i].removed) i++;
+        return i;
+    }
+
+    void findTargets() {
+        m_isTarget.assign(m_slots.size() + 1, false);
+        for (const Slot& slot : m_slots) {
+            if (!slot.removed && isJump(slot.opcode)) {
+                m_isTarget[live(slot.target)] = true;
+            }
+        }
+    }
+
+    bool applyWindows() {
+        bool changed = false;
+        for (size_t i = live(0); i < m_slots.size(); i = live(i + 1)) {
+            // Collect the window of surviving instructions starting at i
+            Slot* window[WINDOW_MAX];
+            size_t length = 0;
+            for (size_t j = i; j < m_slots.size() && length < WINDOW_MAX; j = live(j + 1)) {
+                if (length > 0 && m_isTarget[j]) break;
+                window[length++] = &m_slots[j];
+            }
+
+            for (const Rule& rule : RULES) {
+                if (rule.dropsFirst && m_isTarget[i]) continue;
+                if (rule.length <= length && rule.apply(window)) {
+                    fired(rule.name);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        return changed;
+    }
+
+    bool threadJumps() {
+        bool changed = false;
+        for (size_t i = live(0); i < m_slots.size(); i = live(i + 1)) {
+            Slot& slot = m_slots[i];
+            if (!isForwardJump(slot.opcode)) continue;
+
+            // Jump to a jump: go straight to the final target
+            size_t target = live(slot.target);
+            while (target < m_slots.size() && m_slots[target].opcode == OpCode::OP_JUMP && target != i) {
+                target = live(m_slots[target].target);
+                fired("jump-to-jump");
+                changed = true;
+            }
+            slot.target = target;
+
+            if (slot.opcode != OpCode::OP_JUMP) continue;
+
+            // Jump to the next instruction
+            if (target == live(i + 1)) {
+                slot.removed = true;
+                fired("jump-next");
+                changed = true;
+                continue;
+            }
+
+            // Jump to a back-edge becomes the back-edge itself
+            if (target < m_slots.size() && m_slots[target].opcode == OpCode::OP_LOOP &&
+                m_slots[target].target <= i) {
+                slot.opcode = OpCode::OP_LOOP;
+                slot.target = m_slots[target].target;
+                fired("jump-to-loop");
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool dropUnreachable() {
+        bool changed = false;
+        bool reachable = true;
+        for (size_t i = live(0); i < m_slots.size(); i = live(i + 1)) {
+            if (m_isTarget[i]) reachable = true;
+            if (!reachable) {
+                m_slots[i].removed = true;
+                fired("unreachable");
+                changed = true;
+                continue;
+            }
+
+            OpCode op = m_slots[i].opcode;
+            reachable = op != OpCode::OP_JUMP && op != OpCode::OP_LOOP && op != OpCode::OP_RETURN;
+        }
+        return changed;
+    }
+};
+
+} // namespace
+
+void Peephole::optimize(Chunk& chunk) {
+    const size_t count = chunk.code.size();
+    m_stats.instructions += count;
+
+    std::vector<Slot> slots;
+    slots.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const Instruction& instruction = chunk.code[i];
+        Slot slot{instruction.opcode, instruction.operand, i < chunk.lines.size() ? chunk.lines[i] : 0};
+        if (isForwardJump(slot.opcode)) slot.target = i + 1 + slot.operand;
+        if (slot.opcode == OpCode::OP_LOOP) slot.target = i + 1 - slot.operand;
+        slots.push_back(slot);
+    }
+
+    Pass pass(slots, m_stats);
+    if (!pass.run()) {
+        return;
+    }
+
+    // New index of every old instruction; a removed one maps to the next survivor
+    std::vector<size_t> index(count + 1);
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        index[i] = next;
+        if (!slots[i].removed) next++;
+    }
+    index[count] = next;
+
+    chunk.code.clear();
+    chunk.lines.clear();
+    for (const Slot& slot : slots) {
+        if (slot.removed) continue;
+
+        // Rules only shorten code, so every offset still fits
+        size_t pc = chunk.code.size();
+        uint32_t operand = slot.operand;
+        if (isForwardJump(slot.opcode)) operand = static_cast<uint32_t>(index[slot.target] - (pc + 1));
+        if (slot.opcode == OpCode::OP_LOOP) operand = static_cast<uint32_t>(pc + 1 - index[slot.target]);
+        chunk.write(slot.opcode, slot.line, operand);
+    }
+
+    m_stats.removed += count - chunk.code.size();
+}
+
+} // namespace minilang
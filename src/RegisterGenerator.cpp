@@ -0,0 +1,478 @@
+#include "RegisterGenerator.hpp"
+#include <algorithm>
+#include <format>
+
+namespace minilang {
+
+/**
+ * Whether evaluating the expression can assign to a variable
+ */
+static bool hasAssignment(const Expr* expr) {
+    if (!expr) return false;
+
+    switch (expr->getType()) {
+        case ExprType::Assignment:
+            return true;
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            return hasAssignment(binary->left.get()) || hasAssignment(binary->right.get());
+        }
+        case ExprType::Unary:
+            return hasAssignment(static_cast<const UnaryExpr*>(expr)->right.get());
+        case ExprType::Grouping:
+            return hasAssignment(static_cast<const GroupingExpr*>(expr)->expression.get());
+        case ExprType::Call: {
+            auto* call = static_cast<const CallExpr*>(expr);
+            if (hasAssignment(call->callee.get())) return true;
+            return std::any_of(call->arguments.begin(), call->arguments.end(),
+                               [](const auto& arg) { return hasAssignment(arg.get()); });
+        }
+        default:
+            return false;
+    }
+}
+
+RegisterGenerator::RegisterGenerator(Heap& heap, GlobalTable& globals) : m_heap(heap), m_globals(globals) {
+    m_locals.reserve(256);
+}
+
+RegisterChunk RegisterGenerator::compile(const Program& program) {
+    m_hadError = false;
+    m_error.clear();
+    m_chunk = RegisterChunk();
+    m_locals.clear();
+    m_pendingGlobals.clear();
+    m_scopeDepth = 0;
+
+    // Register 0 of every frame holds the callee; the script's is unnamed
+    m_locals.push_back({"", 0, false});
+    m_nextRegister = 1;
+
+    for (const auto& stmt : program) {
+        compileStmt(stmt.get());
+        if (m_hadError) {
+            return m_chunk;
+        }
+    }
+
+    checkGlobalsDefined();
+
+    uint16_t result = allocRegister();
+    emit(RegOpCode::LOADNIL, result);
+    emit(RegOpCode::RETURN, result);
+    return m_chunk;
+}
+
+void RegisterGenerator::beginScope() {
+    m_scopeDepth++;
+}
+
+void RegisterGenerator::endScope() {
+    m_scopeDepth--;
+
+    // Registers of dead locals are simply reused; nothing to emit
+    while (!m_locals.empty() && m_locals.back().depth > m_scopeDepth) {
+        m_locals.pop_back();
+    }
+    m_nextRegister = static_cast<uint16_t>(m_locals.size());
+}
+
+void RegisterGenerator::declareLocal(std::string_view name) {
+    for (auto it = m_locals.rbegin(); it != m_locals.rend(); ++it) {
+        if (it->depth != m_scopeDepth) break;
+        if (it->name == name) {
+            error(std::format("Variable '{}' already declared in this scope.", name));
+            return;
+        }
+    }
+
+    m_locals.push_back({name, m_scopeDepth, false});
+}
+
+int RegisterGenerator::resolveLocal(std::string_view name) {
+    for (int i = static_cast<int>(m_locals.size()) - 1; i >= 0; i--) {
+        if (m_locals[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t RegisterGenerator::resolveGlobal(std::string_view name) {
+    uint32_t slot = m_globals.slotFor(name);
+    if (!m_globals.defined[slot]) {
+        m_pendingGlobals.push_back(slot);
+    }
+    return slot;
+}
+
+uint32_t RegisterGenerator::defineGlobal(std::string_view name) {
+    uint32_t slot = m_globals.define(name);
+    if (!m_declaredGlobals.insert(slot).second) {
+        error(std::format("Variable '{}' already declared in this scope.", name));
+    }
+    return slot;
+}
+
+void RegisterGenerator::checkGlobalsDefined() {
+    for (uint32_t slot : m_pendingGlobals) {
+        if (!m_globals.defined[slot]) {
+            error(std::format("Undefined variable: {}", m_globals.names[slot]));
+            return;
+        }
+    }
+}
+
+uint16_t RegisterGenerator::allocRegister() {
+    if (m_nextRegister >= RK_MAX) {
+        error("Too many registers in function.");
+        return 0;
+    }
+    uint16_t reg = m_nextRegister++;
+    m_chunk.registerCount = std::max<size_t>(m_chunk.registerCount, m_nextRegister);
+    return reg;
+}
+
+void RegisterGenerator::emit(RegOpCode op, uint16_t a, uint16_t b, uint16_t c) {
+    m_chunk.code.emplace_back(op, a, b, c);
+}
+
+void RegisterGenerator::emitBx(RegOpCode op, uint16_t a, uint32_t bx) {
+    RegInstruction instruction(op, a);
+    instruction.setBx(bx);
+    m_chunk.code.push_back(instruction);
+}
+
+uint16_t RegisterGenerator::makeConstant(Value value) {
+    uint32_t index = static_cast<uint32_t>(m_chunk.constants.size());
+    m_chunk.constants.push_back(value);
+    if (index <= RK_MAX) {
+        return static_cast<uint16_t>(index) | RK_CONSTANT;
+    }
+
+    // Too far for an RK operand; load it through a temporary
+    uint16_t reg = allocRegister();
+    emitBx(RegOpCode::LOADK, reg, index);
+    return reg;
+}
+
+size_t RegisterGenerator::emitJump(RegOpCode op, uint16_t a) {
+    emit(op, a);
+    return m_chunk.code.size() - 1;
+}
+
+void RegisterGenerator::patchJump(size_t at) {
+    size_t offset = m_chunk.code.size() - (at + 1);
+    m_chunk.code[at].setBx(static_cast<uint32_t>(offset));
+}
+
+void RegisterGenerator::emitLoop(size_t loopStart) {
+    int64_t offset = static_cast<int64_t>(loopStart) - static_cast<int64_t>(m_chunk.code.size() + 1);
+    emitBx(RegOpCode::JMP, 0, static_cast<uint32_t>(static_cast<int32_t>(offset)));
+}
+
+void RegisterGenerator::compileInto(Expr* expr, uint16_t target) {
+    if (!expr) {
+        emit(RegOpCode::LOADNIL, target);
+        return;
+    }
+
+    switch (expr->getType()) {
+        case ExprType::Literal: {
+            auto* literal = static_cast<LiteralExpr*>(expr);
+            if (std::holds_alternative<double>(literal->value)) {
+                emitBx(RegOpCode::LOADK, target, static_cast<uint32_t>(m_chunk.constants.size()));
+                m_chunk.constants.push_back(Value(std::get<double>(literal->value)));
+            } else if (std::holds_alternative<std::string>(literal->value)) {
+                emitBx(RegOpCode::LOADK, target, static_cast<uint32_t>(m_chunk.constants.size()));
+                m_chunk.constants.push_back(Value(m_heap.makeString(std::get<std::string>(literal->value))));
+            } else if (std::holds_alternative<bool>(literal->value)) {
+                emit(RegOpCode::LOADBOOL, target, std::get<bool>(literal->value) ? 1 : 0);
+            } else {
+                emit(RegOpCode::LOADNIL, target);
+            }
+            break;
+        }
+        case ExprType::Variable: {
+            std::string_view name = static_cast<VariableExpr*>(expr)->name.lexeme();
+            int local = resolveLocal(name);
+            if (local != -1) {
+                if (local != target) emit(RegOpCode::MOVE, target, static_cast<uint16_t>(local));
+            } else {
+                emitBx(RegOpCode::GETGLOBAL, target, resolveGlobal(name));
+            }
+            break;
+        }
+        case ExprType::Assignment:
+            compileAssign(static_cast<AssignExpr*>(expr), target);
+            break;
+        case ExprType::Binary:
+            compileBinaryExpr(static_cast<BinaryExpr*>(expr), target);
+            break;
+        case ExprType::Unary: {
+            auto* unary = static_cast<UnaryExpr*>(expr);
+            uint16_t save = m_nextRegister;
+            uint16_t operand = compileOperand(unary->right.get());
+            switch (unary->op.type) {
+                case TokenType::MINUS: emit(RegOpCode::NEG, target, operand); break;
+                case TokenType::BANG: emit(RegOpCode::NOT, target, operand); break;
+                default:
+                    error(std::format("Unknown unary operator: {}", unary->op.lexeme()));
+                    break;
+            }
+            m_nextRegister = save;
+            break;
+        }
+        case ExprType::Call:
+            compileCallExpr(static_cast<CallExpr*>(expr), target);
+            break;
+        case ExprType::Grouping:
+            compileInto(static_cast<GroupingExpr*>(expr)->expression.get(), target);
+            break;
+    }
+}
+
+uint16_t RegisterGenerator::compileOperand(Expr* expr, bool mayBeClobbered) {
+    while (expr && expr->getType() == ExprType::Grouping) {
+        expr = static_cast<GroupingExpr*>(expr)->expression.get();
+    }
+
+    // Literals and locals are used in place without a copy
+    if (expr && expr->getType() == ExprType::Literal) {
+        auto* literal = static_cast<LiteralExpr*>(expr);
+        if (std::holds_alternative<double>(literal->value)) {
+            return makeConstant(Value(std::get<double>(literal->value)));
+        }
+        if (std::holds_alternative<std::string>(literal->value)) {
+            return makeConstant(Value(m_heap.makeString(std::get<std::string>(literal->value))));
+        }
+    }
+    if (expr && expr->getType() == ExprType::Variable && !mayBeClobbered) {
+        int local = resolveLocal(static_cast<VariableExpr*>(expr)->name.lexeme());
+        if (local != -1) {
+            return static_cast<uint16_t>(local);
+        }
+    }
+
+    uint16_t reg = allocRegister();
+    compileInto(expr, reg);
+    return reg;
+}
+
+void RegisterGenerator::compileBinaryExpr(BinaryExpr* expr, uint16_t target) {
+    uint16_t save = m_nextRegister;
+
+    // A local read in place must not observe an assignment made by the right operand
+    uint16_t left = compileOperand(expr->left.get(), hasAssignment(expr->right.get()));
+    uint16_t right = compileOperand(expr->right.get());
+
+    switch (expr->op.type) {
+        case TokenType::PLUS: emit(RegOpCode::ADD, target, left, right); break;
+        case TokenType::MINUS: emit(RegOpCode::SUB, target, left, right); break;
+        case TokenType::STAR: emit(RegOpCode::MUL, target, left, right); break;
+        case TokenType::SLASH: emit(RegOpCode::DIV, target, left, right); break;
+        case TokenType::PERCENT: emit(RegOpCode::MOD, target, left, right); break;
+
+        case TokenType::EQUAL_EQUAL: emit(RegOpCode::EQ, target, left, right); break;
+        case TokenType::BANG_EQUAL: emit(RegOpCode::NE, target, left, right); break;
+        case TokenType::LESS: emit(RegOpCode::LT, target, left, right); break;
+        case TokenType::LESS_EQUAL: emit(RegOpCode::LE, target, left, right); break;
+        case TokenType::GREATER: emit(RegOpCode::GT, target, left, right); break;
+        case TokenType::GREATER_EQUAL: emit(RegOpCode::GE, target, left, right); break;
+
+        case TokenType::AND: emit(RegOpCode::AND, target, left, right); break;
+        case TokenType::OR: emit(RegOpCode::OR, target, left, right); break;
+
+        default:
+            error(std::format("Unknown binary operator: {}", expr->op.lexeme()));
+            break;
+    }
+
+    m_nextRegister = save;
+}
+
+void RegisterGenerator::compileCallExpr(CallExpr* expr, uint16_t target) {
+    uint16_t save = m_nextRegister;
+
+    // Call directly in the target when it is the topmost temporary
+    bool inPlace = target + 1 == m_nextRegister && target >= m_locals.size();
+    uint16_t base = inPlace ? target : allocRegister();
+
+    compileInto(expr->callee.get(), base);
+    for (const auto& arg : expr->arguments) {
+        compileInto(arg.get(), allocRegister());
+    }
+
+    emit(RegOpCode::CALL, base, static_cast<uint16_t>(expr->arguments.size()));
+    if (base != target) {
+        emit(RegOpCode::MOVE, target, base);
+    }
+
+    m_nextRegister = save;
+}
+
+void RegisterGenerator::compileAssign(AssignExpr* expr, int target) {
+    int local = resolveLocal(expr->name.lexeme());
+    if (local != -1) {
+        compileInto(expr->value.get(), static_cast<uint16_t>(local));
+        if (target >= 0 && target != local) {
+            emit(RegOpCode::MOVE, static_cast<uint16_t>(target), static_cast<uint16_t>(local));
+        }
+        return;
+    }
+
+    uint32_t slot = resolveGlobal(expr->name.lexeme());
+    if (target >= 0) {
+        compileInto(expr->value.get(), static_cast<uint16_t>(target));
+        emitBx(RegOpCode::SETGLOBAL, static_cast<uint16_t>(target), slot);
+        return;
+    }
+
+    uint16_t save = m_nextRegister;
+    emitBx(RegOpCode::SETGLOBAL, compileOperand(expr->value.get()), slot);
+    m_nextRegister = save;
+}
+
+void RegisterGenerator::compileStmt(Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression: {
+            Expr* expr = static_cast<ExpressionStmt*>(stmt)->expression.get();
+            if (expr && expr->getType() == ExprType::Assignment) {
+                compileAssign(static_cast<AssignExpr*>(expr), -1);
+            } else {
+                compileInto(expr, allocRegister());
+            }
+            break;
+        }
+        case StmtType::Let:
+            compileLetStmt(static_cast<LetStmt*>(stmt));
+            break;
+        case StmtType::Function:
+            compileFunctionStmt(static_cast<FunctionStmt*>(stmt));
+            break;
+        case StmtType::If:
+            compileIfStmt(static_cast<IfStmt*>(stmt));
+            break;
+        case StmtType::While:
+            compileWhileStmt(static_cast<WhileStmt*>(stmt));
+            break;
+        case StmtType::Return: {
+            auto* ret = static_cast<ReturnStmt*>(stmt);
+            emit(RegOpCode::RETURN, compileOperand(ret->value.get()));
+            break;
+        }
+        case StmtType::Print:
+            emit(RegOpCode::PRINT, compileOperand(static_cast<PrintStmt*>(stmt)->expression.get()));
+            break;
+        case StmtType::Block:
+            compileBlockStmt(static_cast<BlockStmt*>(stmt));
+            break;
+    }
+
+    // No temporaries outlive a statement
+    m_nextRegister = static_cast<uint16_t>(m_locals.size());
+}
+
+void RegisterGenerator::compileLetStmt(LetStmt* stmt) {
+    if (m_scopeDepth == 0) {
+        uint16_t value = compileOperand(stmt->initializer.get());
+        emitBx(RegOpCode::SETGLOBAL, value, defineGlobal(stmt->name.lexeme()));
+        return;
+    }
+
+    // The new local's register is the next free one
+    compileInto(stmt->initializer.get(), allocRegister());
+    declareLocal(stmt->name.lexeme());
+}
+
+void RegisterGenerator::compileFunctionStmt(FunctionStmt* stmt) {
+    auto* function = m_heap.allocate<ObjFunction>();
+    function->name = std::string(stmt->name.lexeme());
+    function->arity = static_cast<uint8_t>(stmt->params.size());
+
+    // Compile the body into its own chunk with a fresh register file
+    RegisterChunk enclosingChunk = std::move(m_chunk);
+    std::vector<Local> enclosingLocals = std::move(m_locals);
+    size_t enclosingDepth = m_scopeDepth;
+    uint16_t enclosingNext = m_nextRegister;
+
+    m_chunk = RegisterChunk();
+    m_locals.clear();
+    m_scopeDepth = 0;
+    m_locals.push_back({function->name, 0, false});
+    m_nextRegister = 1;
+
+    beginScope();
+    for (const auto& param : stmt->params) {
+        allocRegister();
+        declareLocal(param.lexeme());
+    }
+    for (const auto& s : stmt->body) {
+        compileStmt(s.get());
+    }
+    uint16_t result = allocRegister();
+    emit(RegOpCode::LOADNIL, result);
+    emit(RegOpCode::RETURN, result);
+
+    function->registerChunk = std::move(m_chunk);
+    m_chunk = std::move(enclosingChunk);
+    m_locals = std::move(enclosingLocals);
+    m_scopeDepth = enclosingDepth;
+    m_nextRegister = enclosingNext;
+
+    if (m_scopeDepth == 0) {
+        emitBx(RegOpCode::SETGLOBAL, makeConstant(Value(function)), defineGlobal(function->name));
+        return;
+    }
+
+    uint16_t reg = allocRegister();
+    emitBx(RegOpCode::LOADK, reg, static_cast<uint32_t>(m_chunk.constants.size()));
+    m_chunk.constants.push_back(Value(function));
+    declareLocal(function->name);
+}
+
+void RegisterGenerator::compileIfStmt(IfStmt* stmt) {
+    size_t thenJump = emitJump(RegOpCode::JMPF, compileOperand(stmt->condition.get()));
+    m_nextRegister = static_cast<uint16_t>(m_locals.size());
+
+    compileStmt(stmt->thenBranch.get());
+
+    if (!stmt->elseBranch) {
+        patchJump(thenJump);
+        return;
+    }
+
+    size_t elseJump = emitJump(RegOpCode::JMP);
+    patchJump(thenJump);
+    compileStmt(stmt->elseBranch.get());
+    patchJump(elseJump);
+}
+
+void RegisterGenerator::compileWhileStmt(WhileStmt* stmt) {
+    size_t loopStart = m_chunk.code.size();
+
+    size_t exitJump = emitJump(RegOpCode::JMPF, compileOperand(stmt->condition.get()));
+    m_nextRegister = static_cast<uint16_t>(m_locals.size());
+
+    compileStmt(stmt->body.get());
+    emitLoop(loopStart);
+
+    patchJump(exitJump);
+}
+
+void RegisterGenerator::compileBlockStmt(BlockStmt* stmt) {
+    beginScope();
+    for (const auto& s : stmt->statements) {
+        compileStmt(s.get());
+    }
+    endScope();
+}
+
+void RegisterGenerator::error(const std::string& message) {
+    m_hadError = true;
+    m_error = message;
+}
+
+} // namespace minilang
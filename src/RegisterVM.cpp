@@ -0,0 +1,315 @@
+#include "RegisterVM.hpp"
+#include <cmath>
+#include <format>
+#include <iterator>
+
+namespace minilang {
+
+RegisterVM::RegisterVM() : m_registers(std::make_unique<Value[]>(REGISTERS_MAX)) {}
+
+// Labels-as-values is a GNU extension that -Wpedantic rejects, and the
+// fallback label is unused whenever every opcode has a table entry
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-label"
+
+InterpretResult RegisterVM::interpret(const RegisterChunk& chunk) {
+    m_error.clear();
+    m_frameCount = 0;
+
+    if (chunk.code.empty()) {
+        return InterpretResult::OK;
+    }
+
+    if (!hasRegisterRoom(m_registers.get(), chunk)) {
+        runtimeError("Stack overflow.");
+        return InterpretResult::RUNTIME_ERROR;
+    }
+
+    // Slots declared by this and earlier compilations start out undefined
+    m_globals.resize(m_globalNames.size(), Value::undefined());
+    Value* globals = m_globals.data();
+
+    // Register 0 of the script frame stands in for the callee
+    RegisterFrame* frame = &m_frames[m_frameCount++];
+    frame->chunk = &chunk;
+    frame->ip = chunk.code.data();
+    frame->base = m_registers.get();
+    frame->base[0] = Value();
+
+    // Hot frame state cached in locals; reloaded after calls and returns
+    Value* base = frame->base;
+    const Value* constants = chunk.constants.data();
+    const RegInstruction* instruction;
+
+#if MINILANG_PROFILE_OPCODES
+#define VM_PROFILE() m_executed++
+#else
+#define VM_PROFILE() ((void)0)
+#endif
+
+#define RK(operand) ((operand) & RK_CONSTANT ? constants[(operand) & RK_MAX] : base[operand])
+#define LOAD_FRAME()                                 \
+    do {                                             \
+        base = frame->base;                          \
+        constants = frame->chunk->constants.data();  \
+    } while (0)
+
+// Numeric binary op writing R[A]; 'check' rejects a zero divisor
+#define NUMERIC_OP(expr, check, checkMessage)                        \
+    do {                                                             \
+        Value b = RK(instruction->b);                                \
+        Value c = RK(instruction->c);                                \
+        if (!b.isNumber() || !c.isNumber()) {                        \
+            runtimeError("Operands must be numbers.");               \
+            return InterpretResult::RUNTIME_ERROR;                   \
+        }                                                            \
+        double x = b.asNumber();                                     \
+        double y = c.asNumber();                                     \
+        if (check && y == 0.0) {                                     \
+            runtimeError(checkMessage);                              \
+            return InterpretResult::RUNTIME_ERROR;                   \
+        }                                                            \
+        base[instruction->a] = Value(expr);                          \
+    } while (0)
+
+#if MINILANG_COMPUTED_GOTO
+    // Must list a label for every RegOpCode in declaration order
+    static void* const dispatchTable[] = {
+        &&L_MOVE, &&L_LOADK, &&L_LOADNIL, &&L_LOADBOOL, &&L_GETGLOBAL, &&L_SETGLOBAL,
+        &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD, &&L_NEG, &&L_NOT,
+        &&L_EQ, &&L_NE, &&L_LT, &&L_LE, &&L_GT, &&L_GE, &&L_AND, &&L_OR,
+        &&L_JMP, &&L_JMPF, &&L_CALL, &&L_RETURN, &&L_PRINT,
+    };
+    static_assert(std::size(dispatchTable) == REG_OPCODE_COUNT, "dispatch table out of sync with RegOpCode");
+
+#define VM_DISPATCH()          \
+    instruction = frame->ip++; \
+    VM_PROFILE();              \
+    goto *dispatchTable[static_cast<uint8_t>(instruction->op)];
+#define VM_CASE(op) L_##op
+#define VM_DEFAULT L_UNKNOWN
+#define VM_NEXT() VM_DISPATCH()
+#else
+#define VM_DISPATCH() switch (instruction = frame->ip++, VM_PROFILE(), instruction->op)
+#define VM_CASE(op) case RegOpCode::op
+#define VM_DEFAULT default
+#define VM_NEXT() break
+#endif
+
+    for (;;) {
+        VM_DISPATCH() {
+            // Loads and stores
+            VM_CASE(MOVE):
+                base[instruction->a] = base[instruction->b];
+                VM_NEXT();
+
+            VM_CASE(LOADK):
+                base[instruction->a] = frame->chunk->constants[instruction->bx()];
+                VM_NEXT();
+
+            VM_CASE(LOADNIL):
+                base[instruction->a] = Value();
+                VM_NEXT();
+
+            VM_CASE(LOADBOOL):
+                base[instruction->a] = Value(instruction->b != 0);
+                VM_NEXT();
+
+            VM_CASE(GETGLOBAL):
+                if (globals[instruction->bx()].isUndefined()) {
+                    runtimeError(std::format("Undefined variable '{}'.", m_globalNames.names[instruction->bx()]));
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                base[instruction->a] = globals[instruction->bx()];
+                VM_NEXT();
+
+            VM_CASE(SETGLOBAL):
+                globals[instruction->bx()] = RK(instruction->a);
+                VM_NEXT();
+
+            // Arithmetic
+            VM_CASE(ADD): {
+                Value b = RK(instruction->b);
+                Value c = RK(instruction->c);
+                if (b.isNumber() && c.isNumber()) {
+                    base[instruction->a] = Value(b.asNumber() + c.asNumber());
+                } else if (b.isString() && c.isString()) {
+                    base[instruction->a] = Value(m_heap.makeRuntimeString(b.asString() + c.asString()));
+                    if (m_heap.shouldCollect()) {
+                        collectGarbage();
+                    }
+                } else {
+                    runtimeError("Operands must be two numbers or two strings.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(SUB):
+                NUMERIC_OP(x - y, false, "");
+                VM_NEXT();
+
+            VM_CASE(MUL):
+                NUMERIC_OP(x * y, false, "");
+                VM_NEXT();
+
+            VM_CASE(DIV):
+                NUMERIC_OP(x / y, true, "Division by zero.");
+                VM_NEXT();
+
+            VM_CASE(MOD):
+                NUMERIC_OP(std::fmod(x, y), true, "Modulo by zero.");
+                VM_NEXT();
+
+            VM_CASE(NEG): {
+                Value value = RK(instruction->b);
+                if (!value.isNumber()) {
+                    runtimeError("Operand must be a number.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                base[instruction->a] = Value(-value.asNumber());
+                VM_NEXT();
+            }
+
+            VM_CASE(NOT):
+                base[instruction->a] = Value(isFalsey(RK(instruction->b)));
+                VM_NEXT();
+
+            // Comparison
+            VM_CASE(EQ):
+                base[instruction->a] = Value(valuesEqual(RK(instruction->b), RK(instruction->c)));
+                VM_NEXT();
+
+            VM_CASE(NE):
+                base[instruction->a] = Value(!valuesEqual(RK(instruction->b), RK(instruction->c)));
+                VM_NEXT();
+
+            VM_CASE(LT):
+                NUMERIC_OP(x < y, false, "");
+                VM_NEXT();
+
+            VM_CASE(LE):
+                NUMERIC_OP(x <= y, false, "");
+                VM_NEXT();
+
+            VM_CASE(GT):
+                NUMERIC_OP(x > y, false, "");
+                VM_NEXT();
+
+            VM_CASE(GE):
+                NUMERIC_OP(x >= y, false, "");
+                VM_NEXT();
+
+            // Logical
+            VM_CASE(AND):
+                base[instruction->a] = Value(!isFalsey(RK(instruction->b)) && !isFalsey(RK(instruction->c)));
+                VM_NEXT();
+
+            VM_CASE(OR):
+                base[instruction->a] = Value(!isFalsey(RK(instruction->b)) || !isFalsey(RK(instruction->c)));
+                VM_NEXT();
+
+            // Control flow
+            VM_CASE(JMP):
+                frame->ip += instruction->sbx();
+                VM_NEXT();
+
+            VM_CASE(JMPF):
+                if (isFalsey(RK(instruction->a))) {
+                    frame->ip += instruction->sbx();
+                }
+                VM_NEXT();
+
+            VM_CASE(CALL): {
+                if (!call(base + instruction->a, instruction->b)) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                frame = &m_frames[m_frameCount - 1];
+                LOAD_FRAME();
+                VM_NEXT();
+            }
+
+            VM_CASE(RETURN): {
+                Value result = RK(instruction->a);
+                m_frameCount--;
+                if (m_frameCount == 0) {
+                    return InterpretResult::OK;
+                }
+
+                // The callee's register 0 is the caller's CALL destination
+                *frame->base = result;
+                frame = &m_frames[m_frameCount - 1];
+                LOAD_FRAME();
+                VM_NEXT();
+            }
+
+            // Built-in
+            VM_CASE(PRINT):
+                *m_output << valueToString(RK(instruction->a)) << std::endl;
+                VM_NEXT();
+
+            VM_DEFAULT:
+                runtimeError(std::format("Unknown opcode: {}", static_cast<int>(instruction->op)));
+                return InterpretResult::RUNTIME_ERROR;
+        }
+    }
+
+#undef RK
+#undef LOAD_FRAME
+#undef NUMERIC_OP
+#undef VM_PROFILE
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_NEXT
+
+    return InterpretResult::OK;
+}
+
+#pragma GCC diagnostic pop
+
+bool RegisterVM::call(Value* base, uint16_t argCount) {
+    Value callee = base[0];
+    if (!callee.isFunction()) {
+        runtimeError("Can only call functions.");
+        return false;
+    }
+
+    const ObjFunction* function = callee.asFunction();
+    if (argCount != function->arity) {
+        runtimeError(std::format("Expected {} arguments but got {}.", function->arity, argCount));
+        return false;
+    }
+
+    if (m_frameCount == FRAMES_MAX || !hasRegisterRoom(base, function->registerChunk)) {
+        runtimeError("Stack overflow.");
+        return false;
+    }
+
+    RegisterFrame* frame = &m_frames[m_frameCount++];
+    frame->chunk = &function->registerChunk;
+    frame->ip = function->registerChunk.code.data();
+    frame->base = base;
+    return true;
+}
+
+void RegisterVM::collectGarbage() {
+    // Callee windows start inside their caller's, so the innermost frame's
+    // window ends above every live register
+    const RegisterFrame& frame = m_frames[m_frameCount - 1];
+    for (const Value* reg = m_registers.get(); reg < frame.base + frame.chunk->registerCount; reg++) {
+        m_heap.mark(*reg);
+    }
+    for (Value global : m_globals) {
+        m_heap.mark(global);
+    }
+    m_heap.sweep();
+}
+
+void RegisterVM::runtimeError(const std::string& message) {
+    m_error = message;
+    m_frameCount = 0;
+}
+
+} // namespace minilang
@@ -0,0 +1,626 @@
+#include "SSA.hpp"
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+
+namespace minilang {
+
+const char* ssaOpName(SSAOp op) {
+    switch (op) {
+        case SSAOp::PARAM: return "param";
+        case SSAOp::CONST: return "const";
+        case SSAOp::FUNCTION: return "function";
+        case SSAOp::GET_GLOBAL: return "get_global";
+        case SSAOp::PHI: return "phi";
+        case SSAOp::ADD: return "add";
+        case SSAOp::SUB: return "sub";
+        case SSAOp::MUL: return "mul";
+        case SSAOp::DIV: return "div";
+        case SSAOp::MOD: return "mod";
+        case SSAOp::NEG: return "neg";
+        case SSAOp::EQ: return "eq";
+        case SSAOp::NE: return "ne";
+        case SSAOp::LT: return "lt";
+        case SSAOp::LE: return "le";
+        case SSAOp::GT: return "gt";
+        case SSAOp::GE: return "ge";
+        case SSAOp::NOT: return "not";
+        case SSAOp::AND: return "and";
+        case SSAOp::OR: return "or";
+        case SSAOp::CALL: return "call";
+        case SSAOp::SET_GLOBAL: return "set_global";
+        case SSAOp::PRINT: return "print";
+        case SSAOp::JUMP: return "jump";
+        case SSAOp::BRANCH: return "branch";
+        case SSAOp::RETURN: return "return";
+        default: return "unknown";
+    }
+}
+
+const char* ssaTypeName(SSAType type) {
+    switch (type) {
+        case SSAType::NONE: return "none";
+        case SSAType::NIL: return "nil";
+        case SSAType::BOOL: return "bool";
+        case SSAType::NUMBER: return "num";
+        case SSAType::STRING: return "str";
+        case SSAType::FUNCTION: return "fn";
+        case SSAType::ANY: return "any";
+        default: return "unknown";
+    }
+}
+
+SSAType joinTypes(SSAType a, SSAType b) {
+    if (a == SSAType::NONE) return b;
+    if (b == SSAType::NONE || a == b) return a;
+    return SSAType::ANY;
+}
+
+bool isTerminator(SSAOp op) {
+    return op == SSAOp::JUMP || op == SSAOp::BRANCH || op == SSAOp::RETURN;
+}
+
+bool hasResult(SSAOp op) {
+    return !isTerminator(op) && op != SSAOp::SET_GLOBAL && op != SSAOp::PRINT;
+}
+
+bool isPure(SSAOp op) {
+    switch (op) {
+        case SSAOp::PARAM:
+        case SSAOp::CONST:
+        case SSAOp::FUNCTION:
+        case SSAOp::GET_GLOBAL:
+        case SSAOp::PHI:
+        case SSAOp::EQ:
+        case SSAOp::NE:
+        case SSAOp::NOT:
+        case SSAOp::AND:
+        case SSAOp::OR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t SSAFunction::append(uint32_t block, SSAOp op, std::vector<uint32_t> operands, uint32_t index) {
+    uint32_t id = static_cast<uint32_t>(values.size());
+    values.push_back({op, SSAType::NONE, block, index, std::move(operands), {}});
+    blocks[block].instrs.push_back(id);
+    return id;
+}
+
+uint32_t SSAFunction::addPhi(uint32_t block) {
+    uint32_t id = static_cast<uint32_t>(values.size());
+    values.push_back({SSAOp::PHI, SSAType::NONE, block, 0, {}, {}});
+
+    std::vector<uint32_t>& instrs = blocks[block].instrs;
+    auto it = std::find_if(instrs.begin(), instrs.end(), [&](uint32_t v) { return values[v].op != SSAOp::PHI; });
+    instrs.insert(it, id);
+    return id;
+}
+
+uint32_t SSAFunction::addBlock() {
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+const std::vector<uint32_t>& SSAFunction::successors(uint32_t block) const {
+    static const std::vector<uint32_t> none;
+    const std::vector<uint32_t>& instrs = blocks[block].instrs;
+    if (instrs.empty() || !isTerminator(values[instrs.back()].op)) {
+        return none;
+    }
+    return values[instrs.back()].targets;
+}
+
+std::vector<uint32_t> reversePostorder(const SSAFunction& function) {
+    std::vector<uint32_t> order;
+    if (function.blocks.empty()) return order;
+
+    // Iterative DFS; successors are visited last-first so the first
+    // target ends up first in reverse postorder
+    std::vector<bool> visited(function.blocks.size(), false);
+    std::vector<std::pair<uint32_t, size_t>> stack;
+    stack.push_back({0, function.successors(0).size()});
+    visited[0] = true;
+
+    while (!stack.empty()) {
+        auto& [block, remaining] = stack.back();
+        if (remaining == 0) {
+            order.push_back(block);
+            stack.pop_back();
+            continue;
+        }
+
+        uint32_t succ = function.successors(block)[--remaining];
+        if (!visited[succ]) {
+            visited[succ] = true;
+            stack.push_back({succ, function.successors(succ).size()});
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<uint32_t> immediateDominators(const SSAFunction& function) {
+    // Cooper, Harvey and Kennedy: iterate intersections in reverse postorder
+    std::vector<uint32_t> order = reversePostorder(function);
+    std::vector<uint32_t> number(function.blocks.size(), UINT32_MAX);
+    for (size_t i = 0; i < order.size(); i++) {
+        number[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<uint32_t> idom(function.blocks.size(), UINT32_MAX);
+    if (order.empty()) return idom;
+    idom[order[0]] = order[0];
+
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (number[a] > number[b]) a = idom[a];
+            while (number[b] > number[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); i++) {
+            uint32_t block = order[i];
+            uint32_t dom = UINT32_MAX;
+            for (uint32_t pred : function.blocks[block].preds) {
+                if (idom[pred] == UINT32_MAX) continue;
+                dom = dom == UINT32_MAX ? pred : intersect(pred, dom);
+            }
+            if (idom[block] != dom) {
+                idom[block] = dom;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
+
+bool dominates(const std::vector<uint32_t>& idom, uint32_t a, uint32_t b) {
+    if (idom[b] == UINT32_MAX) return false;
+    while (true) {
+        if (a == b) return true;
+        if (idom[b] == b) return false;
+        b = idom[b];
+    }
+}
+
+std::vector<uint32_t> useCounts(const SSAFunction& function) {
+    std::vector<uint32_t> uses(function.values.size(), 0);
+    for (const SSABlock& block : function.blocks) {
+        for (uint32_t id : block.instrs) {
+            for (uint32_t operand : function.values[id].operands) {
+                uses[operand]++;
+            }
+        }
+    }
+    return uses;
+}
+
+void replaceUses(SSAFunction& function, uint32_t from, uint32_t to) {
+    for (const SSABlock& block : function.blocks) {
+        for (uint32_t id : block.instrs) {
+            for (uint32_t& operand : function.values[id].operands) {
+                if (operand == from) operand = to;
+            }
+        }
+    }
+}
+
+void removeUnreachableBlocks(SSAFunction& function) {
+    std::vector<bool> reachable(function.blocks.size(), false);
+    for (uint32_t block : reversePostorder(function)) {
+        reachable[block] = true;
+    }
+
+    // Renumber survivors in their original order
+    std::vector<uint32_t> renumber(function.blocks.size(), UINT32_MAX);
+    std::vector<SSABlock> blocks;
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        if (!reachable[b]) continue;
+        renumber[b] = static_cast<uint32_t>(blocks.size());
+        blocks.push_back(std::move(function.blocks[b]));
+    }
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        SSABlock& block = blocks[b];
+
+        // Forget edges from dead blocks, keeping phi operands aligned
+        std::vector<size_t> kept;
+        for (size_t p = 0; p < block.preds.size(); p++) {
+            if (reachable[block.preds[p]]) kept.push_back(p);
+        }
+        for (uint32_t id : block.instrs) {
+            SSAInstr& instr = function.values[id];
+            instr.block = static_cast<uint32_t>(b);
+            if (instr.op == SSAOp::PHI) {
+                std::vector<uint32_t> operands;
+                for (size_t p : kept) operands.push_back(instr.operands[p]);
+                instr.operands = std::move(operands);
+            }
+            for (uint32_t& target : instr.targets) {
+                target = renumber[target];
+            }
+        }
+
+        std::vector<uint32_t> preds;
+        for (size_t p : kept) preds.push_back(renumber[block.preds[p]]);
+        block.preds = std::move(preds);
+    }
+
+    function.blocks = std::move(blocks);
+}
+
+void removeTrivialPhis(SSAFunction& function) {
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (SSABlock& block : function.blocks) {
+            for (size_t i = 0; i < block.instrs.size() && function.values[block.instrs[i]].op == SSAOp::PHI;) {
+                uint32_t phi = block.instrs[i];
+                uint32_t same = UINT32_MAX;
+                bool trivial = true;
+                for (uint32_t operand : function.values[phi].operands) {
+                    if (operand == phi || operand == same) continue;
+                    if (same != UINT32_MAX) {
+                        trivial = false;
+                        break;
+                    }
+                    same = operand;
+                }
+
+                if (!trivial || same == UINT32_MAX) {
+                    i++;
+                    continue;
+                }
+                block.instrs.erase(block.instrs.begin() + static_cast<std::ptrdiff_t>(i));
+                replaceUses(function, phi, same);
+                changed = true;
+            }
+        }
+    }
+}
+
+void splitCriticalEdges(SSAFunction& function) {
+    const size_t count = function.blocks.size();
+    for (uint32_t b = 0; b < count; b++) {
+        if (function.successors(b).size() < 2) continue;
+
+        for (size_t t = 0; t < function.successors(b).size(); t++) {
+            uint32_t succ = function.successors(b)[t];
+            const std::vector<uint32_t>& instrs = function.blocks[succ].instrs;
+            if (instrs.empty() || function.values[instrs.front()].op != SSAOp::PHI) continue;
+
+            uint32_t edge = function.addBlock();
+            function.blocks[edge].preds.push_back(b);
+            uint32_t jump = function.append(edge, SSAOp::JUMP);
+            function.values[jump].targets.push_back(succ);
+
+            // Take over the first edge from b that has not been split yet
+            std::vector<uint32_t>& preds = function.blocks[succ].preds;
+            *std::find(preds.begin(), preds.end(), b) = edge;
+            function.values[function.blocks[b].instrs.back()].targets[t] = edge;
+        }
+    }
+}
+
+namespace {
+
+SSAType constantType(Value value) {
+    switch (value.type()) {
+        case ValueType::NIL: return SSAType::NIL;
+        case ValueType::BOOL: return SSAType::BOOL;
+        case ValueType::NUMBER: return SSAType::NUMBER;
+        case ValueType::STRING: return SSAType::STRING;
+        case ValueType::FUNCTION: return SSAType::FUNCTION;
+    }
+    return SSAType::ANY;
+}
+
+// Type of `a + b` when it does not raise an error
+SSAType addType(SSAType a, SSAType b) {
+    for (SSAType type : {SSAType::NUMBER, SSAType::STRING}) {
+        if (a != type && b != type) continue;
+        SSAType other = a == type ? b : a;
+        return other == type || other == SSAType::NONE || other == SSAType::ANY ? type : SSAType::ANY;
+    }
+    return a == SSAType::NONE && b == SSAType::NONE ? SSAType::NONE : SSAType::ANY;
+}
+
+SSAType resultType(const SSAFunction& function, const SSAInstr& instr) {
+    auto operand = [&](size_t i) { return function.values[instr.operands[i]].type; };
+
+    switch (instr.op) {
+        case SSAOp::CONST:
+            return constantType(function.constants[instr.index]);
+        case SSAOp::FUNCTION:
+            return SSAType::FUNCTION;
+        case SSAOp::PARAM:
+        case SSAOp::GET_GLOBAL:
+        case SSAOp::CALL:
+            return SSAType::ANY;
+        case SSAOp::PHI: {
+            SSAType type = SSAType::NONE;
+            for (size_t i = 0; i < instr.operands.size(); i++) {
+                type = joinTypes(type, operand(i));
+            }
+            return type;
+        }
+        case SSAOp::ADD:
+            return addType(operand(0), operand(1));
+        case SSAOp::SUB:
+        case SSAOp::MUL:
+        case SSAOp::DIV:
+        case SSAOp::MOD:
+        case SSAOp::NEG:
+            return SSAType::NUMBER;
+        case SSAOp::EQ:
+        case SSAOp::NE:
+        case SSAOp::LT:
+        case SSAOp::LE:
+        case SSAOp::GT:
+        case SSAOp::GE:
+        case SSAOp::NOT:
+        case SSAOp::AND:
+        case SSAOp::OR:
+            return SSAType::BOOL;
+        default:
+            return SSAType::NONE;
+    }
+}
+
+} // namespace
+
+void inferTypes(SSAFunction& function) {
+    std::vector<uint32_t> order = reversePostorder(function);
+    for (uint32_t block : order) {
+        for (uint32_t id : function.blocks[block].instrs) {
+            if (function.values[id].op == SSAOp::PHI) function.values[id].type = SSAType::NONE;
+        }
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t block : order) {
+            for (uint32_t id : function.blocks[block].instrs) {
+                SSAType type = resultType(function, function.values[id]);
+                if (function.values[id].type != type) {
+                    function.values[id].type = type;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+namespace {
+
+// Expected operand count of an instruction, or -1 when it is checked separately
+int operandCount(const SSAInstr& instr) {
+    switch (instr.op) {
+        case SSAOp::PARAM:
+        case SSAOp::CONST:
+        case SSAOp::FUNCTION:
+        case SSAOp::GET_GLOBAL:
+        case SSAOp::JUMP:
+            return 0;
+        case SSAOp::NEG:
+        case SSAOp::NOT:
+        case SSAOp::SET_GLOBAL:
+        case SSAOp::PRINT:
+        case SSAOp::BRANCH:
+        case SSAOp::RETURN:
+            return 1;
+        case SSAOp::PHI:
+            return -1;
+        case SSAOp::CALL:
+            return static_cast<int>(instr.index) + 1;
+        default:
+            return 2;
+    }
+}
+
+std::string verifyFunction(const SSAFunction& function) {
+    const size_t blockCount = function.blocks.size();
+    if (blockCount == 0) return "no entry block";
+    if (!function.blocks[0].preds.empty()) return "entry block has predecessors";
+
+    // Where each live instruction sits
+    std::vector<uint32_t> blockOf(function.values.size(), UINT32_MAX);
+    std::vector<size_t> position(function.values.size(), 0);
+    for (uint32_t b = 0; b < blockCount; b++) {
+        const std::vector<uint32_t>& instrs = function.blocks[b].instrs;
+        for (size_t i = 0; i < instrs.size(); i++) {
+            uint32_t id = instrs[i];
+            if (id >= function.values.size()) return std::format("b{}: unknown value v{}", b, id);
+            if (blockOf[id] != UINT32_MAX) return std::format("v{} appears twice", id);
+            if (function.values[id].block != b) return std::format("v{} is in b{} but records b{}", id, b, function.values[id].block);
+            blockOf[id] = b;
+            position[id] = i;
+        }
+    }
+
+    // Block shape and edges
+    std::vector<std::vector<uint32_t>> preds(blockCount);
+    for (uint32_t b = 0; b < blockCount; b++) {
+        const std::vector<uint32_t>& instrs = function.blocks[b].instrs;
+        if (instrs.empty() || !isTerminator(function.values[instrs.back()].op)) {
+            return std::format("b{} does not end in a terminator", b);
+        }
+
+        bool seenNonPhi = false;
+        for (size_t i = 0; i < instrs.size(); i++) {
+            const SSAInstr& instr = function.values[instrs[i]];
+            if (isTerminator(instr.op) && i + 1 != instrs.size()) {
+                return std::format("b{}: terminator v{} is not last", b, instrs[i]);
+            }
+            if (instr.op == SSAOp::PHI && seenNonPhi) {
+                return std::format("b{}: phi v{} follows other instructions", b, instrs[i]);
+            }
+            seenNonPhi = instr.op != SSAOp::PHI;
+        }
+
+        const SSAInstr& terminator = function.values[instrs.back()];
+        size_t targets = terminator.op == SSAOp::JUMP ? 1 : terminator.op == SSAOp::BRANCH ? 2 : 0;
+        if (terminator.targets.size() != targets) {
+            return std::format("b{}: {} has {} targets", b, ssaOpName(terminator.op), terminator.targets.size());
+        }
+        for (uint32_t target : terminator.targets) {
+            if (target >= blockCount) return std::format("b{}: jump to unknown block b{}", b, target);
+            if (target == 0) return std::format("b{}: jump to the entry block", b);
+            preds[target].push_back(b);
+        }
+    }
+
+    for (uint32_t b = 0; b < blockCount; b++) {
+        std::vector<uint32_t> expected = preds[b];
+        std::vector<uint32_t> actual = function.blocks[b].preds;
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        if (expected != actual) return std::format("b{}: predecessor list does not match its incoming edges", b);
+    }
+
+    std::vector<uint32_t> idom = immediateDominators(function);
+    for (uint32_t b = 0; b < blockCount; b++) {
+        if (idom[b] == UINT32_MAX) return std::format("b{} is unreachable", b);
+    }
+
+    // Operands: defined, produce a value, and dominate their use
+    for (uint32_t b = 0; b < blockCount; b++) {
+        const SSABlock& block = function.blocks[b];
+        for (uint32_t id : block.instrs) {
+            const SSAInstr& instr = function.values[id];
+            int expected = operandCount(instr);
+            if (instr.op == SSAOp::PHI) expected = static_cast<int>(block.preds.size());
+            if (static_cast<int>(instr.operands.size()) != expected) {
+                return std::format("v{}: {} has {} operands", id, ssaOpName(instr.op), instr.operands.size());
+            }
+            if (instr.op == SSAOp::CONST && instr.index >= function.constants.size()) {
+                return std::format("v{}: unknown constant {}", id, instr.index);
+            }
+            if (instr.op == SSAOp::FUNCTION && instr.index >= function.functions.size()) {
+                return std::format("v{}: unknown function {}", id, instr.index);
+            }
+            if (hasResult(instr.op) && instr.type == SSAType::NONE && instr.op != SSAOp::PHI) {
+                return std::format("v{}: value has no type", id);
+            }
+
+            for (size_t i = 0; i < instr.operands.size(); i++) {
+                uint32_t operand = instr.operands[i];
+                if (operand >= function.values.size() || blockOf[operand] == UINT32_MAX) {
+                    return std::format("v{}: operand v{} is not defined", id, operand);
+                }
+                if (!hasResult(function.values[operand].op)) {
+                    return std::format("v{}: operand v{} has no value", id, operand);
+                }
+
+                uint32_t def = blockOf[operand];
+                bool dominated = instr.op == SSAOp::PHI ? dominates(idom, def, block.preds[i])
+                                 : def == b              ? position[operand] < position[id]
+                                                         : dominates(idom, def, b);
+                if (!dominated) {
+                    return std::format("v{}: operand v{} does not dominate its use", id, operand);
+                }
+            }
+        }
+    }
+
+    return "";
+}
+
+std::string operandList(const std::vector<uint32_t>& operands) {
+    std::string list;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (i > 0) list += ", ";
+        list += std::format("v{}", operands[i]);
+    }
+    return list;
+}
+
+void dumpFunction(const SSAFunction& function, std::string& out) {
+    out += std::format("function {} ({} params)\n", function.name.empty() ? "<script>" : function.name, function.arity);
+
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        const SSABlock& block = function.blocks[b];
+        out += std::format("b{}:", b);
+        if (!block.preds.empty()) {
+            std::string preds;
+            for (uint32_t pred : block.preds) preds += std::format(" b{}", pred);
+            out += std::format("  ; preds{}", preds);
+        }
+        out += "\n";
+
+        for (uint32_t id : block.instrs) {
+            const SSAInstr& instr = function.values[id];
+            out += "  ";
+            if (hasResult(instr.op)) out += std::format("v{}:{} = ", id, ssaTypeName(instr.type));
+            out += ssaOpName(instr.op);
+
+            switch (instr.op) {
+                case SSAOp::PARAM:
+                    out += std::format(" {}", instr.index);
+                    break;
+                case SSAOp::CONST: {
+                    Value value = function.constants[instr.index];
+                    out += value.isString() ? std::format(" \"{}\"", value.asString()) : std::format(" {}", valueToString(value));
+                    break;
+                }
+                case SSAOp::FUNCTION:
+                    out += std::format(" {}", function.functions[instr.index]->name);
+                    break;
+                case SSAOp::GET_GLOBAL:
+                    out += std::format(" g{}", instr.index);
+                    break;
+                case SSAOp::SET_GLOBAL:
+                    out += std::format(" g{}, v{}", instr.index, instr.operands[0]);
+                    break;
+                case SSAOp::PHI:
+                    for (size_t i = 0; i < instr.operands.size(); i++) {
+                        out += std::format("{} [v{}, b{}]", i > 0 ? "," : "", instr.operands[i], block.preds[i]);
+                    }
+                    break;
+                case SSAOp::JUMP:
+                    out += std::format(" b{}", instr.targets[0]);
+                    break;
+                case SSAOp::BRANCH:
+                    out += std::format(" v{}, b{}, b{}", instr.operands[0], instr.targets[0], instr.targets[1]);
+                    break;
+                default:
+                    if (!instr.operands.empty()) out += std::format(" {}", operandList(instr.operands));
+                    break;
+            }
+            out += "\n";
+        }
+    }
+
+    for (const auto& nested : function.functions) {
+        out += "\n";
+        dumpFunction(*nested, out);
+    }
+}
+
+} // namespace
+
+std::string verifySSA(const SSAFunction& function) {
+    std::string problem = verifyFunction(function);
+    if (!problem.empty()) {
+        return std::format("SSA verification failed in {}: {}", function.name.empty() ? "<script>" : function.name, problem);
+    }
+    for (const auto& nested : function.functions) {
+        problem = verifySSA(*nested);
+        if (!problem.empty()) return problem;
+    }
+    return "";
+}
+
+std::string dumpSSA(const SSAFunction& function) {
+    std::string out;
+    dumpFunction(function, out);
+    return out;
+}
+
+} // namespace minilang
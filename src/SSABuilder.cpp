@@ -0,0 +1,476 @@
+#include "SSABuilder.hpp"
+#include <algorithm>
+#include <format>
+
+namespace minilang {
+
+SSABuilder::SSABuilder(Heap& heap, GlobalTable& globals) : m_heap(heap), m_globals(globals) {}
+
+std::unique_ptr<SSAFunction> SSABuilder::build(const Program& program) {
+    m_hadError = false;
+    m_error.clear();
+    m_pendingGlobals.clear();
+
+    auto script = std::make_unique<SSAFunction>();
+    m_state = FunctionState();
+    m_state.function = script.get();
+    m_state.current = newBlock();
+    sealBlock(m_state.current);
+
+    // Top-level declarations stay at depth 0 and become globals
+    for (const auto& stmt : program) {
+        buildStmt(stmt.get());
+        if (m_hadError) {
+            return script;
+        }
+    }
+
+    checkGlobalsDefined();
+    if (!terminated()) {
+        emit(SSAOp::RETURN, {emitConstant(Value())});
+    }
+    finishFunction();
+    return script;
+}
+
+uint32_t SSABuilder::newBlock() {
+    m_state.defs.emplace_back();
+    m_state.pending.emplace_back();
+    m_state.sealed.push_back(false);
+    return m_state.function->addBlock();
+}
+
+void SSABuilder::addEdge(uint32_t from, uint32_t to) {
+    m_state.function->blocks[to].preds.push_back(from);
+}
+
+void SSABuilder::sealBlock(uint32_t block) {
+    // Every predecessor is known now, so incomplete phis can be filled in
+    for (const auto& [variable, phi] : m_state.pending[block]) {
+        addPhiOperands(variable, phi);
+    }
+    m_state.pending[block].clear();
+    m_state.sealed[block] = true;
+}
+
+bool SSABuilder::terminated() const {
+    const SSAFunction& function = *m_state.function;
+    const std::vector<uint32_t>& instrs = function.blocks[m_state.current].instrs;
+    return !instrs.empty() && isTerminator(function.values[instrs.back()].op);
+}
+
+uint32_t SSABuilder::emit(SSAOp op, std::vector<uint32_t> operands, uint32_t index) {
+    return m_state.function->append(m_state.current, op, std::move(operands), index);
+}
+
+uint32_t SSABuilder::emitConstant(Value value) {
+    // Reuse an identical number or string already in the pool
+    std::vector<Value>& constants = m_state.function->constants;
+    for (size_t i = 0; i < constants.size(); i++) {
+        const Value& constant = constants[i];
+        if (constant.sameBits(value) || (constant.isString() && value.isString() && constant.asString() == value.asString())) {
+            return emit(SSAOp::CONST, {}, static_cast<uint32_t>(i));
+        }
+    }
+
+    constants.push_back(value);
+    return emit(SSAOp::CONST, {}, static_cast<uint32_t>(constants.size() - 1));
+}
+
+void SSABuilder::emitJump(uint32_t target) {
+    uint32_t jump = emit(SSAOp::JUMP);
+    m_state.function->values[jump].targets = {target};
+    addEdge(m_state.current, target);
+}
+
+void SSABuilder::emitBranch(uint32_t condition, uint32_t ifTrue, uint32_t ifFalse) {
+    uint32_t branch = emit(SSAOp::BRANCH, {condition});
+    m_state.function->values[branch].targets = {ifTrue, ifFalse};
+    addEdge(m_state.current, ifTrue);
+    addEdge(m_state.current, ifFalse);
+}
+
+void SSABuilder::startUnreachable() {
+    // Code after a return still has to be built somewhere; the block is
+    // dropped once the function is finished
+    m_state.current = newBlock();
+    sealBlock(m_state.current);
+}
+
+void SSABuilder::beginScope() {
+    m_state.scopeDepth++;
+}
+
+void SSABuilder::endScope() {
+    m_state.scopeDepth--;
+    while (!m_state.scope.empty() && m_state.scope.back().depth > m_state.scopeDepth) {
+        m_state.scope.pop_back();
+    }
+}
+
+uint32_t SSABuilder::declareLocal(std::string_view name) {
+    for (auto it = m_state.scope.rbegin(); it != m_state.scope.rend(); ++it) {
+        if (it->depth != m_state.scopeDepth) break;
+        if (it->name == name) {
+            error(std::format("Variable '{}' already declared in this scope.", name));
+            return it->variable;
+        }
+    }
+
+    // Same limit as the stack generator, which gives every local a slot
+    if (m_state.scope.size() >= LOCALS_MAX) {
+        error("Too many local variables in function.");
+    }
+
+    uint32_t variable = m_state.variableCount++;
+    m_state.scope.push_back({name, m_state.scopeDepth, variable});
+    return variable;
+}
+
+int SSABuilder::resolveLocal(std::string_view name) const {
+    for (auto it = m_state.scope.rbegin(); it != m_state.scope.rend(); ++it) {
+        if (it->name == name) {
+            return static_cast<int>(it->variable);
+        }
+    }
+    return -1; // Not found, treat as global
+}
+
+uint32_t SSABuilder::resolveGlobal(std::string_view name) {
+    uint32_t slot = m_globals.slotFor(name);
+    if (!m_globals.defined[slot]) {
+        // May still be declared further down the program
+        m_pendingGlobals.push_back(slot);
+    }
+    return slot;
+}
+
+uint32_t SSABuilder::defineGlobal(std::string_view name) {
+    uint32_t slot = m_globals.define(name);
+    if (!m_declaredGlobals.insert(slot).second) {
+        error(std::format("Variable '{}' already declared in this scope.", name));
+    }
+    return slot;
+}
+
+void SSABuilder::checkGlobalsDefined() {
+    for (uint32_t slot : m_pendingGlobals) {
+        if (!m_globals.defined[slot]) {
+            error(std::format("Undefined variable: {}", m_globals.names[slot]));
+            return;
+        }
+    }
+}
+
+void SSABuilder::writeVariable(uint32_t variable, uint32_t block, uint32_t value) {
+    m_state.defs[block][variable] = value;
+}
+
+uint32_t SSABuilder::readVariable(uint32_t variable, uint32_t block) {
+    auto it = m_state.defs[block].find(variable);
+    if (it != m_state.defs[block].end()) {
+        return it->second;
+    }
+    return readVariableRecursive(variable, block);
+}
+
+uint32_t SSABuilder::readVariableRecursive(uint32_t variable, uint32_t block) {
+    SSAFunction& function = *m_state.function;
+    uint32_t value;
+
+    if (!m_state.sealed[block]) {
+        // Loop header whose back-edge is not built yet
+        value = function.addPhi(block);
+        m_state.pending[block][variable] = value;
+    } else if (function.blocks[block].preds.empty()) {
+        // Only blocks after a return lack predecessors; they are dropped later
+        uint32_t current = m_state.current;
+        m_state.current = block;
+        value = emitConstant(Value());
+        m_state.current = current;
+
+        std::vector<uint32_t>& instrs = function.blocks[block].instrs;
+        std::rotate(instrs.begin(), instrs.end() - 1, instrs.end());
+    } else if (function.blocks[block].preds.size() == 1) {
+        value = readVariable(variable, function.blocks[block].preds[0]);
+    } else {
+        // Break cycles through loops before visiting the predecessors
+        value = function.addPhi(block);
+        writeVariable(variable, block, value);
+        addPhiOperands(variable, value);
+    }
+
+    writeVariable(variable, block, value);
+    return value;
+}
+
+void SSABuilder::addPhiOperands(uint32_t variable, uint32_t phi) {
+    SSAFunction& function = *m_state.function;
+    std::vector<uint32_t> preds = function.blocks[function.values[phi].block].preds;
+    for (uint32_t pred : preds) {
+        uint32_t operand = readVariable(variable, pred);
+        function.values[phi].operands.push_back(operand);
+    }
+}
+
+uint32_t SSABuilder::buildExpr(Expr* expr) {
+    if (!expr) {
+        return emitConstant(Value());
+    }
+
+    switch (expr->getType()) {
+        case ExprType::Binary:
+            return buildBinaryExpr(static_cast<BinaryExpr*>(expr));
+        case ExprType::Unary:
+            return buildUnaryExpr(static_cast<UnaryExpr*>(expr));
+        case ExprType::Literal:
+            return buildLiteralExpr(static_cast<LiteralExpr*>(expr));
+        case ExprType::Variable:
+            return buildVariableExpr(static_cast<VariableExpr*>(expr));
+        case ExprType::Assignment:
+            return buildAssignExpr(static_cast<AssignExpr*>(expr));
+        case ExprType::Call:
+            return buildCallExpr(static_cast<CallExpr*>(expr));
+        case ExprType::Grouping:
+            return buildExpr(static_cast<GroupingExpr*>(expr)->expression.get());
+    }
+    return emitConstant(Value());
+}
+
+uint32_t SSABuilder::buildBinaryExpr(BinaryExpr* expr) {
+    uint32_t left = buildExpr(expr->left.get());
+    uint32_t right = buildExpr(expr->right.get());
+
+    SSAOp op;
+    switch (expr->op.type) {
+        case TokenType::PLUS: op = SSAOp::ADD; break;
+        case TokenType::MINUS: op = SSAOp::SUB; break;
+        case TokenType::STAR: op = SSAOp::MUL; break;
+        case TokenType::SLASH: op = SSAOp::DIV; break;
+        case TokenType::PERCENT: op = SSAOp::MOD; break;
+
+        case TokenType::EQUAL_EQUAL: op = SSAOp::EQ; break;
+        case TokenType::BANG_EQUAL: op = SSAOp::NE; break;
+        case TokenType::LESS: op = SSAOp::LT; break;
+        case TokenType::LESS_EQUAL: op = SSAOp::LE; break;
+        case TokenType::GREATER: op = SSAOp::GT; break;
+        case TokenType::GREATER_EQUAL: op = SSAOp::GE; break;
+
+        case TokenType::AND: op = SSAOp::AND; break;
+        case TokenType::OR: op = SSAOp::OR; break;
+
+        default:
+            error(std::format("Unknown binary operator: {}", expr->op.lexeme()));
+            return left;
+    }
+    return emit(op, {left, right});
+}
+
+uint32_t SSABuilder::buildUnaryExpr(UnaryExpr* expr) {
+    uint32_t operand = buildExpr(expr->right.get());
+
+    switch (expr->op.type) {
+        case TokenType::MINUS: return emit(SSAOp::NEG, {operand});
+        case TokenType::BANG: return emit(SSAOp::NOT, {operand});
+        default:
+            error(std::format("Unknown unary operator: {}", expr->op.lexeme()));
+            return operand;
+    }
+}
+
+uint32_t SSABuilder::buildLiteralExpr(LiteralExpr* expr) {
+    if (std::holds_alternative<double>(expr->value)) {
+        return emitConstant(Value(std::get<double>(expr->value)));
+    }
+    if (std::holds_alternative<std::string>(expr->value)) {
+        return emitConstant(Value(m_heap.makeString(std::get<std::string>(expr->value))));
+    }
+    if (std::holds_alternative<bool>(expr->value)) {
+        return emitConstant(Value(std::get<bool>(expr->value)));
+    }
+    return emitConstant(Value());
+}
+
+uint32_t SSABuilder::buildVariableExpr(VariableExpr* expr) {
+    int local = resolveLocal(expr->name.lexeme());
+    if (local != -1) {
+        return readVariable(static_cast<uint32_t>(local), m_state.current);
+    }
+    return emit(SSAOp::GET_GLOBAL, {}, resolveGlobal(expr->name.lexeme()));
+}
+
+uint32_t SSABuilder::buildAssignExpr(AssignExpr* expr) {
+    uint32_t value = buildExpr(expr->value.get());
+
+    int local = resolveLocal(expr->name.lexeme());
+    if (local != -1) {
+        writeVariable(static_cast<uint32_t>(local), m_state.current, value);
+    } else {
+        emit(SSAOp::SET_GLOBAL, {value}, resolveGlobal(expr->name.lexeme()));
+    }
+    return value;
+}
+
+uint32_t SSABuilder::buildCallExpr(CallExpr* expr) {
+    std::vector<uint32_t> operands;
+    operands.push_back(buildExpr(expr->callee.get()));
+    for (const auto& arg : expr->arguments) {
+        operands.push_back(buildExpr(arg.get()));
+    }
+    return emit(SSAOp::CALL, std::move(operands), static_cast<uint32_t>(expr->arguments.size()));
+}
+
+void SSABuilder::buildStmt(Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            buildExpr(static_cast<ExpressionStmt*>(stmt)->expression.get());
+            break;
+        case StmtType::Let:
+            buildLetStmt(static_cast<LetStmt*>(stmt));
+            break;
+        case StmtType::Function:
+            buildFunctionStmt(static_cast<FunctionStmt*>(stmt));
+            break;
+        case StmtType::If:
+            buildIfStmt(static_cast<IfStmt*>(stmt));
+            break;
+        case StmtType::While:
+            buildWhileStmt(static_cast<WhileStmt*>(stmt));
+            break;
+        case StmtType::Return:
+            buildReturnStmt(static_cast<ReturnStmt*>(stmt));
+            break;
+        case StmtType::Print:
+            emit(SSAOp::PRINT, {buildExpr(static_cast<PrintStmt*>(stmt)->expression.get())});
+            break;
+        case StmtType::Block:
+            buildBlockStmt(static_cast<BlockStmt*>(stmt));
+            break;
+    }
+}
+
+void SSABuilder::buildLetStmt(LetStmt* stmt) {
+    uint32_t value = buildExpr(stmt->initializer.get());
+
+    if (m_state.scopeDepth == 0) {
+        emit(SSAOp::SET_GLOBAL, {value}, defineGlobal(stmt->name.lexeme()));
+        return;
+    }
+    writeVariable(declareLocal(stmt->name.lexeme()), m_state.current, value);
+}
+
+void SSABuilder::buildFunctionStmt(FunctionStmt* stmt) {
+    auto nested = std::make_unique<SSAFunction>();
+    nested->name = std::string(stmt->name.lexeme());
+    nested->arity = static_cast<uint8_t>(stmt->params.size());
+
+    // Build the body with a fresh set of locals
+    FunctionState enclosing = std::move(m_state);
+    m_state = FunctionState();
+    m_state.function = nested.get();
+    m_state.current = newBlock();
+    sealBlock(m_state.current);
+
+    // Slot 0 holds the callee, so the function can refer to itself by name
+    writeVariable(declareLocal(nested->name), m_state.current, emit(SSAOp::PARAM, {}, 0));
+
+    beginScope();
+    for (size_t i = 0; i < stmt->params.size(); i++) {
+        uint32_t param = emit(SSAOp::PARAM, {}, static_cast<uint32_t>(i + 1));
+        writeVariable(declareLocal(stmt->params[i].lexeme()), m_state.current, param);
+    }
+    for (const auto& s : stmt->body) {
+        buildStmt(s.get());
+    }
+    if (!terminated()) {
+        emit(SSAOp::RETURN, {emitConstant(Value())});
+    }
+    finishFunction();
+
+    m_state = std::move(enclosing);
+
+    SSAFunction& function = *m_state.function;
+    uint32_t index = static_cast<uint32_t>(function.functions.size());
+    function.functions.push_back(std::move(nested));
+    uint32_t value = emit(SSAOp::FUNCTION, {}, index);
+
+    if (m_state.scopeDepth == 0) {
+        emit(SSAOp::SET_GLOBAL, {value}, defineGlobal(stmt->name.lexeme()));
+        return;
+    }
+    writeVariable(declareLocal(stmt->name.lexeme()), m_state.current, value);
+}
+
+void SSABuilder::buildIfStmt(IfStmt* stmt) {
+    uint32_t condition = buildExpr(stmt->condition.get());
+
+    uint32_t thenBlock = newBlock();
+    uint32_t elseBlock = stmt->elseBranch ? newBlock() : 0;
+    uint32_t merge = newBlock();
+    emitBranch(condition, thenBlock, stmt->elseBranch ? elseBlock : merge);
+    sealBlock(thenBlock);
+
+    m_state.current = thenBlock;
+    buildStmt(stmt->thenBranch.get());
+    emitJump(merge);
+
+    if (stmt->elseBranch) {
+        sealBlock(elseBlock);
+        m_state.current = elseBlock;
+        buildStmt(stmt->elseBranch.get());
+        emitJump(merge);
+    }
+
+    sealBlock(merge);
+    m_state.current = merge;
+}
+
+void SSABuilder::buildWhileStmt(WhileStmt* stmt) {
+    // The header stays unsealed until the back-edge exists
+    uint32_t header = newBlock();
+    emitJump(header);
+    m_state.current = header;
+
+    uint32_t condition = buildExpr(stmt->condition.get());
+    uint32_t body = newBlock();
+    uint32_t exit = newBlock();
+    emitBranch(condition, body, exit);
+    sealBlock(body);
+
+    m_state.current = body;
+    buildStmt(stmt->body.get());
+    emitJump(header);
+    sealBlock(header);
+
+    sealBlock(exit);
+    m_state.current = exit;
+}
+
+void SSABuilder::buildReturnStmt(ReturnStmt* stmt) {
+    emit(SSAOp::RETURN, {buildExpr(stmt->value.get())});
+    startUnreachable();
+}
+
+void SSABuilder::buildBlockStmt(BlockStmt* stmt) {
+    beginScope();
+    for (const auto& s : stmt->statements) {
+        buildStmt(s.get());
+    }
+    endScope();
+}
+
+void SSABuilder::finishFunction() {
+    SSAFunction& function = *m_state.function;
+    removeUnreachableBlocks(function);
+    removeTrivialPhis(function);
+    inferTypes(function);
+}
+
+void SSABuilder::error(const std::string& message) {
+    m_hadError = true;
+    m_error = message;
+}
+
+} // namespace minilang
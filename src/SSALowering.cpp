@@ -0,0 +1,700 @@
+#include "SSALowering.hpp"
+#include <algorithm>
+#include <format>
+#include <unordered_map>
+
+namespace minilang {
+
+namespace {
+
+constexpr uint32_t NONE = UINT32_MAX;
+constexpr uint32_t STACK_TEMP = UINT32_MAX - 1; // Parallel-copy value parked on the operand stack
+
+// Rematerialized at every use instead of living in a slot
+bool isRemat(SSAOp op) {
+    return op == SSAOp::CONST || op == SSAOp::FUNCTION;
+}
+
+/**
+ * Dense bit set over the slotted values of one function
+ */
+class BitSet {
+public:
+    explicit BitSet(size_t size = 0) : m_words((size + 63) / 64, 0) {}
+
+    void set(size_t i) { m_words[i / 64] |= uint64_t{1} << (i % 64); }
+    void reset(size_t i) { m_words[i / 64] &= ~(uint64_t{1} << (i % 64)); }
+    bool test(size_t i) const { return m_words[i / 64] >> (i % 64) & 1; }
+
+    // Returns whether any bit was added
+    bool merge(const BitSet& other) {
+        bool changed = false;
+        for (size_t w = 0; w < m_words.size(); w++) {
+            uint64_t merged = m_words[w] | other.m_words[w];
+            changed |= merged != m_words[w];
+            m_words[w] = merged;
+        }
+        return changed;
+    }
+
+    bool intersects(const BitSet& other) const {
+        for (size_t w = 0; w < m_words.size(); w++) {
+            if (m_words[w] & other.m_words[w]) return true;
+        }
+        return false;
+    }
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t w = 0; w < m_words.size(); w++) {
+            for (uint64_t bits = m_words[w]; bits != 0; bits &= bits - 1) {
+                fn(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            }
+        }
+    }
+
+    bool operator==(const BitSet& other) const { return m_words == other.m_words; }
+
+private:
+    std::vector<uint64_t> m_words;
+};
+
+/**
+ * Lowering state of one function
+ */
+class FunctionLowering {
+public:
+    FunctionLowering(const SSAFunction& function, const std::vector<ObjFunction*>& functions, Chunk& chunk)
+        : m_fn(function), m_functions(functions), m_chunk(chunk) {}
+
+    // Returns an error message, or an empty string on success
+    std::string run() {
+        layout();
+        selectStackValues();
+        allocateSlots();
+        if (m_slotCount > LOCALS_MAX) {
+            return "Too many local variables in function.";
+        }
+        emit();
+        m_chunk.localCount = m_slotCount;
+        return m_error;
+    }
+
+private:
+    const SSAFunction& m_fn;
+    const std::vector<ObjFunction*>& m_functions;
+    Chunk& m_chunk;
+    std::string m_error;
+
+    std::vector<uint32_t> m_layout;              // Blocks in emission order
+    std::vector<uint32_t> m_position;            // Block -> index in m_layout
+    std::vector<uint32_t> m_uses;
+    std::vector<uint32_t> m_user;                // The user of each single-use value
+    std::vector<bool> m_inlined;                 // Evaluated on the stack inside its user
+    std::vector<std::vector<uint32_t>> m_roots;  // Per block, instructions emitted in place
+
+    std::vector<uint32_t> m_dense;               // Value -> index among slotted values
+    std::vector<uint32_t> m_slotted;             // Index -> value
+    std::vector<uint32_t> m_slot;                // Value -> frame slot
+    size_t m_slotCount = 0;
+
+    std::vector<size_t> m_blockStart;
+    std::vector<std::pair<size_t, uint32_t>> m_jumps;  // Forward jump -> target block
+    std::vector<std::pair<size_t, uint32_t>> m_stubs;  // Conditional jump to an earlier block
+
+    const SSAInstr& value(uint32_t id) const { return m_fn.values[id]; }
+    bool slotted(uint32_t id) const { return m_dense[id] != NONE; }
+
+    void layout() {
+        m_layout = reversePostorder(m_fn);
+        m_position.assign(m_fn.blocks.size(), NONE);
+        for (size_t i = 0; i < m_layout.size(); i++) {
+            m_position[m_layout[i]] = static_cast<uint32_t>(i);
+        }
+
+        m_uses.assign(m_fn.values.size(), 0);
+        m_user.assign(m_fn.values.size(), NONE);
+        for (uint32_t block : m_layout) {
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                for (uint32_t operand : value(id).operands) {
+                    m_uses[operand]++;
+                    m_user[operand] = id;
+                }
+            }
+        }
+    }
+
+    // Never emitted: rematerialized, defined on entry, or unused and pure
+    bool emittedInPlace(uint32_t id) const {
+        const SSAInstr& instr = value(id);
+        if (instr.op == SSAOp::PHI || instr.op == SSAOp::PARAM || isRemat(instr.op)) return false;
+        return !(hasResult(instr.op) && m_uses[id] == 0 && isPure(instr.op));
+    }
+
+    bool stackCandidate(uint32_t id) const {
+        const SSAInstr& instr = value(id);
+        if (!hasResult(instr.op) || !emittedInPlace(id) || m_uses[id] != 1) return false;
+        const SSAInstr& user = value(m_user[id]);
+        return user.op != SSAOp::PHI && user.block == instr.block;
+    }
+
+    /**
+     * Decide which values stay on the operand stack. Walking a block in
+     * order, single-use values are pushed on a model stack; a user that
+     * finds its stack operands on top, in operand order, consumes them.
+     * Anything else (or anything below an instruction emitted in place)
+     * is stored to a slot where it is defined, so evaluation order and
+     * side effects never move.
+     */
+    void selectStackValues() {
+        m_inlined.assign(m_fn.values.size(), false);
+        m_roots.assign(m_fn.blocks.size(), {});
+
+        for (uint32_t block : m_layout) {
+            std::vector<uint32_t> pending;
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                if (!emittedInPlace(id)) continue;
+
+                std::vector<uint32_t> stacked;
+                for (uint32_t operand : value(id).operands) {
+                    if (stackCandidate(operand)) stacked.push_back(operand);
+                }
+                if (stacked.size() <= pending.size() &&
+                    std::equal(stacked.begin(), stacked.end(), pending.end() - static_cast<std::ptrdiff_t>(stacked.size()))) {
+                    pending.resize(pending.size() - stacked.size());
+                    for (uint32_t operand : stacked) m_inlined[operand] = true;
+                } else {
+                    pending.clear();
+                }
+
+                if (stackCandidate(id)) {
+                    pending.push_back(id);
+                } else {
+                    pending.clear();
+                }
+            }
+
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                if (emittedInPlace(id) && !m_inlined[id]) m_roots[block].push_back(id);
+            }
+        }
+    }
+
+    // Slotted values read while evaluating a root
+    template <typename Fn>
+    void treeUses(uint32_t id, Fn fn) const {
+        for (uint32_t operand : value(id).operands) {
+            if (m_inlined[operand]) {
+                treeUses(operand, fn);
+            } else if (slotted(operand)) {
+                fn(operand);
+            }
+        }
+    }
+
+    size_t predIndex(uint32_t block, uint32_t pred) const {
+        const std::vector<uint32_t>& preds = m_fn.blocks[block].preds;
+        return static_cast<size_t>(std::find(preds.begin(), preds.end(), pred) - preds.begin());
+    }
+
+    std::vector<uint32_t> phis(uint32_t block) const {
+        std::vector<uint32_t> result;
+        for (uint32_t id : m_fn.blocks[block].instrs) {
+            if (value(id).op != SSAOp::PHI) break;
+            if (slotted(id)) result.push_back(id);
+        }
+        return result;
+    }
+
+    void allocateSlots() {
+        // Values that need a slot, in layout order
+        m_dense.assign(m_fn.values.size(), NONE);
+        for (uint32_t block : m_layout) {
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                const SSAInstr& instr = value(id);
+                bool needsSlot = instr.op == SSAOp::PARAM || (instr.op == SSAOp::PHI && m_uses[id] > 0) ||
+                                 (emittedInPlace(id) && !m_inlined[id] && hasResult(instr.op) && m_uses[id] > 0);
+                if (needsSlot) {
+                    m_dense[id] = static_cast<uint32_t>(m_slotted.size());
+                    m_slotted.push_back(id);
+                }
+            }
+        }
+        const size_t count = m_slotted.size();
+
+        // Liveness; phi operands are live out of the matching predecessor
+        const size_t blockCount = m_fn.blocks.size();
+        std::vector<BitSet> gen(blockCount, BitSet(count));
+        std::vector<BitSet> kill(blockCount, BitSet(count));
+        std::vector<BitSet> liveIn(blockCount, BitSet(count));
+        std::vector<BitSet> liveOut(blockCount, BitSet(count));
+        for (uint32_t block : m_layout) {
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                if (slotted(id)) kill[block].set(m_dense[id]);
+            }
+            for (uint32_t root : m_roots[block]) {
+                treeUses(root, [&](uint32_t use) {
+                    if (value(use).block != block) gen[block].set(m_dense[use]);
+                });
+            }
+        }
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto it = m_layout.rbegin(); it != m_layout.rend(); ++it) {
+                uint32_t block = *it;
+                BitSet out(count);
+                for (uint32_t succ : m_fn.successors(block)) {
+                    out.merge(liveIn[succ]);
+                    size_t pred = predIndex(succ, block);
+                    for (uint32_t phi : phis(succ)) {
+                        uint32_t operand = value(phi).operands[pred];
+                        if (slotted(operand)) out.set(m_dense[operand]);
+                    }
+                }
+
+                BitSet in = gen[block];
+                out.forEach([&](size_t v) {
+                    if (!kill[block].test(v)) in.set(v);
+                });
+                changed |= !(out == liveOut[block]) || !(in == liveIn[block]);
+                liveOut[block] = std::move(out);
+                liveIn[block] = std::move(in);
+            }
+        }
+
+        // Interference: a definition conflicts with everything live across it
+        std::vector<BitSet> interferes(count, BitSet(count));
+        auto conflict = [&](size_t a, size_t b) {
+            if (a == b) return;
+            interferes[a].set(b);
+            interferes[b].set(a);
+        };
+
+        for (uint32_t block : m_layout) {
+            BitSet live = liveOut[block];
+            for (auto it = m_roots[block].rbegin(); it != m_roots[block].rend(); ++it) {
+                if (slotted(*it)) {
+                    size_t def = m_dense[*it];
+                    live.forEach([&](size_t v) { conflict(def, v); });
+                    live.reset(def);
+                }
+                treeUses(*it, [&](uint32_t use) { live.set(m_dense[use]); });
+            }
+
+            // Phis and parameters are all defined together on entry
+            std::vector<size_t> entryDefs;
+            for (uint32_t id : m_fn.blocks[block].instrs) {
+                SSAOp op = value(id).op;
+                if ((op == SSAOp::PHI || op == SSAOp::PARAM) && slotted(id)) entryDefs.push_back(m_dense[id]);
+            }
+            for (size_t def : entryDefs) live.set(def);
+            for (size_t def : entryDefs) {
+                live.forEach([&](size_t v) { conflict(def, v); });
+            }
+        }
+
+        // Coalesce phis with their operands so most moves disappear
+        std::vector<uint32_t> parent(count);
+        std::vector<uint32_t> precolor(count, NONE);
+        std::vector<BitSet> members(count, BitSet(count));
+        for (size_t v = 0; v < count; v++) {
+            parent[v] = static_cast<uint32_t>(v);
+            members[v].set(v);
+            const SSAInstr& instr = value(m_slotted[v]);
+            if (instr.op == SSAOp::PARAM) precolor[v] = instr.index;
+        }
+        auto find = [&](uint32_t v) {
+            while (parent[v] != v) v = parent[v] = parent[parent[v]];
+            return v;
+        };
+
+        for (uint32_t block : m_layout) {
+            for (uint32_t phi : phis(block)) {
+                for (uint32_t operand : value(phi).operands) {
+                    if (!slotted(operand)) continue;
+                    uint32_t a = find(m_dense[phi]);
+                    uint32_t b = find(m_dense[operand]);
+                    if (a == b || (precolor[a] != NONE && precolor[b] != NONE)) continue;
+                    if (interferes[a].intersects(members[b])) continue;
+
+                    parent[b] = a;
+                    interferes[a].merge(interferes[b]);
+                    members[a].merge(members[b]);
+                    if (precolor[a] == NONE) precolor[a] = precolor[b];
+                }
+            }
+        }
+
+        // Greedy coloring in layout order; slot 0 always keeps the callee
+        std::vector<uint32_t> color(count, NONE);
+        for (size_t v = 0; v < count; v++) {
+            if (find(static_cast<uint32_t>(v)) == v && precolor[v] != NONE) color[v] = precolor[v];
+        }
+
+        m_slotCount = static_cast<size_t>(m_fn.arity) + 1;
+        std::vector<bool> taken;
+        for (size_t v = 0; v < count; v++) {
+            uint32_t root = find(static_cast<uint32_t>(v));
+            if (color[root] == NONE) {
+                taken.assign(m_slotCount + 1, false);
+                interferes[root].forEach([&](size_t other) {
+                    uint32_t slot = color[find(static_cast<uint32_t>(other))];
+                    if (slot != NONE && slot < taken.size()) taken[slot] = true;
+                });
+                uint32_t slot = 1;
+                while (taken[slot]) slot++;
+                color[root] = slot;
+            }
+            m_slotCount = std::max(m_slotCount, static_cast<size_t>(color[root]) + 1);
+        }
+
+        m_slot.assign(m_fn.values.size(), NONE);
+        for (size_t v = 0; v < count; v++) {
+            m_slot[m_slotted[v]] = color[find(static_cast<uint32_t>(v))];
+        }
+    }
+
+    // Emission helpers
+    size_t write(OpCode op, uint32_t operand = 0) {
+        m_chunk.write(op, 0, operand);
+        return m_chunk.code.size() - 1;
+    }
+
+    uint32_t constantIndex(Value constant) {
+        // Reuse an identical number or string already in the pool
+        for (size_t i = 0; i < m_chunk.constants.size(); i++) {
+            const Value& existing = m_chunk.constants[i];
+            if (existing.sameBits(constant) ||
+                (existing.isString() && constant.isString() && existing.asString() == constant.asString())) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        if (m_chunk.constants.size() > OPERAND_MAX) {
+            m_error = "Too many constants in one chunk.";
+            return 0;
+        }
+        return static_cast<uint32_t>(m_chunk.addConstant(constant));
+    }
+
+    void emitOperand(uint32_t id) {
+        const SSAInstr& instr = value(id);
+        if (m_inlined[id]) {
+            emitValue(id);
+        } else if (instr.op == SSAOp::CONST) {
+            Value constant = m_fn.constants[instr.index];
+            if (constant.isNil()) {
+                write(OpCode::OP_NIL);
+            } else if (constant.isBool()) {
+                write(constant.asBool() ? OpCode::OP_TRUE : OpCode::OP_FALSE);
+            } else {
+                write(OpCode::OP_CONSTANT, constantIndex(constant));
+            }
+        } else if (instr.op == SSAOp::FUNCTION) {
+            write(OpCode::OP_CONSTANT, constantIndex(Value(m_functions[instr.index])));
+        } else {
+            write(OpCode::OP_GET_LOCAL, m_slot[id]);
+        }
+    }
+
+    // `slot + number` and `global + number` in one instruction, as IRGenerator does
+    bool emitAddConstant(const SSAInstr& instr) {
+        const SSAInstr& left = value(instr.operands[0]);
+        const SSAInstr& right = value(instr.operands[1]);
+        if (right.op != SSAOp::CONST || !m_fn.constants[right.index].isNumber()) return false;
+        // The fused form reports a bad operand with ADD's message
+        if (instr.op == SSAOp::SUB && left.type != SSAType::NUMBER) return false;
+
+        OpCode op;
+        uint32_t slot;
+        if (m_inlined[instr.operands[0]] && left.op == SSAOp::GET_GLOBAL) {
+            op = OpCode::OP_ADD_GLOBAL_CONSTANT;
+            slot = left.index;
+        } else if (slotted(instr.operands[0])) {
+            op = OpCode::OP_ADD_LOCAL_CONSTANT;
+            slot = m_slot[instr.operands[0]];
+        } else {
+            return false;
+        }
+
+        // x - k is exactly x + (-k) in IEEE arithmetic
+        double constant = m_fn.constants[right.index].asNumber();
+        if (instr.op == SSAOp::SUB) constant = -constant;
+
+        uint32_t index = constantIndex(Value(constant));
+        if (slot > PAIR_OPERAND_MAX || index > PAIR_OPERAND_MAX) return false;
+        write(op, slot | index << PAIR_OPERAND_BITS);
+        return true;
+    }
+
+    void emitValue(uint32_t id) {
+        const SSAInstr& instr = value(id);
+        OpCode op;
+        switch (instr.op) {
+            case SSAOp::GET_GLOBAL:
+                write(OpCode::OP_GET_GLOBAL, instr.index);
+                return;
+            case SSAOp::CALL:
+                for (uint32_t operand : instr.operands) emitOperand(operand);
+                write(OpCode::OP_CALL, instr.index);
+                return;
+            case SSAOp::NEG:
+                emitOperand(instr.operands[0]);
+                write(OpCode::OP_NEGATE);
+                return;
+            case SSAOp::NOT:
+                emitOperand(instr.operands[0]);
+                write(OpCode::OP_NOT);
+                return;
+            case SSAOp::ADD:
+            case SSAOp::SUB:
+                if (emitAddConstant(instr)) return;
+                op = instr.op == SSAOp::ADD ? OpCode::OP_ADD : OpCode::OP_SUBTRACT;
+                break;
+            case SSAOp::MUL: op = OpCode::OP_MULTIPLY; break;
+            case SSAOp::DIV: op = OpCode::OP_DIVIDE; break;
+            case SSAOp::MOD: op = OpCode::OP_MODULO; break;
+            case SSAOp::EQ: op = OpCode::OP_EQUAL; break;
+            case SSAOp::NE: op = OpCode::OP_NOT_EQUAL; break;
+            case SSAOp::LT: op = OpCode::OP_LESS; break;
+            case SSAOp::LE: op = OpCode::OP_LESS_EQUAL; break;
+            case SSAOp::GT: op = OpCode::OP_GREATER; break;
+            case SSAOp::GE: op = OpCode::OP_GREATER_EQUAL; break;
+            case SSAOp::AND: op = OpCode::OP_AND; break;
+            case SSAOp::OR: op = OpCode::OP_OR; break;
+            default:
+                emitOperand(id);
+                return;
+        }
+        emitOperand(instr.operands[0]);
+        emitOperand(instr.operands[1]);
+        write(op);
+    }
+
+    void emitRoot(uint32_t id) {
+        const SSAInstr& instr = value(id);
+        if (instr.op == SSAOp::PRINT) {
+            emitOperand(instr.operands[0]);
+            write(OpCode::OP_PRINT);
+            return;
+        }
+        if (instr.op == SSAOp::SET_GLOBAL) {
+            emitOperand(instr.operands[0]);
+            write(OpCode::OP_SET_GLOBAL_POP, instr.index);
+            return;
+        }
+
+        emitValue(id);
+        if (slotted(id)) {
+            write(OpCode::OP_SET_LOCAL_POP, m_slot[id]);
+        } else {
+            write(OpCode::OP_POP);
+        }
+    }
+
+    /**
+     * Phi moves on the edge into `succ`, as one parallel copy: slot-to-slot
+     * moves are ordered so nothing is overwritten before it is read, and
+     * each cycle parks one value on the operand stack
+     */
+    void emitCopies(uint32_t block, uint32_t succ) {
+        size_t pred = predIndex(succ, block);
+        std::vector<std::pair<uint32_t, uint32_t>> moves;     // dst slot <- src slot
+        std::vector<std::pair<uint32_t, uint32_t>> constants; // dst slot <- rematerialized value
+        for (uint32_t phi : phis(succ)) {
+            uint32_t operand = value(phi).operands[pred];
+            if (isRemat(value(operand).op)) {
+                constants.push_back({m_slot[phi], operand});
+            } else if (m_slot[operand] != m_slot[phi]) {
+                moves.push_back({m_slot[phi], m_slot[operand]});
+            }
+        }
+
+        std::unordered_map<uint32_t, uint32_t> location; // Original slot -> where its value is now
+        std::unordered_map<uint32_t, uint32_t> source;   // dst -> src
+        std::vector<uint32_t> ready;
+        std::vector<uint32_t> todo;
+        for (const auto& [dst, src] : moves) {
+            location[src] = src;
+            source[dst] = src;
+            todo.push_back(dst);
+        }
+        for (const auto& [dst, src] : moves) {
+            if (!location.contains(dst)) ready.push_back(dst);
+        }
+
+        while (!todo.empty()) {
+            while (!ready.empty()) {
+                uint32_t dst = ready.back();
+                ready.pop_back();
+                uint32_t src = source[dst];
+                uint32_t from = location[src];
+                if (from != STACK_TEMP) write(OpCode::OP_GET_LOCAL, from);
+                write(OpCode::OP_SET_LOCAL_POP, dst);
+                location[src] = dst;
+                if (from == src && source.contains(src)) ready.push_back(src);
+            }
+
+            uint32_t dst = todo.back();
+            todo.pop_back();
+            if (location[source[dst]] != dst) {
+                // Part of a cycle: free dst by parking its value
+                write(OpCode::OP_GET_LOCAL, dst);
+                location[dst] = STACK_TEMP;
+                ready.push_back(dst);
+            }
+        }
+
+        for (const auto& [dst, operand] : constants) {
+            emitOperand(operand);
+            write(OpCode::OP_SET_LOCAL_POP, dst);
+        }
+    }
+
+    void emitJumpTo(uint32_t target, size_t position) {
+        if (position + 1 < m_layout.size() && m_layout[position + 1] == target) return;
+
+        if (m_position[target] <= position) {
+            // The VM has already stepped past OP_LOOP when it applies the offset
+            size_t offset = m_chunk.code.size() + 1 - m_blockStart[target];
+            if (offset > OPERAND_MAX) m_error = "Loop body too large.";
+            write(OpCode::OP_LOOP, static_cast<uint32_t>(offset));
+            return;
+        }
+        m_jumps.push_back({write(OpCode::OP_JUMP, OPERAND_MAX), target});
+    }
+
+    void emitConditionalJump(OpCode op, uint32_t target, size_t position) {
+        size_t jump = write(op, OPERAND_MAX);
+        if (m_position[target] <= position) {
+            m_stubs.push_back({jump, target});
+        } else {
+            m_jumps.push_back({jump, target});
+        }
+    }
+
+    void emitTerminator(uint32_t block, size_t position, uint32_t id) {
+        const SSAInstr& instr = value(id);
+        switch (instr.op) {
+            case SSAOp::RETURN:
+                emitOperand(instr.operands[0]);
+                write(OpCode::OP_RETURN);
+                return;
+
+            case SSAOp::JUMP:
+                emitCopies(block, instr.targets[0]);
+                emitJumpTo(instr.targets[0], position);
+                return;
+
+            case SSAOp::BRANCH: {
+                uint32_t ifTrue = instr.targets[0];
+                uint32_t ifFalse = instr.targets[1];
+                uint32_t condition = instr.operands[0];
+                const SSAInstr& compare = value(condition);
+
+                // Relational conditions compare and branch in a single instruction
+                OpCode jump = OpCode::OP_POP_JUMP_IF_FALSE;
+                if (m_inlined[condition]) {
+                    switch (compare.op) {
+                        case SSAOp::LT: jump = OpCode::OP_JUMP_IF_NOT_LESS; break;
+                        case SSAOp::LE: jump = OpCode::OP_JUMP_IF_NOT_LESS_EQUAL; break;
+                        case SSAOp::GT: jump = OpCode::OP_JUMP_IF_NOT_GREATER; break;
+                        case SSAOp::GE: jump = OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL; break;
+                        default: break;
+                    }
+                }
+                if (jump != OpCode::OP_POP_JUMP_IF_FALSE) {
+                    emitOperand(compare.operands[0]);
+                    emitOperand(compare.operands[1]);
+                } else {
+                    emitOperand(condition);
+                }
+
+                bool fallsToFalse = position + 1 < m_layout.size() && m_layout[position + 1] == ifFalse;
+                if (jump == OpCode::OP_POP_JUMP_IF_FALSE && fallsToFalse && ifTrue != ifFalse) {
+                    emitConditionalJump(OpCode::OP_POP_JUMP_IF_TRUE, ifTrue, position);
+                    return;
+                }
+                emitConditionalJump(jump, ifFalse, position);
+                emitJumpTo(ifTrue, position);
+                return;
+            }
+
+            default:
+                return;
+        }
+    }
+
+    void emit() {
+        // Reserve the frame slots past the arguments
+        for (size_t slot = static_cast<size_t>(m_fn.arity) + 1; slot < m_slotCount; slot++) {
+            write(OpCode::OP_NIL);
+        }
+
+        m_blockStart.assign(m_fn.blocks.size(), 0);
+        for (size_t position = 0; position < m_layout.size(); position++) {
+            uint32_t block = m_layout[position];
+            m_blockStart[block] = m_chunk.code.size();
+            for (uint32_t root : m_roots[block]) {
+                if (isTerminator(value(root).op)) {
+                    emitTerminator(block, position, root);
+                } else {
+                    emitRoot(root);
+                }
+            }
+        }
+
+        // Conditional jumps only go forward; backward ones bounce off a trailing OP_LOOP
+        for (const auto& [jump, target] : m_stubs) {
+            size_t stub = m_chunk.code.size();
+            m_chunk.code[jump].operand = static_cast<uint32_t>(stub - (jump + 1));
+            size_t offset = stub + 1 - m_blockStart[target];
+            if (offset > OPERAND_MAX) m_error = "Loop body too large.";
+            write(OpCode::OP_LOOP, static_cast<uint32_t>(offset));
+        }
+
+        for (const auto& [jump, target] : m_jumps) {
+            size_t offset = m_blockStart[target] - (jump + 1);
+            if (offset > OPERAND_MAX) {
+                m_error = "Jump too far.";
+                continue;
+            }
+            m_chunk.code[jump].operand = static_cast<uint32_t>(offset);
+        }
+    }
+};
+
+} // namespace
+
+Chunk SSALowering::lower(SSAFunction& function) {
+    // Nested functions first, so their objects exist as constants
+    std::vector<ObjFunction*> functions;
+    for (const auto& nested : function.functions) {
+        auto* object = m_heap.allocate<ObjFunction>();
+        object->name = nested->name;
+        object->arity = nested->arity;
+        object->chunk = lower(*nested);
+        functions.push_back(object);
+    }
+
+    splitCriticalEdges(function);
+
+    Chunk chunk;
+    FunctionLowering lowering(function, functions, chunk);
+    std::string problem = lowering.run();
+    if (!problem.empty()) {
+        error(problem);
+        return chunk;
+    }
+
+    m_peephole.optimize(chunk);
+    chunk.stackMax = stackHeight(chunk, static_cast<size_t>(function.arity) + 1);
+    return chunk;
+}
+
+void SSALowering::error(const std::string& message) {
+    m_hadError = true;
+    m_error = message;
+}
+
+} // namespace minilang
@@ -0,0 +1,98 @@
+#include "SourceFile.hpp"
+#include <format>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MINILANG_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MINILANG_MMAP 0
+#endif
+
+namespace minilang {
+
+SourceFile::~SourceFile() {
+    close();
+}
+
+bool SourceFile::error(const std::string& message) {
+    m_error = message;
+    return false;
+}
+
+void SourceFile::close() {
+#if MINILANG_MMAP
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+#endif
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+    m_buffer.clear();
+    m_text = {};
+}
+
+bool SourceFile::open(const std::string& path) {
+    close();
+    m_error.clear();
+
+#if MINILANG_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return error(std::format("Could not open file '{}'", path));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return error(std::format("Could not read file '{}'", path));
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        ::close(fd);
+        return error(std::format("Could not read file '{}': Is a directory", path));
+    }
+
+    // Pipes and other special files have no size to map; read them instead.
+    // An empty file cannot be mapped and needs no memory either.
+    if (S_ISREG(info.st_mode)) {
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return error(std::format("Could not map file '{}'", path));
+        }
+
+        if (mapping) {
+            // The lexer reads the text once, front to back
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            m_mapping = mapping;
+            m_mappingSize = size;
+            m_text = std::string_view(static_cast<const char*>(mapping), size);
+        }
+        return true;
+    }
+    ::close(fd);
+#endif
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return error(std::format("Could not open file '{}'", path));
+    }
+
+    // Reading a directory or a failing device throws from inside the iterator
+    try {
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } catch (const std::ios_base::failure&) {
+        m_buffer.clear();
+        return error(std::format("Could not read file '{}'", path));
+    }
+    m_text = m_buffer;
+    return true;
+}
+
+} // namespace minilang
@@ -0,0 +1,436 @@
+#include "TypeInference.hpp"
+#include "IRGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace minilang {
+
+// Strip redundant parentheses
+static const Expr* unwrap(const Expr* expr) {
+    while (expr && expr->getType() == ExprType::Grouping) {
+        expr = static_cast<const GroupingExpr*>(expr)->expression.get();
+    }
+    return expr;
+}
+
+// Whether evaluating an expression may write a variable
+static bool hasWrites(const Expr* expr) {
+    if (!expr) return false;
+
+    switch (expr->getType()) {
+        case ExprType::Assignment:
+        case ExprType::Call:
+            return true;
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            return hasWrites(binary->left.get()) || hasWrites(binary->right.get());
+        }
+        case ExprType::Unary:
+            return hasWrites(static_cast<const UnaryExpr*>(expr)->right.get());
+        case ExprType::Grouping:
+            return hasWrites(static_cast<const GroupingExpr*>(expr)->expression.get());
+        default:
+            return false;
+    }
+}
+
+// Number types of +, -, * and %: integral unless an operand may have a fraction
+static TypeSet arithmeticResult(TypeSet left, TypeSet right) {
+    return ((left | right) & TYPE_FRACTIONAL) ? TYPE_NUMBER : TYPE_INTEGER;
+}
+
+// Types the other operand of a successful + can have: numbers or strings, like this one
+static TypeSet addable(TypeSet operand) {
+    return ((operand & TYPE_NUMBER) ? TYPE_NUMBER : 0) | (operand & TYPE_STRING);
+}
+
+bool TypeInference::State::operator==(const State& other) const {
+    if (locals.size() != other.locals.size() || globals != other.globals) return false;
+    for (size_t i = 0; i < locals.size(); i++) {
+        if (locals[i].type != other.locals[i].type) return false;
+    }
+    return true;
+}
+
+void TypeInference::infer(const Program& program, const GlobalTable& globals) {
+    clear();
+
+    // Functions from earlier compilations may assign any global they could see
+    for (const auto& [name, slot] : globals.slots) {
+        if (globals.defined[slot]) m_clobbered.insert(name);
+    }
+    for (const auto& stmt : program) {
+        collectClobbered(stmt.get(), false);
+    }
+
+    visitStmts(program);
+}
+
+void TypeInference::clear() {
+    m_types.clear();
+    m_clobbered.clear();
+    m_state = State();
+    m_depth = 0;
+    m_trackGlobals = true;
+}
+
+TypeSet TypeInference::typeOf(const Expr* expr) const {
+    auto it = m_types.find(expr);
+    return it != m_types.end() ? it->second : TYPE_ANY;
+}
+
+void TypeInference::beginScope() {
+    m_depth++;
+}
+
+void TypeInference::endScope() {
+    m_depth--;
+
+    while (!m_state.locals.empty() && m_state.locals.back().depth > m_depth) {
+        m_state.locals.pop_back();
+    }
+}
+
+void TypeInference::declare(std::string_view name, TypeSet type) {
+    m_state.locals.push_back({name, m_depth, type});
+}
+
+TypeInference::Binding* TypeInference::resolve(std::string_view name) {
+    for (auto it = m_state.locals.rbegin(); it != m_state.locals.rend(); ++it) {
+        if (it->name == name) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+TypeSet TypeInference::load(std::string_view name) {
+    if (Binding* binding = resolve(name)) return binding->type;
+    if (!m_trackGlobals) return TYPE_ANY;
+
+    auto it = m_state.globals.find(name);
+    return it != m_state.globals.end() ? it->second : TYPE_ANY;
+}
+
+void TypeInference::store(std::string_view name, TypeSet type) {
+    if (Binding* binding = resolve(name)) {
+        binding->type = type;
+    } else if (m_trackGlobals) {
+        m_state.globals[name] = type;
+    }
+}
+
+void TypeInference::narrow(const Expr* operand, TypeSet type) {
+    operand = unwrap(operand);
+    if (!operand || operand->getType() != ExprType::Variable) return;
+
+    std::string_view name = static_cast<const VariableExpr*>(operand)->name.lexeme();
+    store(name, load(name) & type);
+}
+
+void TypeInference::join(const State& other) {
+    // Scopes match at every join point; statements cannot declare outside a block
+    size_t count = std::min(m_state.locals.size(), other.locals.size());
+    m_state.locals.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        m_state.locals[i].type |= other.locals[i].type;
+    }
+
+    // A global unknown on either side is unknown after the join
+    for (auto it = m_state.globals.begin(); it != m_state.globals.end();) {
+        auto theirs = other.globals.find(it->first);
+        if (theirs == other.globals.end()) {
+            it = m_state.globals.erase(it);
+            continue;
+        }
+        it->second |= theirs->second;
+        ++it;
+    }
+}
+
+void TypeInference::collectClobbered(const Stmt* stmt, bool inFunction) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            collectClobbered(static_cast<const ExpressionStmt*>(stmt)->expression.get(), inFunction);
+            break;
+        case StmtType::Let:
+            collectClobbered(static_cast<const LetStmt*>(stmt)->initializer.get(), inFunction);
+            break;
+        case StmtType::Function:
+            for (const auto& s : static_cast<const FunctionStmt*>(stmt)->body) {
+                collectClobbered(s.get(), true);
+            }
+            break;
+        case StmtType::If: {
+            auto* ifStmt = static_cast<const IfStmt*>(stmt);
+            collectClobbered(ifStmt->condition.get(), inFunction);
+            collectClobbered(ifStmt->thenBranch.get(), inFunction);
+            collectClobbered(ifStmt->elseBranch.get(), inFunction);
+            break;
+        }
+        case StmtType::While: {
+            auto* whileStmt = static_cast<const WhileStmt*>(stmt);
+            collectClobbered(whileStmt->condition.get(), inFunction);
+            collectClobbered(whileStmt->body.get(), inFunction);
+            break;
+        }
+        case StmtType::Return:
+            collectClobbered(static_cast<const ReturnStmt*>(stmt)->value.get(), inFunction);
+            break;
+        case StmtType::Print:
+            collectClobbered(static_cast<const PrintStmt*>(stmt)->expression.get(), inFunction);
+            break;
+        case StmtType::Block:
+            for (const auto& s : static_cast<const BlockStmt*>(stmt)->statements) {
+                collectClobbered(s.get(), inFunction);
+            }
+            break;
+    }
+}
+
+void TypeInference::collectClobbered(const Expr* expr, bool inFunction) {
+    if (!expr) return;
+
+    switch (expr->getType()) {
+        case ExprType::Assignment: {
+            auto* assign = static_cast<const AssignExpr*>(expr);
+            if (inFunction) m_clobbered.insert(assign->name.lexeme());
+            collectClobbered(assign->value.get(), inFunction);
+            break;
+        }
+        case ExprType::Binary: {
+            auto* binary = static_cast<const BinaryExpr*>(expr);
+            collectClobbered(binary->left.get(), inFunction);
+            collectClobbered(binary->right.get(), inFunction);
+            break;
+        }
+        case ExprType::Unary:
+            collectClobbered(static_cast<const UnaryExpr*>(expr)->right.get(), inFunction);
+            break;
+        case ExprType::Call: {
+            auto* call = static_cast<const CallExpr*>(expr);
+            collectClobbered(call->callee.get(), inFunction);
+            for (const auto& arg : call->arguments) {
+                collectClobbered(arg.get(), inFunction);
+            }
+            break;
+        }
+        case ExprType::Grouping:
+            collectClobbered(static_cast<const GroupingExpr*>(expr)->expression.get(), inFunction);
+            break;
+        default:
+            break;
+    }
+}
+
+void TypeInference::visitStmts(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+    for (const auto& stmt : stmts) {
+        visitStmt(stmt.get());
+    }
+}
+
+void TypeInference::visitStmt(const Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->getType()) {
+        case StmtType::Expression:
+            visitExpr(static_cast<const ExpressionStmt*>(stmt)->expression.get());
+            break;
+        case StmtType::Let: {
+            // The initializer sees the enclosing binding of the name
+            auto* let = static_cast<const LetStmt*>(stmt);
+            TypeSet type = let->initializer ? visitExpr(let->initializer.get()) : TYPE_NIL;
+            if (m_depth == 0) {
+                if (m_trackGlobals) m_state.globals[let->name.lexeme()] = type;
+            } else {
+                declare(let->name.lexeme(), type);
+            }
+            break;
+        }
+        case StmtType::Function: {
+            auto* function = static_cast<const FunctionStmt*>(stmt);
+            if (m_depth == 0) {
+                if (m_trackGlobals) m_state.globals[function->name.lexeme()] = TYPE_FUNCTION;
+            } else {
+                declare(function->name.lexeme(), TYPE_FUNCTION);
+            }
+            visitFunction(function);
+            break;
+        }
+        case StmtType::If: {
+            auto* ifStmt = static_cast<const IfStmt*>(stmt);
+            visitExpr(ifStmt->condition.get());
+
+            State otherwise = m_state;
+            visitStmt(ifStmt->thenBranch.get());
+            std::swap(m_state, otherwise);
+            visitStmt(ifStmt->elseBranch.get());
+            join(otherwise);
+            break;
+        }
+        case StmtType::While: {
+            // Iterate until the state at the loop header stops growing
+            auto* whileStmt = static_cast<const WhileStmt*>(stmt);
+            for (State header = m_state;;) {
+                visitExpr(whileStmt->condition.get());
+                visitStmt(whileStmt->body.get());
+                join(header);
+                if (m_state == header) break;
+                header = m_state;
+            }
+
+            // The loop exits after evaluating the condition once more
+            visitExpr(whileStmt->condition.get());
+            break;
+        }
+        case StmtType::Return:
+            // Code after a return only widens the state, which stays sound
+            visitExpr(static_cast<const ReturnStmt*>(stmt)->value.get());
+            break;
+        case StmtType::Print:
+            visitExpr(static_cast<const PrintStmt*>(stmt)->expression.get());
+            break;
+        case StmtType::Block:
+            beginScope();
+            visitStmts(static_cast<const BlockStmt*>(stmt)->statements);
+            endScope();
+            break;
+    }
+}
+
+void TypeInference::visitFunction(const FunctionStmt* stmt) {
+    // Functions do not capture: the body sees only its own locals and globals
+    State enclosing = std::move(m_state);
+    size_t enclosingDepth = m_depth;
+    bool enclosingTrack = m_trackGlobals;
+
+    m_state = State();
+    m_depth = 0;
+    m_trackGlobals = false;
+    declare(stmt->name.lexeme(), TYPE_ANY);
+
+    beginScope();
+    for (const Token& param : stmt->params) {
+        declare(param.lexeme(), TYPE_ANY);
+    }
+    visitStmts(stmt->body);
+
+    m_state = std::move(enclosing);
+    m_depth = enclosingDepth;
+    m_trackGlobals = enclosingTrack;
+}
+
+TypeSet TypeInference::visitExpr(const Expr* expr) {
+    if (!expr) return TYPE_NIL;
+
+    TypeSet type = TYPE_ANY;
+    switch (expr->getType()) {
+        case ExprType::Literal: {
+            const auto& value = static_cast<const LiteralExpr*>(expr)->value;
+            if (const double* number = std::get_if<double>(&value)) {
+                type = std::trunc(*number) == *number ? TYPE_INTEGER : TYPE_FRACTIONAL;
+            } else if (std::holds_alternative<std::string>(value)) {
+                type = TYPE_STRING;
+            } else if (std::holds_alternative<bool>(value)) {
+                type = TYPE_BOOL;
+            } else {
+                type = TYPE_NIL;
+            }
+            break;
+        }
+        case ExprType::Variable:
+            type = load(static_cast<const VariableExpr*>(expr)->name.lexeme());
+            break;
+        case ExprType::Assignment: {
+            auto* assign = static_cast<const AssignExpr*>(expr);
+            type = visitExpr(assign->value.get());
+            store(assign->name.lexeme(), type);
+            break;
+        }
+        case ExprType::Binary:
+            type = visitBinary(static_cast<const BinaryExpr*>(expr));
+            break;
+        case ExprType::Unary: {
+            auto* unary = static_cast<const UnaryExpr*>(expr);
+            if (unary->op.type == TokenType::MINUS) {
+                type = arithmeticResult(visitExpr(unary->right.get()), 0);
+                narrow(unary->right.get(), TYPE_NUMBER);
+            } else {
+                visitExpr(unary->right.get());
+                type = TYPE_BOOL;
+            }
+            break;
+        }
+        case ExprType::Call: {
+            auto* call = static_cast<const CallExpr*>(expr);
+            visitExpr(call->callee.get());
+            for (const auto& arg : call->arguments) {
+                visitExpr(arg.get());
+            }
+            std::erase_if(m_state.globals, [&](const auto& entry) { return m_clobbered.contains(entry.first); });
+            break;
+        }
+        case ExprType::Grouping:
+            type = visitExpr(static_cast<const GroupingExpr*>(expr)->expression.get());
+            break;
+    }
+
+    m_types[expr] |= type;
+    return type;
+}
+
+TypeSet TypeInference::visitBinary(const BinaryExpr* expr) {
+    TypeSet left = visitExpr(expr->left.get());
+    TypeSet right = visitExpr(expr->right.get());
+
+    // Types each operand must have for the operator to succeed
+    TypeSet required;
+    TypeSet result;
+    switch (expr->op.type) {
+        case TokenType::PLUS:
+            // Two numbers or two strings
+            result = left & right & TYPE_STRING;
+            if ((left & TYPE_NUMBER) && (right & TYPE_NUMBER)) result |= arithmeticResult(left, right);
+            narrow(expr->right.get(), addable(left));
+            if (!hasWrites(expr->right.get())) narrow(expr->left.get(), addable(right));
+            return result;
+
+        case TokenType::MINUS:
+        case TokenType::STAR:
+        case TokenType::PERCENT:
+            required = TYPE_NUMBER;
+            result = arithmeticResult(left, right);
+            break;
+
+        case TokenType::SLASH:
+            required = TYPE_NUMBER;
+            result = TYPE_NUMBER;
+            break;
+
+        case TokenType::LESS:
+        case TokenType::LESS_EQUAL:
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQUAL:
+            required = TYPE_NUMBER;
+            result = TYPE_BOOL;
+            break;
+
+        case TokenType::EQUAL_EQUAL:
+        case TokenType::BANG_EQUAL:
+        case TokenType::AND:
+        case TokenType::OR:
+            return TYPE_BOOL;
+
+        default:
+            return TYPE_ANY;
+    }
+
+    // The left variable still holds the value read unless the right operand wrote it
+    narrow(expr->right.get(), required);
+    if (!hasWrites(expr->right.get())) narrow(expr->left.get(), required);
+    return result;
+}
+
+} // namespace minilang
@@ -1,61 +1,137 @@
 #include "VM.hpp"
+#include <algorithm>
+#include <cmath>
 #include <format>
-#include <functional>
+#include <iterator>
 
 namespace minilang {
 
-VM::VM() {
-    // Pre-allocate stack for performance
-    // m_stack.reserve(256); // std::stack doesn't have reserve
+VM::VM() : m_stack(std::make_unique<Value[]>(STACK_MAX)) {
+    resetStack();
 }
 
+void VM::resetStack() {
+    m_stackTop = m_stack.get();
+    m_frameCount = 0;
+}
+
+// Labels-as-values is a GNU extension that -Wpedantic rejects, and the
+// fallback label is unused whenever every opcode has a table entry
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-label"
+
 InterpretResult VM::interpret(const Chunk& chunk) {
-    m_chunk = &chunk;
-    m_ip = 0;
     m_error.clear();
+    resetStack();
 
-    // Clear stack
-    while (!m_stack.empty()) {
-        m_stack.pop();
+    if (chunk.code.empty()) {
+        return InterpretResult::OK;
     }
 
-    for (;;) {
-        Instruction instruction = readInstruction();
+    if (!hasStackRoom(m_stack.get(), chunk)) {
+        runtimeError("Stack overflow.");
+        return InterpretResult::RUNTIME_ERROR;
+    }
+
+    // Slots declared by this and earlier compilations start out undefined
+    m_globals.resize(m_globalNames.size(), Value::undefined());
+    Value* globals = m_globals.data();
+
+    // Slot 0 of the script frame stands in for the callee
+    push(Value());
+    CallFrame* frame = &m_frames[m_frameCount++];
+    frame->chunk = &chunk;
+    frame->ip = chunk.code.data();
+    frame->slots = m_stack.get();
+
+    if (nativeReady(chunk)) {
+        runNative(frame);
+    }
+
+    Instruction* instruction;
+
+#if MINILANG_PROFILE_OPCODES
+#define VM_PROFILE() recordOpcode(instruction->opcode)
+#else
+#define VM_PROFILE() ((void)0)
+#endif
+
+#if MINILANG_COMPUTED_GOTO
+    // Must list a label for every OpCode in declaration order
+    static void* const dispatchTable[] = {
+        &&L_OP_CONSTANT, &&L_OP_NIL, &&L_OP_TRUE, &&L_OP_FALSE,
+        &&L_OP_ADD, &&L_OP_SUBTRACT, &&L_OP_MULTIPLY, &&L_OP_DIVIDE, &&L_OP_MODULO, &&L_OP_NEGATE,
+        &&L_OP_EQUAL, &&L_OP_NOT_EQUAL, &&L_OP_LESS, &&L_OP_LESS_EQUAL, &&L_OP_GREATER, &&L_OP_GREATER_EQUAL,
+        &&L_OP_NOT, &&L_OP_AND, &&L_OP_OR,
+        &&L_OP_GET_LOCAL, &&L_OP_SET_LOCAL, &&L_OP_GET_GLOBAL, &&L_OP_SET_GLOBAL,
+        &&L_OP_POP,
+        &&L_OP_JUMP, &&L_OP_JUMP_IF_FALSE, &&L_OP_LOOP, &&L_OP_CALL, &&L_OP_RETURN,
+        &&L_OP_POP_JUMP_IF_FALSE, &&L_OP_POP_JUMP_IF_TRUE, &&L_OP_JUMP_IF_NOT_LESS, &&L_OP_JUMP_IF_NOT_LESS_EQUAL,
+        &&L_OP_JUMP_IF_NOT_GREATER, &&L_OP_JUMP_IF_NOT_GREATER_EQUAL,
+        &&L_OP_SET_LOCAL_POP, &&L_OP_SET_GLOBAL_POP, &&L_OP_ADD_LOCAL_CONSTANT, &&L_OP_ADD_GLOBAL_CONSTANT,
+        &&L_OP_ADD_NUM, &&L_OP_ADD_STR, &&L_OP_EQUAL_NUM, &&L_OP_NOT_EQUAL_NUM,
+        &&L_OP_NUM_ADD, &&L_OP_NUM_SUBTRACT, &&L_OP_NUM_MULTIPLY, &&L_OP_NUM_DIVIDE, &&L_OP_NUM_MODULO,
+        &&L_OP_NUM_NEGATE, &&L_OP_NUM_EQUAL, &&L_OP_NUM_NOT_EQUAL, &&L_OP_NUM_LESS, &&L_OP_NUM_LESS_EQUAL,
+        &&L_OP_NUM_GREATER, &&L_OP_NUM_GREATER_EQUAL, &&L_OP_NUM_JUMP_IF_NOT_LESS,
+        &&L_OP_NUM_JUMP_IF_NOT_LESS_EQUAL, &&L_OP_NUM_JUMP_IF_NOT_GREATER, &&L_OP_NUM_JUMP_IF_NOT_GREATER_EQUAL,
+        &&L_OP_NUM_ADD_LOCAL_CONSTANT, &&L_OP_NUM_ADD_GLOBAL_CONSTANT, &&L_OP_INT_MODULO,
+        &&L_OP_PRINT,
+    };
+    static_assert(std::size(dispatchTable) == OPCODE_COUNT, "dispatch table out of sync with OpCode");
+
+// Each handler jumps straight to the next one through the table
+#define VM_DISPATCH()                \
+    instruction = frame->ip++;       \
+    VM_PROFILE();                    \
+    goto *dispatchTable[static_cast<uint8_t>(instruction->opcode)];
+#define VM_CASE(op) L_##op
+#define VM_DEFAULT L_UNKNOWN
+#define VM_NEXT() VM_DISPATCH()
+#else
+#define VM_DISPATCH() switch (instruction = frame->ip++, VM_PROFILE(), instruction->opcode)
+#define VM_CASE(op) case OpCode::op
+#define VM_DEFAULT default
+#define VM_NEXT() break
+#endif
 
-        switch (instruction.opcode) {
+    for (;;) {
+        VM_DISPATCH() {
             // Constants and literals
-            case OpCode::OP_CONSTANT:
-                push(m_chunk->constants[instruction.operand]);
-                break;
+            VM_CASE(OP_CONSTANT):
+                push(frame->chunk->constants[instruction->operand]);
+                VM_NEXT();
 
-            case OpCode::OP_NIL:
+            VM_CASE(OP_NIL):
                 push(Value());
-                break;
+                VM_NEXT();
 
-            case OpCode::OP_TRUE:
+            VM_CASE(OP_TRUE):
                 push(Value(true));
-                break;
+                VM_NEXT();
 
-            case OpCode::OP_FALSE:
+            VM_CASE(OP_FALSE):
                 push(Value(false));
-                break;
+                VM_NEXT();
 
             // Arithmetic
-            case OpCode::OP_ADD: {
+            VM_CASE(OP_ADD): {
                 Value b = pop();
                 Value a = pop();
                 if (a.isString() && b.isString()) {
-                    push(Value(a.asString() + b.asString()));
+                    quicken(instruction, OpCode::OP_ADD_STR);
+                    concatenate(a, b);
                 } else if (a.isNumber() && b.isNumber()) {
+                    quicken(instruction, OpCode::OP_ADD_NUM);
                     push(Value(a.asNumber() + b.asNumber()));
                 } else {
                     runtimeError("Operands must be two numbers or two strings.");
                     return InterpretResult::RUNTIME_ERROR;
                 }
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_SUBTRACT: {
+            VM_CASE(OP_SUBTRACT): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -63,10 +139,10 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(a.asNumber() - b.asNumber()));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_MULTIPLY: {
+            VM_CASE(OP_MULTIPLY): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -74,10 +150,10 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(a.asNumber() * b.asNumber()));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_DIVIDE: {
+            VM_CASE(OP_DIVIDE): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -89,10 +165,10 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(a.asNumber() / b.asNumber()));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_MODULO: {
+            VM_CASE(OP_MODULO): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -103,29 +179,42 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     runtimeError("Modulo by zero.");
                     return InterpretResult::RUNTIME_ERROR;
                 }
-                push(Value(std::fmod(a.asNumber(), b.asNumber())));
-                break;
+                push(Value(numberModulo(a.asNumber(), b.asNumber())));
+                VM_NEXT();
             }
 
-            case OpCode::OP_NEGATE: {
+            VM_CASE(OP_NEGATE): {
                 Value value = pop();
                 if (!value.isNumber()) {
                     runtimeError("Operand must be a number.");
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(-value.asNumber()));
-                break;
+                VM_NEXT();
             }
 
             // Comparison
-            case OpCode::OP_EQUAL: {
+            VM_CASE(OP_EQUAL): {
                 Value b = pop();
                 Value a = pop();
+                if (a.isNumber() && b.isNumber()) {
+                    quicken(instruction, OpCode::OP_EQUAL_NUM);
+                }
                 push(Value(valuesEqual(a, b)));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_LESS: {
+            VM_CASE(OP_NOT_EQUAL): {
+                Value b = pop();
+                Value a = pop();
+                if (a.isNumber() && b.isNumber()) {
+                    quicken(instruction, OpCode::OP_NOT_EQUAL_NUM);
+                }
+                push(Value(!valuesEqual(a, b)));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_LESS): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -133,10 +222,10 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(a.asNumber() < b.asNumber()));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_GREATER: {
+            VM_CASE(OP_GREATER): {
                 Value b = pop();
                 Value a = pop();
                 if (!a.isNumber() || !b.isNumber()) {
@@ -144,184 +233,787 @@ InterpretResult VM::interpret(const Chunk& chunk) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 push(Value(a.asNumber() > b.asNumber()));
-                break;
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_LESS_EQUAL): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(a.asNumber() <= b.asNumber()));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_GREATER_EQUAL): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(a.asNumber() >= b.asNumber()));
+                VM_NEXT();
             }
 
             // Logical
-            case OpCode::OP_NOT: {
+            VM_CASE(OP_NOT): {
                 Value value = pop();
                 push(Value(isFalsey(value)));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_AND: {
+            VM_CASE(OP_AND): {
                 Value b = pop();
                 Value a = pop();
                 push(Value(!isFalsey(a) && !isFalsey(b)));
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_OR: {
+            VM_CASE(OP_OR): {
                 Value b = pop();
                 Value a = pop();
                 push(Value(!isFalsey(a) || !isFalsey(b)));
-                break;
+                VM_NEXT();
             }
 
             // Variables
-            case OpCode::OP_GET_LOCAL: {
-                // In this simple VM, we use a flat stack
-                // A full implementation would have proper frame handling
-                runtimeError("Local variables not fully implemented.");
-                return InterpretResult::RUNTIME_ERROR;
+            VM_CASE(OP_GET_LOCAL):
+                push(frame->slots[instruction->operand]);
+                VM_NEXT();
+
+            VM_CASE(OP_SET_LOCAL):
+                frame->slots[instruction->operand] = peek();
+                VM_NEXT();
+
+            VM_CASE(OP_GET_GLOBAL): {
+                Value value = globals[instruction->operand];
+                if (value.isUndefined()) {
+                    runtimeError(std::format("Undefined variable '{}'.", m_globalNames.names[instruction->operand]));
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(value);
+                VM_NEXT();
             }
 
-            case OpCode::OP_SET_LOCAL: {
-                runtimeError("Local variables not fully implemented.");
-                return InterpretResult::RUNTIME_ERROR;
-            }
+            VM_CASE(OP_SET_GLOBAL):
+                globals[instruction->operand] = peek();
+                VM_NEXT();
 
-            case OpCode::OP_POP:
+            VM_CASE(OP_POP):
                 pop();
-                break;
+                VM_NEXT();
 
             // Control flow
-            case OpCode::OP_JUMP:
-                m_ip += instruction.operand;
-                break;
+            VM_CASE(OP_JUMP):
+                frame->ip += instruction->operand;
+                VM_NEXT();
 
-            case OpCode::OP_JUMP_IF_FALSE: {
-                Value value = peek();
-                if (isFalsey(value)) {
-                    m_ip += instruction.operand;
+            VM_CASE(OP_JUMP_IF_FALSE): {
+                if (isFalsey(peek())) {
+                    frame->ip += instruction->operand;
                 }
-                break;
+                VM_NEXT();
             }
 
-            case OpCode::OP_LOOP: {
-                m_ip -= instruction.operand;
-                break;
+            VM_CASE(OP_LOOP): {
+                frame->ip -= instruction->operand;
+                if (m_jitEnabled) {
+                    loopBackEdge(frame, instruction);
+                }
+                VM_NEXT();
             }
 
-            case OpCode::OP_CALL: {
-                uint8_t argCount = instruction.operand;
-                runtimeError("Function calls not fully implemented.");
-                return InterpretResult::RUNTIME_ERROR;
+            VM_CASE(OP_CALL): {
+                uint8_t argCount = instruction->operand;
+                if (!callValue(peek(argCount), argCount)) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                frame = &m_frames[m_frameCount - 1];
+                if (nativeReady(*frame->chunk)) {
+                    runNative(frame);
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_RETURN): {
+                Value result = pop();
+                m_frameCount--;
+                if (m_frameCount == 0) {
+                    resetStack();
+                    return InterpretResult::OK;
+                }
+
+                // Discard the callee, arguments and locals of the finished frame
+                m_stackTop = frame->slots;
+                push(result);
+                frame = &m_frames[m_frameCount - 1];
+                VM_NEXT();
+            }
+
+            // Superinstructions
+            VM_CASE(OP_POP_JUMP_IF_FALSE): {
+                if (isFalsey(pop())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
             }
 
-            case OpCode::OP_RETURN:
-                // Return the top value or nil
-                return InterpretResult::OK;
+            VM_CASE(OP_POP_JUMP_IF_TRUE): {
+                if (!isFalsey(pop())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_JUMP_IF_NOT_LESS): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!(a.asNumber() < b.asNumber())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_JUMP_IF_NOT_LESS_EQUAL): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!(a.asNumber() <= b.asNumber())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_JUMP_IF_NOT_GREATER): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!(a.asNumber() > b.asNumber())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_JUMP_IF_NOT_GREATER_EQUAL): {
+                Value b = pop();
+                Value a = pop();
+                if (!a.isNumber() || !b.isNumber()) {
+                    runtimeError("Operands must be numbers.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!(a.asNumber() >= b.asNumber())) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_SET_LOCAL_POP):
+                frame->slots[instruction->operand] = pop();
+                VM_NEXT();
+
+            VM_CASE(OP_SET_GLOBAL_POP):
+                globals[instruction->operand] = pop();
+                VM_NEXT();
+
+            VM_CASE(OP_ADD_LOCAL_CONSTANT): {
+                Value a = frame->slots[instruction->operand & PAIR_OPERAND_MAX];
+                Value b = frame->chunk->constants[instruction->operand >> PAIR_OPERAND_BITS];
+                if (!a.isNumber()) {
+                    runtimeError("Operands must be two numbers or two strings.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(a.asNumber() + b.asNumber()));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_ADD_GLOBAL_CONSTANT): {
+                Value a = globals[instruction->operand & PAIR_OPERAND_MAX];
+                Value b = frame->chunk->constants[instruction->operand >> PAIR_OPERAND_BITS];
+                if (a.isUndefined()) {
+                    runtimeError(std::format("Undefined variable '{}'.",
+                                             m_globalNames.names[instruction->operand & PAIR_OPERAND_MAX]));
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!a.isNumber()) {
+                    runtimeError("Operands must be two numbers or two strings.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(a.asNumber() + b.asNumber()));
+                VM_NEXT();
+            }
+
+            // Quickened forms: on a type miss, revert and re-run the generic op
+            VM_CASE(OP_ADD_NUM): {
+                Value b = peek(0);
+                Value a = peek(1);
+                if (!a.isNumber() || !b.isNumber()) {
+                    deoptimize(instruction, OpCode::OP_ADD);
+                    frame->ip--;
+                    VM_NEXT();
+                }
+                m_stackTop -= 2;
+                push(Value(a.asNumber() + b.asNumber()));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_ADD_STR): {
+                Value b = peek(0);
+                Value a = peek(1);
+                if (!a.isString() || !b.isString()) {
+                    deoptimize(instruction, OpCode::OP_ADD);
+                    frame->ip--;
+                    VM_NEXT();
+                }
+                m_stackTop -= 2;
+                concatenate(a, b);
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_EQUAL_NUM): {
+                Value b = peek(0);
+                Value a = peek(1);
+                if (!a.isNumber() || !b.isNumber()) {
+                    deoptimize(instruction, OpCode::OP_EQUAL);
+                    frame->ip--;
+                    VM_NEXT();
+                }
+                m_stackTop -= 2;
+                push(Value(a.asNumber() == b.asNumber()));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NOT_EQUAL_NUM): {
+                Value b = peek(0);
+                Value a = peek(1);
+                if (!a.isNumber() || !b.isNumber()) {
+                    deoptimize(instruction, OpCode::OP_NOT_EQUAL);
+                    frame->ip--;
+                    VM_NEXT();
+                }
+                m_stackTop -= 2;
+                push(Value(a.asNumber() != b.asNumber()));
+                VM_NEXT();
+            }
+
+            // Typed forms: the compiler proved the operands are numbers
+            VM_CASE(OP_NUM_ADD): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a + b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_SUBTRACT): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a - b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_MULTIPLY): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a * b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_DIVIDE): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (b == 0.0) {
+                    runtimeError("Division by zero.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(a / b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_MODULO): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (b == 0.0) {
+                    runtimeError("Modulo by zero.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(numberModulo(a, b)));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_NEGATE):
+                push(Value(-pop().asNumber()));
+                VM_NEXT();
+
+            VM_CASE(OP_NUM_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a == b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_NOT_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a != b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_LESS): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a < b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_LESS_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a <= b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_GREATER): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a > b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_GREATER_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                push(Value(a >= b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_JUMP_IF_NOT_LESS): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (!(a < b)) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_JUMP_IF_NOT_LESS_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (!(a <= b)) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_JUMP_IF_NOT_GREATER): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (!(a > b)) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_JUMP_IF_NOT_GREATER_EQUAL): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (!(a >= b)) {
+                    frame->ip += instruction->operand;
+                }
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_ADD_LOCAL_CONSTANT): {
+                double a = frame->slots[instruction->operand & PAIR_OPERAND_MAX].asNumber();
+                double b = frame->chunk->constants[instruction->operand >> PAIR_OPERAND_BITS].asNumber();
+                push(Value(a + b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_NUM_ADD_GLOBAL_CONSTANT): {
+                double a = globals[instruction->operand & PAIR_OPERAND_MAX].asNumber();
+                double b = frame->chunk->constants[instruction->operand >> PAIR_OPERAND_BITS].asNumber();
+                push(Value(a + b));
+                VM_NEXT();
+            }
+
+            VM_CASE(OP_INT_MODULO): {
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                if (b == 0.0) {
+                    runtimeError("Modulo by zero.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(Value(integerModulo(a, b)));
+                VM_NEXT();
+            }
 
             // Built-in
-            case OpCode::OP_PRINT: {
+            VM_CASE(OP_PRINT): {
                 Value value = pop();
                 *m_output << valueToString(value) << std::endl;
-                break;
+                VM_NEXT();
             }
 
-            default:
-                runtimeError(std::format("Unknown opcode: {}", static_cast<int>(instruction.opcode)));
+            VM_DEFAULT:
+                runtimeError(std::format("Unknown opcode: {}", static_cast<int>(instruction->opcode)));
                 return InterpretResult::RUNTIME_ERROR;
         }
     }
 
+#undef VM_PROFILE
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_NEXT
+
     return InterpretResult::OK;
 }
 
-void VM::push(Value value) {
-    m_stack.push(std::move(value));
+#pragma GCC diagnostic pop
+
+void VM::runNative(CallFrame* frame) {
+    const Chunk& chunk = *frame->chunk;
+    JitContext context{m_stackTop, frame->slots, m_globals.data(), chunk.constants.data()};
+
+    // Resume interpreting wherever native code gave up
+    size_t pc = chunk.jit->run(context, static_cast<size_t>(frame->ip - chunk.code.data()));
+    m_stackTop = context.stackTop;
+    frame->ip = chunk.code.data() + pc;
 }
 
-Value VM::pop() {
-    if (m_stack.empty()) {
-        runtimeError("Stack underflow.");
-        return Value();
+void VM::loopBackEdge(CallFrame* frame, const Instruction* backEdge) {
+    const Chunk& chunk = *frame->chunk;
+    LoopTrace& loop = chunk.traces[static_cast<size_t>(frame->ip - chunk.code.data())];
+
+    if (loop.code) {
+        runTrace(frame, loop.code);
+        return;
+    }
+
+    if (loop.aborts < Jit::TRACE_MAX_ABORTS && ++loop.hotness == Jit::HOT_LOOP_THRESHOLD) {
+        // Recording runs one real iteration; on abort the interpreter simply
+        // carries on from wherever the recorder stopped
+        Trace trace;
+        loop.hotness = 0;
+        if (!recordTrace(frame, static_cast<size_t>(backEdge - chunk.code.data()), trace)) {
+            loop.aborts++;
+            return;
+        }
+        loop.code = m_jit.compileTrace(chunk, trace);
+        if (!loop.code) {
+            loop.aborts = Jit::TRACE_MAX_ABORTS;
+            return;
+        }
+        runTrace(frame, loop.code);
+        return;
     }
-    Value value = m_stack.top();
-    m_stack.pop();
-    return value;
-}
 
-Value VM::peek(size_t distance) {
-    // This is a simplified version - a full implementation would properly
-    // support peeking at arbitrary stack distances
-    if (m_stack.empty()) {
-        return Value();
+    if (nativeReady(chunk)) {
+        runNative(frame);
     }
-    return m_stack.top();
 }
 
-Instruction VM::readInstruction() {
-    if (m_ip >= m_chunk->code.size()) {
-        return Instruction(OpCode::OP_RETURN);
+bool VM::recordTrace(CallFrame* frame, size_t backEdge, Trace& trace) {
+    const Chunk& chunk = *frame->chunk;
+    Instruction* code = chunk.code.data();
+    Value* globals = m_globals.data();
+    const size_t header = static_cast<size_t>(frame->ip - code);
+    trace.header = static_cast<uint32_t>(header);
+
+    auto numbers = [this]() { return peek(0).isNumber() && peek(1).isNumber(); };
+    auto traceable = [](Value value) { return value.isNumber() || value.isBool() || value.isNil(); };
+
+    // Execute exactly as the interpreter would, stopping before any
+    // instruction outside the traceable subset or any type it would reject
+    while (trace.steps.size() < Jit::TRACE_MAX_STEPS) {
+        const size_t pc = static_cast<size_t>(frame->ip - code);
+        if (pc < header || pc > backEdge) {
+            return false;
+        }
+
+        // Typed forms are recorded as their generic form; the checks below always pass for them
+        Instruction* instruction = frame->ip;
+        const OpCode opcode = untypedOpcode(instruction->opcode);
+        const uint32_t operand = instruction->operand;
+        TraceStep step{static_cast<uint32_t>(pc), opcode, operand};
+        Instruction* next = instruction + 1;
+
+        switch (opcode) {
+            case OpCode::OP_CONSTANT:
+                push(chunk.constants[operand]);
+                break;
+            case OpCode::OP_NIL:
+                push(Value());
+                break;
+            case OpCode::OP_TRUE:
+                push(Value(true));
+                break;
+            case OpCode::OP_FALSE:
+                push(Value(false));
+                break;
+
+            case OpCode::OP_ADD:
+            case OpCode::OP_ADD_NUM:
+            case OpCode::OP_SUBTRACT:
+            case OpCode::OP_MULTIPLY:
+            case OpCode::OP_DIVIDE:
+            case OpCode::OP_MODULO: {
+                if (!numbers()) return false;
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                switch (opcode) {
+                    case OpCode::OP_SUBTRACT: push(Value(a - b)); break;
+                    case OpCode::OP_MULTIPLY: push(Value(a * b)); break;
+                    case OpCode::OP_DIVIDE:
+                    case OpCode::OP_MODULO:
+                        if (b == 0.0) {
+                            push(Value(a));
+                            push(Value(b));
+                            return false;
+                        }
+                        push(Value(opcode == OpCode::OP_DIVIDE ? a / b : numberModulo(a, b)));
+                        break;
+                    default: push(Value(a + b)); break;
+                }
+                break;
+            }
+
+            case OpCode::OP_NEGATE:
+                if (!peek().isNumber()) return false;
+                push(Value(-pop().asNumber()));
+                break;
+
+            case OpCode::OP_EQUAL:
+            case OpCode::OP_EQUAL_NUM:
+            case OpCode::OP_NOT_EQUAL:
+            case OpCode::OP_NOT_EQUAL_NUM:
+            case OpCode::OP_LESS:
+            case OpCode::OP_LESS_EQUAL:
+            case OpCode::OP_GREATER:
+            case OpCode::OP_GREATER_EQUAL: {
+                if (!numbers()) return false;
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                bool result;
+                switch (opcode) {
+                    case OpCode::OP_EQUAL:
+                    case OpCode::OP_EQUAL_NUM: result = a == b; break;
+                    case OpCode::OP_NOT_EQUAL:
+                    case OpCode::OP_NOT_EQUAL_NUM: result = a != b; break;
+                    case OpCode::OP_LESS: result = a < b; break;
+                    case OpCode::OP_LESS_EQUAL: result = a <= b; break;
+                    case OpCode::OP_GREATER: result = a > b; break;
+                    default: result = a >= b; break;
+                }
+                push(Value(result));
+                break;
+            }
+
+            case OpCode::OP_NOT:
+                push(Value(isFalsey(pop())));
+                break;
+            case OpCode::OP_AND:
+            case OpCode::OP_OR: {
+                Value b = pop();
+                Value a = pop();
+                bool result = opcode == OpCode::OP_AND ? !isFalsey(a) && !isFalsey(b)
+                                                                    : !isFalsey(a) || !isFalsey(b);
+                push(Value(result));
+                break;
+            }
+
+            case OpCode::OP_GET_LOCAL:
+            case OpCode::OP_GET_GLOBAL: {
+                Value value = opcode == OpCode::OP_GET_LOCAL ? frame->slots[operand] : globals[operand];
+                if (!traceable(value)) return false;
+                step.observed = value.type();
+                push(value);
+                break;
+            }
+            case OpCode::OP_SET_LOCAL:
+                frame->slots[operand] = peek();
+                break;
+            case OpCode::OP_SET_LOCAL_POP:
+                frame->slots[operand] = pop();
+                break;
+            case OpCode::OP_SET_GLOBAL:
+                globals[operand] = peek();
+                break;
+            case OpCode::OP_SET_GLOBAL_POP:
+                globals[operand] = pop();
+                break;
+            case OpCode::OP_POP:
+                pop();
+                break;
+
+            case OpCode::OP_ADD_LOCAL_CONSTANT:
+            case OpCode::OP_ADD_GLOBAL_CONSTANT: {
+                bool local = opcode == OpCode::OP_ADD_LOCAL_CONSTANT;
+                Value a = local ? frame->slots[operand & PAIR_OPERAND_MAX] : globals[operand & PAIR_OPERAND_MAX];
+                Value b = chunk.constants[operand >> PAIR_OPERAND_BITS];
+                if (!a.isNumber() || !b.isNumber()) return false;
+                push(Value(a.asNumber() + b.asNumber()));
+                break;
+            }
+
+            case OpCode::OP_JUMP:
+                next += operand;
+                break;
+            case OpCode::OP_JUMP_IF_FALSE:
+                step.taken = isFalsey(peek());
+                if (step.taken) next += operand;
+                break;
+            case OpCode::OP_POP_JUMP_IF_FALSE:
+                step.taken = isFalsey(pop());
+                if (step.taken) next += operand;
+                break;
+            case OpCode::OP_POP_JUMP_IF_TRUE:
+                step.taken = !isFalsey(pop());
+                if (step.taken) next += operand;
+                break;
+
+            case OpCode::OP_JUMP_IF_NOT_LESS:
+            case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL:
+            case OpCode::OP_JUMP_IF_NOT_GREATER:
+            case OpCode::OP_JUMP_IF_NOT_GREATER_EQUAL: {
+                if (!numbers()) return false;
+                double b = pop().asNumber();
+                double a = pop().asNumber();
+                switch (opcode) {
+                    case OpCode::OP_JUMP_IF_NOT_LESS: step.taken = !(a < b); break;
+                    case OpCode::OP_JUMP_IF_NOT_LESS_EQUAL: step.taken = !(a <= b); break;
+                    case OpCode::OP_JUMP_IF_NOT_GREATER: step.taken = !(a > b); break;
+                    default: step.taken = !(a >= b); break;
+                }
+                if (step.taken) next += operand;
+                break;
+            }
+
+            // Any back-edge to this loop's header closes the trace
+            case OpCode::OP_LOOP:
+                if (pc + 1 - operand != header) return false;
+                trace.steps.push_back(step);
+                frame->ip = code + header;
+                return true;
+
+            default:
+                return false;
+        }
+
+        trace.steps.push_back(step);
+        frame->ip = next;
     }
-    return m_chunk->code[m_ip++];
+
+    return false;
 }
 
-uint8_t VM::readByte() {
-    return readInstruction().operand;
+void VM::runTrace(CallFrame* frame, const JitCode* code) {
+    const Chunk& chunk = *frame->chunk;
+    JitContext context{m_stackTop, frame->slots, m_globals.data(), chunk.constants.data()};
+
+    size_t pc = code->run(context, 0);
+    m_stackTop = context.stackTop;
+    frame->ip = chunk.code.data() + pc;
 }
 
-bool VM::isFalsey(const Value& value) {
-    if (value.isNil()) return true;
-    if (value.isBool()) return !value.asBool();
-    if (value.isNumber()) return value.asNumber() == 0.0;
-    return false;
+bool VM::callValue(Value callee, uint8_t argCount) {
+    if (!callee.isFunction()) {
+        runtimeError("Can only call functions.");
+        return false;
+    }
+
+    const ObjFunction* function = callee.asFunction();
+    if (argCount != function->arity) {
+        runtimeError(std::format("Expected {} arguments but got {}.", function->arity, argCount));
+        return false;
+    }
+
+    Value* slots = m_stackTop - argCount - 1;
+    if (m_frameCount == FRAMES_MAX || !hasStackRoom(slots, function->chunk)) {
+        runtimeError("Stack overflow.");
+        return false;
+    }
+
+    CallFrame* frame = &m_frames[m_frameCount++];
+    frame->chunk = &function->chunk;
+    frame->ip = function->chunk.code.data();
+    frame->slots = slots;
+    return true;
 }
 
-bool VM::valuesEqual(const Value& a, const Value& b) {
-    if (a.type != b.type) return false;
-
-    switch (a.type) {
-        case ValueType::NIL:
-            return true;
-        case ValueType::BOOL:
-            return a.asBool() == b.asBool();
-        case ValueType::NUMBER:
-            return a.asNumber() == b.asNumber();
-        case ValueType::STRING:
-            return a.asString() == b.asString();
+void VM::dumpOpcodeProfile(std::ostream& out, size_t limit) const {
+#if MINILANG_PROFILE_OPCODES
+    std::vector<size_t> order;
+    for (size_t i = 0; i < m_opcodePairs.size(); i++) {
+        if (m_opcodePairs[i] > 0) {
+            order.push_back(i);
+        }
     }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_opcodePairs[a] > m_opcodePairs[b];
+    });
 
-    return false;
+    if (order.empty()) {
+        out << "No opcode profile (build with -DMINILANG_PROFILE_OPCODES=ON)" << std::endl;
+        return;
+    }
+
+    out << "Most frequent opcode pairs:" << std::endl;
+    for (size_t i = 0; i < order.size() && i < limit; i++) {
+        auto first = static_cast<OpCode>(order[i] / OPCODE_COUNT);
+        auto second = static_cast<OpCode>(order[i] % OPCODE_COUNT);
+        out << std::format("  {:>12}  {} -> {}", m_opcodePairs[order[i]], opcodeName(first), opcodeName(second))
+            << std::endl;
+    }
+#else
+    (void)limit;
+    out << "No opcode profile (build with -DMINILANG_PROFILE_OPCODES=ON)" << std::endl;
+#endif
 }
 
-void VM::concatenate() {
-    Value b = pop();
-    Value a = pop();
-    push(Value(a.asString() + b.asString()));
+uint64_t VM::executedCount() const {
+    uint64_t total = 0;
+#if MINILANG_PROFILE_OPCODES
+    for (uint64_t count : m_opcodePairs) {
+        total += count;
+    }
+#endif
+    return total;
 }
 
-void VM::runtimeError(const std::string& message) {
-    m_error = message;
+void VM::concatenate(Value a, Value b) {
+    push(Value(m_heap.makeRuntimeString(a.asString() + b.asString())));
+    if (m_heap.shouldCollect()) {
+        collectGarbage();
+    }
 }
 
-std::string VM::valueToString(const Value& value) {
-    switch (value.type) {
-        case ValueType::NIL:
-            return "nil";
-        case ValueType::BOOL:
-            return value.asBool() ? "true" : "false";
-        case ValueType::NUMBER: {
-            std::string s = std::format("{}", value.asNumber());
-            // Remove trailing zeros
-            size_t dot = s.find('.');
-            if (dot != std::string::npos) {
-                size_t last_non_zero = s.find_last_not_of('0');
-                if (last_non_zero != std::string::npos && last_non_zero > dot) {
-                    s.erase(last_non_zero + 1);
-                }
-                if (s.back() == '.') {
-                    s.pop_back();
-                }
-            }
-            return s;
-        }
-        case ValueType::STRING:
-            return value.asString();
+void VM::collectGarbage() {
+    // Runtime strings are only ever stored on the stack and in globals
+    for (Value* slot = m_stack.get(); slot < m_stackTop; slot++) {
+        m_heap.mark(*slot);
+    }
+    for (Value global : m_globals) {
+        m_heap.mark(global);
     }
-    return "unknown";
+    m_heap.sweep();
+}
+
+void VM::runtimeError(const std::string& message) {
+    m_error = message;
+    resetStack();
 }
 
 } // namespace minilang
@@ -0,0 +1,132 @@
+#include "Value.hpp"
+#include "IRGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+namespace minilang {
+
+ValueType Value::type() const {
+    if (isNumber()) return ValueType::NUMBER;
+    if (isNil()) return ValueType::NIL;
+    if (isBool()) return ValueType::BOOL;
+    return asObj()->type == ObjType::STRING ? ValueType::STRING : ValueType::FUNCTION;
+}
+
+bool isFalsey(Value value) {
+    if (value.isNil()) return true;
+    if (value.isBool()) return !value.asBool();
+    if (value.isNumber()) return value.asNumber() == 0.0;
+    return false;
+}
+
+bool valuesEqual(Value a, Value b) {
+    if (a.type() != b.type()) return false;
+
+    switch (a.type()) {
+        case ValueType::NIL:
+            return true;
+        case ValueType::BOOL:
+            return a.asBool() == b.asBool();
+        case ValueType::NUMBER:
+            return a.asNumber() == b.asNumber();
+        case ValueType::STRING:
+            return a.asString() == b.asString();
+        case ValueType::FUNCTION:
+            return a.sameBits(b);
+    }
+
+    return false;
+}
+
+double integerModulo(double a, double b) {
+    constexpr double INT64_LIMIT = 9223372036854775808.0; // 2^63
+    if (std::fabs(a) < INT64_LIMIT && std::fabs(b) < INT64_LIMIT) {
+        auto x = static_cast<int64_t>(a);
+        auto y = static_cast<int64_t>(b);
+        return std::copysign(static_cast<double>(x % y), a);
+    }
+
+    // Past int64 (or infinite after an overflow)
+    return std::fmod(a, b);
+}
+
+double numberModulo(double a, double b) {
+    // Integral operands (the common case for loop counters) skip libm's fmod
+    if (std::trunc(a) == a && std::trunc(b) == b) {
+        return integerModulo(a, b);
+    }
+    return std::fmod(a, b);
+}
+
+std::string valueToString(Value value) {
+    switch (value.type()) {
+        case ValueType::NIL:
+            return "nil";
+        case ValueType::BOOL:
+            return value.asBool() ? "true" : "false";
+        case ValueType::NUMBER: {
+            std::string s = std::format("{}", value.asNumber());
+            // Remove trailing zeros
+            size_t dot = s.find('.');
+            if (dot != std::string::npos) {
+                size_t last_non_zero = s.find_last_not_of('0');
+                if (last_non_zero != std::string::npos && last_non_zero > dot) {
+                    s.erase(last_non_zero + 1);
+                }
+                if (s.back() == '.') {
+                    s.pop_back();
+                }
+            }
+            return s;
+        }
+        case ValueType::STRING:
+            return value.asString();
+        case ValueType::FUNCTION:
+            return std::format("<fn {}>", value.asFunction()->name);
+    }
+    return "unknown";
+}
+
+Heap::~Heap() {
+    for (Obj* list : {m_objects, m_runtime}) {
+        while (list) {
+            Obj* next = list->next;
+            delete list;
+            list = next;
+        }
+    }
+}
+
+// Counted against the collection threshold: the object and its characters
+static size_t stringBytes(const ObjString* string) {
+    return sizeof(ObjString) + string->chars.capacity();
+}
+
+ObjString* Heap::makeRuntimeString(std::string chars) {
+    auto* string = new ObjString(std::move(chars));
+    string->next = m_runtime;
+    m_runtime = string;
+    m_runtimeCount++;
+    m_runtimeBytes += stringBytes(string);
+    return string;
+}
+
+void Heap::sweep() {
+    Obj** link = &m_runtime;
+    while (*link) {
+        Obj* obj = *link;
+        if (m_marked.contains(obj)) {
+            link = &obj->next;
+            continue;
+        }
+        *link = obj->next;
+        m_runtimeCount--;
+        m_runtimeBytes -= stringBytes(static_cast<ObjString*>(obj));
+        delete obj;
+    }
+    m_marked.clear();
+    m_nextCollection = std::max(FIRST_COLLECTION, m_runtimeBytes * 2);
+}
+
+} // namespace minilang
@@ -1,4 +1,8 @@
 #include "Compiler.hpp"
+#include "SourceFile.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <format>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -6,21 +10,171 @@
 namespace minilang {
 
 /**
- * Run a source file
+ * Map a whole source file, reporting failure on stderr
  */
-static bool runFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << path << "'" << std::endl;
+static bool readFile(const std::string& path, SourceFile& source) {
+    if (!source.open(path)) {
+        std::cerr << "Error: " << source.getError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Print the encoded size of a chunk and every function nested in it
+ */
+static size_t reportChunk(const std::string& name, const Chunk& chunk, size_t& constants) {
+    size_t count = chunk.code.size();
+    constants += chunk.constants.size();
+    std::cout << std::format("  {:<16} {:>8} instructions {:>10} bytes", name, count,
+                             count * sizeof(Instruction))
+              << std::endl;
+
+    for (const Value& constant : chunk.constants) {
+        if (constant.isFunction()) {
+            const ObjFunction* function = constant.asFunction();
+            count += reportChunk("fn " + function->name, function->chunk, constants);
+        }
+    }
+    return count;
+}
+
+/**
+ * Compile a source file and report its bytecode size without running it
+ */
+static bool statsFile(const std::string& path) {
+    SourceFile source;
+    if (!readFile(path, source)) {
+        return false;
+    }
+
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source.text());
+    if (compiler.hadError()) {
+        std::cerr << "Compile Error: " << compiler.getError() << std::endl;
+        return false;
+    }
+
+    std::cout << "Chunk size report (" << sizeof(Instruction) << " bytes per instruction):" << std::endl;
+    size_t constants = 0;
+    size_t total = reportChunk("script", chunk, constants);
+    std::cout << std::format("  {:<16} {:>8} instructions {:>10} bytes, {} constants", "total", total,
+                             total * sizeof(Instruction), constants)
+              << std::endl;
+
+    const PeepholeStats& peephole = compiler.peepholeStats();
+    std::cout << std::format("Peephole: removed {} of {} instructions", peephole.removed, peephole.instructions)
+              << std::endl;
+    for (const auto& [rule, count] : peephole.rules) {
+        std::cout << std::format("  {:<16} {:>8}", rule, count) << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Print the SSA IR of a source file without running it
+ */
+static bool dumpSSAFile(const std::string& path) {
+    SourceFile source;
+    if (!readFile(path, source)) {
+        return false;
+    }
+
+    Compiler compiler;
+    std::string ssa = compiler.dumpSSA(source.text());
+    if (compiler.hadError()) {
+        std::cerr << "Compile Error: " << compiler.getError() << std::endl;
+        return false;
+    }
+
+    std::cout << ssa;
+    return true;
+}
+
+/**
+ * Compile a source file to C, writing the program to stdout
+ */
+static bool emitFile(const std::string& path) {
+    SourceFile source;
+    if (!readFile(path, source)) {
+        return false;
+    }
+
+    Compiler compiler;
+    std::string code = compiler.compileToC(source.text());
+    if (compiler.hadError()) {
+        std::cerr << "Compile Error: " << compiler.getError() << std::endl;
         return false;
     }
 
-    std::string source((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    file.close();
+    std::cout << code;
+    return true;
+}
+
+/**
+ * Quote an argument for the POSIX shell
+ */
+static std::string shellQuote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+/**
+ * Compile a source file to C and build a native executable from it with
+ * the system C compiler ($CC, or cc); the C file is kept only on failure
+ */
+static bool buildFile(const std::string& path, const std::string& output) {
+    SourceFile source;
+    if (!readFile(path, source)) {
+        return false;
+    }
 
     Compiler compiler;
-    InterpretResult result = compiler.run(source);
+    std::string code = compiler.compileToC(source.text());
+    if (compiler.hadError()) {
+        std::cerr << "Compile Error: " << compiler.getError() << std::endl;
+        return false;
+    }
+
+    std::string cPath = output + ".c";
+    std::ofstream file(cPath);
+    if (!(file << code) || (file.close(), !file)) {
+        std::cerr << "Error: Could not write file '" << cPath << "'" << std::endl;
+        return false;
+    }
+
+    const char* cc = std::getenv("CC");
+    std::string command = std::format("{} -O2 -o {} {} -lm", cc && *cc ? cc : "cc", shellQuote(output),
+                                      shellQuote(cPath));
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "Error: C compiler failed; generated source left in '" << cPath << "'" << std::endl;
+        return false;
+    }
+
+    std::remove(cPath.c_str());
+    return true;
+}
+
+/**
+ * Run a source file on the given backend, optionally reporting the
+ * opcode pair profile of the stack VM
+ */
+static bool runFile(const std::string& path, bool profile = false, Backend backend = Backend::STACK) {
+    SourceFile source;
+    if (!readFile(path, source)) {
+        return false;
+    }
+
+    Compiler compiler;
+    compiler.setBackend(backend);
+    InterpretResult result = compiler.run(source.text());
+
+    if (profile) {
+        compiler.vm().dumpOpcodeProfile(std::cerr);
+    }
 
     if (result == InterpretResult::COMPILE_ERROR) {
         std::cerr << "Compile Error: " << compiler.getError() << std::endl;
@@ -44,6 +198,7 @@ static void repl() {
     std::cout << std::endl;
 
     Compiler compiler;
+    compiler.setInlining(false);
     std::string line;
 
     while (true) {
@@ -76,10 +231,46 @@ int main(int argc, char* argv[]) {
         if (!runFile(path)) {
             return 1;
         }
+    } else if (argc == 3 && std::string(argv[1]) == "--stats") {
+        if (!statsFile(argv[2])) {
+            return 1;
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--profile") {
+        if (!runFile(argv[2], true)) {
+            return 1;
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--register") {
+        if (!runFile(argv[2], false, Backend::REGISTER)) {
+            return 1;
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--ssa") {
+        if (!runFile(argv[2], false, Backend::SSA)) {
+            return 1;
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--dump-ssa") {
+        if (!dumpSSAFile(argv[2])) {
+            return 1;
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--emit-c") {
+        if (!emitFile(argv[2])) {
+            return 1;
+        }
+    } else if (argc == 4 && std::string(argv[1]) == "--native") {
+        if (!buildFile(argv[2], argv[3])) {
+            return 1;
+        }
     } else {
-        std::cerr << "Usage: " << argv[0] << " [file]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--stats | --profile | --register | --ssa | --dump-ssa | --emit-c] [file]" << std::endl;
+        std::cerr << "       " << argv[0] << " --native file output" << std::endl;
         std::cerr << std::endl;
         std::cerr << "  If no file is specified, starts interactive REPL." << std::endl;
+        std::cerr << "  --stats    Report bytecode size instead of running the file." << std::endl;
+        std::cerr << "  --profile  Run the file, then report the most frequent opcode pairs." << std::endl;
+        std::cerr << "  --register Run the file on the register-based VM." << std::endl;
+        std::cerr << "  --ssa      Run the file with bytecode generated through the SSA IR." << std::endl;
+        std::cerr << "  --dump-ssa Print the SSA IR of the file instead of running it." << std::endl;
+        std::cerr << "  --emit-c   Print the file compiled to a standalone C program." << std::endl;
+        std::cerr << "  --native   Build the file into a native executable with the system C compiler." << std::endl;
         return 1;
     }
 
@@ -1,9 +1,56 @@
 #include "Compiler.hpp"
+#include "SourceFile.hpp"
+#include <filesystem>
+#include <format>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 using namespace minilang;
 
+void testLexer() {
+    std::cout << "Testing lexer..." << std::endl;
+
+    // Lexemes view the source; literal values sit in the lexer's side table
+    std::string source = "let name = \"text\"; print 2.5;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.tokenize();
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    bool views = tokens.size() == 9;
+    for (const Token& token : tokens) {
+        if (token.type != TokenType::EOF_TOKEN && (token.lexeme().data() < begin || token.lexeme().data() >= end)) {
+            views = false;
+        }
+    }
+
+    // Keywords only match whole words
+    Lexer words("while whilst f fn fnx false falsey print");
+    std::vector<TokenType> types;
+    for (const Token& token : words.tokenize()) types.push_back(token.type);
+    std::vector<TokenType> expected = {TokenType::WHILE, TokenType::IDENTIFIER, TokenType::IDENTIFIER,
+                                       TokenType::FN, TokenType::IDENTIFIER, TokenType::FALSE,
+                                       TokenType::IDENTIFIER, TokenType::PRINT, TokenType::EOF_TOKEN};
+
+    // Runs longer than a 16-byte block, comment lines in a row and strings spanning lines
+    Lexer runs("// one\n// two\n\n   a_very_long_identifier_name2 12345678901234567.25\t\n\"x\ny\" z");
+    std::vector<Token> spans = runs.tokenize();
+    bool spansMatch = spans.size() == 5 && spans[0].lexeme() == "a_very_long_identifier_name2" && spans[0].line == 4 &&
+                      std::get<double>(runs.literals()[spans[1].literal]) == 12345678901234567.25 &&
+                      spans[2].type == TokenType::STRING && spans[2].line == 6 && spans[3].lexeme() == "z" &&
+                      spans[3].line == 6;
+
+    const std::vector<Literal>& literals = lexer.literals();
+    if (types != expected || !views || !spansMatch || tokens[1].lexeme() != "name" ||
+        std::get<std::string>(literals[tokens[3].literal]) != "text" ||
+        std::get<double>(literals[tokens[6].literal]) != 2.5) {
+        std::cerr << "  FAILED: tokens do not match the source" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
 void testArithmetic() {
     std::cout << "Testing arithmetic..." << std::endl;
 
@@ -84,15 +131,704 @@ void testLogical() {
     }
 }
 
+void testFunctions() {
+    std::cout << "Testing functions..." << std::endl;
+
+    Compiler compiler;
+    compiler.run("fn add(a, b) { let c = a + b; return c; } print add(5, 3);");
+    compiler.run("fn fib(n) { if (n <= 1) { return n; } return fib(n - 1) + fib(n - 2); } print fib(10);");
+
+    if (compiler.hadError()) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testGlobals() {
+    std::cout << "Testing globals..." << std::endl;
+
+    Compiler compiler;
+    compiler.run("fn add(a, b) { return a + b; } fn twice(n) { return add(n, n) + offset; } let offset = 1;");
+    compiler.run("print twice(offset);"); // Globals persist across runs, as in the REPL
+
+    if (compiler.hadError()) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+        return;
+    }
+
+    compiler.run("print missing;");
+    if (!compiler.hadError()) {
+        std::cerr << "  FAILED: undefined global was accepted" << std::endl;
+        return;
+    }
+
+    // One program may not declare a global twice; a later REPL line may
+    for (Backend backend : {Backend::STACK, Backend::SSA, Backend::REGISTER}) {
+        Compiler repl;
+        repl.setBackend(backend);
+        for (const char* source : {"let x = 1; let x = 2;", "fn g() { return 1; } fn g() { return 2; }"}) {
+            if (repl.run(source) != InterpretResult::COMPILE_ERROR ||
+                repl.getError().find("already declared in this scope.") == std::string::npos) {
+                std::cerr << "  FAILED: redeclaration was accepted: " << source << std::endl;
+                return;
+            }
+        }
+        repl.run("let y = 1;");
+        if (repl.run("let y = 2;") != InterpretResult::OK) {
+            std::cerr << "  FAILED: " << repl.getError() << std::endl;
+            return;
+        }
+    }
+    compiler.compileToC("let x = 1; let x = 2;");
+    if (!compiler.hadError()) {
+        std::cerr << "  FAILED: redeclaration was accepted by the C backend" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testUndefinedGlobals() {
+    std::cout << "Testing globals read before assignment..." << std::endl;
+
+    // get() runs natively once hot, before g is assigned
+    const char* sources[] = {
+        "fn run() { return later(); } run(); fn later() { return 1; }",
+        "fn get(read) { if (read) { return g; } return 0; } let i = 0; while (i < 5000) { get(false); i = i + 1; }"
+        "print get(true); let g = 1;",
+    };
+    const char* names[] = {"later", "g"};
+
+    for (Backend backend : {Backend::STACK, Backend::SSA, Backend::REGISTER}) {
+        for (size_t i = 0; i < 2; i++) {
+            std::ostringstream output;
+            Compiler compiler;
+            compiler.setBackend(backend);
+            compiler.setInlining(false);
+            compiler.vm().setOutput(output);
+            InterpretResult result = compiler.run(sources[i]);
+            std::string expected = std::format("Undefined variable '{}'.", names[i]);
+            if (result != InterpretResult::RUNTIME_ERROR || compiler.getError().find(expected) == std::string::npos) {
+                std::cerr << "  FAILED: expected \"" << expected << "\", got \"" << compiler.getError() << "\"" << std::endl;
+                return;
+            }
+        }
+    }
+    std::cout << "  PASSED" << std::endl;
+}
+
+void testGarbageCollection() {
+    std::cout << "Testing garbage collection..." << std::endl;
+
+    // Every append leaves the previous string unreachable; the ones a
+    // global and a pending call still hold must survive
+    const char* source = "fn grow(s, n) { let i = 0; while (i < n) { s = s + \"0123456789\"; i = i + 1; } return s; }"
+                         "let keep = \"a\" + \"b\"; fn wrap(s) { let mid = grow(\"\", 5000); return s + \"!\"; }"
+                         "print wrap(keep); print grow(\"\", 5000) == grow(\"\", 5000);";
+
+    for (Backend backend : {Backend::STACK, Backend::SSA, Backend::REGISTER}) {
+        std::ostringstream output;
+        Compiler compiler;
+        compiler.setBackend(backend);
+        compiler.vm().setOutput(output);
+        compiler.registerVM().setOutput(output);
+        InterpretResult result = compiler.run(source);
+        Heap& heap = backend == Backend::REGISTER ? compiler.registerVM().heap() : compiler.vm().heap();
+        if (result != InterpretResult::OK || output.str() != "ab!\ntrue\n" || heap.runtimeCount() > 1000) {
+            std::cerr << "  FAILED: " << heap.runtimeCount() << " strings still allocated, output \"" << output.str()
+                      << "\"" << std::endl;
+            return;
+        }
+    }
+    std::cout << "  PASSED" << std::endl;
+}
+
+void testQuickening() {
+    std::cout << "Testing quickening..." << std::endl;
+
+    // The same + and == sites see numbers, then strings, then numbers again
+    Compiler compiler;
+    compiler.setInlining(false);
+    compiler.run("fn add(a, b) { return a + b; } fn eq(a, b) { return a == b; }"
+                 "let i = 0; while (i < 10) { add(i, 1); add(\"a\", \"b\"); eq(i, 3); eq(\"x\", i); i = i + 1; }"
+                 "print add(20, 22); print add(\"ok\", \"!\"); print eq(2, 2);");
+
+    if (compiler.hadError()) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testWideOperands() {
+    std::cout << "Testing wide operands..." << std::endl;
+
+    // Over 255 locals and constants, and a loop body longer than 255 instructions
+    std::string source = "let total = 0; let i = 0; while (i < 2) {";
+    for (int n = 0; n < 300; n++) {
+        source += "let v" + std::to_string(n) + " = " + std::to_string(n) + ";";
+    }
+    source += "total = total + v299; i = i + 1; } print total;";
+
+    Compiler compiler;
+    compiler.run(source);
+
+    if (compiler.hadError()) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testAddConstant() {
+    std::cout << "Testing fused constant adds..." << std::endl;
+
+    // Every `x + 1` shares one pool entry, so the fused form never runs out of indexes
+    std::string source = "let x = 0;";
+    for (int n = 0; n < 5000; n++) {
+        source += "x = x + 1;";
+    }
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source);
+    if (compiler.hadError() || chunk.constants.size() > 2) {
+        std::cerr << "  FAILED: " << chunk.constants.size() << " constants for two distinct numbers" << std::endl;
+        return;
+    }
+
+    // A subtraction keeps its own error message
+    for (Backend backend : {Backend::STACK, Backend::SSA, Backend::REGISTER}) {
+        for (const char* program : {"let g = \"a\"; print g - 1;", "fn f(s) { let t = s; return t - 1; } print f(\"a\");"}) {
+            Compiler checked;
+            checked.setBackend(backend);
+            if (checked.run(program) != InterpretResult::RUNTIME_ERROR ||
+                checked.getError().find("Operands must be numbers.") == std::string::npos) {
+                std::cerr << "  FAILED: " << checked.getError() << std::endl;
+                return;
+            }
+        }
+    }
+    std::cout << "  PASSED" << std::endl;
+}
+
+void testStackDepth() {
+    std::cout << "Testing stack depth..." << std::endl;
+
+    // Each call holds 300 pending operands, more than any fixed per-frame headroom
+    std::string body = "f(n - 1)";
+    for (int n = 0; n < 300; n++) {
+        body = "n + (" + body + ")";
+    }
+    std::string source = "fn f(n) { if (n < 1) { return 0; } return " + body + "; }";
+
+    for (Backend backend : {Backend::STACK, Backend::SSA}) {
+        std::ostringstream output;
+        Compiler compiler;
+        compiler.setBackend(backend);
+        compiler.vm().setOutput(output);
+        InterpretResult shallow = compiler.run(source + "print f(3);");
+        InterpretResult deep = compiler.run("print f(250);");
+        if (shallow != InterpretResult::OK || output.str() != "1800\n" || deep != InterpretResult::RUNTIME_ERROR ||
+            compiler.getError().find("Stack overflow.") == std::string::npos) {
+            std::cerr << "  FAILED: deep frames were not bounded: " << compiler.getError() << std::endl;
+            return;
+        }
+    }
+    std::cout << "  PASSED" << std::endl;
+}
+
+void testRegisterBackend() {
+    std::cout << "Testing register backend..." << std::endl;
+
+    Compiler compiler;
+    compiler.setBackend(Backend::REGISTER);
+    compiler.run("fn fib(n) { if (n <= 1) { return n; } return fib(n - 1) + fib(n - 2); }"
+                 "let i = 0; let s = \"\"; while (i < 5) { s = s + \"x\"; i = i + 1; }"
+                 "{ let a = 2; let b = a + (a = 5); print b * fib(10); } print s;");
+
+    if (compiler.hadError()) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testJit() {
+    std::cout << "Testing JIT..." << std::endl;
+
+    // Hot loops and calls run natively; output must match the interpreter,
+    // including strings and a runtime error raised after native code exits
+    std::string source =
+        "fn step(n) { return n * 0.5 - n % 3; }"
+        "let i = 0; let sum = 0; let s = \"\"; let flags = 0;"
+        "while (i < 5000) { sum = sum + step(i) + -i / 4;"
+        "  if (i == 3 || !(i != 4) && true) { flags = flags + 1; }"
+        "  if (i % 1000 == 0) { s = s + \"x\"; } i = i + 1; }"
+        "print sum; print s; print flags;"
+        "let j = 0; while (j < 3000) { j = j + 1; if (j == 2999) { j = j / 0; } }";
+
+    std::ostringstream native;
+    std::ostringstream interpreted;
+
+    Compiler jit;
+    jit.vm().setOutput(native);
+    InterpretResult jitResult = jit.run(source);
+
+    Compiler interpreter;
+    interpreter.vm().setOutput(interpreted);
+    interpreter.vm().setJitEnabled(false);
+    InterpretResult interpreterResult = interpreter.run(source);
+
+    if (native.str() != interpreted.str() || jitResult != interpreterResult ||
+        jit.getError() != interpreter.getError()) {
+        std::cerr << "  FAILED: JIT output differs from the interpreter" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testTracing() {
+    std::cout << "Testing loop tracing..." << std::endl;
+
+    // Branches flip and variable types change after the traces are compiled
+    std::string source =
+        "let i = 0; let sum = 0; let odd = 0; let t = true;"
+        "while (i < 20000) { if (i % 2 == 0) { sum = sum + i / 2; } else { odd = odd + 1; }"
+        "  if (i == 15000) { t = false; } if (!t) { sum = sum - 1; } i = i + 1; }"
+        "print sum; print odd; print t;"
+        "let s = 0; let j = 0; while (j < 1000) { if (j == 500) { s = \"str\"; } if (j < 500) { s = s + 1; } j = j + 1; }"
+        "print s;";
+
+    std::ostringstream traced;
+    std::ostringstream interpreted;
+
+    Compiler jit;
+    jit.vm().setOutput(traced);
+    jit.run(source);
+
+    Compiler interpreter;
+    interpreter.vm().setOutput(interpreted);
+    interpreter.vm().setJitEnabled(false);
+    interpreter.run(source);
+
+    if (jit.hadError() || traced.str() != interpreted.str()) {
+        std::cerr << "  FAILED: traced loops differ from the interpreter" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testEmitC() {
+    std::cout << "Testing C backend..." << std::endl;
+
+    Compiler compiler;
+    std::string code = compiler.compileToC("fn fib(n) { if (n <= 1) { return n; } return fib(n - 1) + fib(n - 2); }"
+                                           "let s = \"fib\"; { let a = 2; print a + (a = 5); } print s; print fib(10);");
+    if (compiler.hadError() || code.find("int main(void)") == std::string::npos) {
+        std::cerr << "  FAILED: " << compiler.getError() << std::endl;
+        return;
+    }
+
+    // A global read before its declaration runs stops with the VM's message
+    code = compiler.compileToC("fn f() { return g; } print f(); let g = 1;");
+    if (compiler.hadError() || code.find("static MlValue g_g = {ML_UNDEFINED, {0}};") == std::string::npos ||
+        code.find("ml_global(g_g, \"g\")") == std::string::npos ||
+        code.find("Undefined variable '%s'.") == std::string::npos) {
+        std::cerr << "  FAILED: global read is not checked" << std::endl;
+        return;
+    }
+
+    compiler.compileToC("fn f() { return missing; }");
+    if (!compiler.hadError()) {
+        std::cerr << "  FAILED: undefined global was accepted" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testConstantFolding() {
+    std::cout << "Testing constant folding..." << std::endl;
+
+    // Folds to a single constant; the reassigned local and 1 / 0 must survive
+    Compiler compiler;
+    Chunk chunk = compiler.compile("print (10 + 5) * 2 - 3 + 0 * -1;");
+    if (compiler.hadError() || chunk.constants.size() != 1) {
+        std::cerr << "  FAILED: expression was not folded" << std::endl;
+        return;
+    }
+
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    compiler.run("{ let k = 4; let m = k; while (m < 6) { m = m + 1; } print m + k; print \"a\" + \"b\" == \"ab\"; }");
+    InterpretResult result = compiler.run("print 1 / 0;");
+
+    if (output.str() != "10\ntrue\n" || result != InterpretResult::RUNTIME_ERROR) {
+        std::cerr << "  FAILED: folded program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testDeadCode() {
+    std::cout << "Testing dead code elimination..." << std::endl;
+
+    // Only the second print survives: the rest is dead or has no effect
+    Compiler compiler;
+    Chunk chunk = compiler.compile(
+        "if (false) { print 1; } while (false) { print 2; }"
+        "{ let unused = 3; let k = 4; k; k == 4; if (k > 3) { print k; } else { print 5; } }");
+    size_t prints = 0;
+    for (const Instruction& instruction : chunk.code) {
+        if (instruction.opcode == OpCode::OP_PRINT) prints++;
+    }
+    if (compiler.hadError() || prints != 1 || chunk.code.size() > 4) {
+        std::cerr << "  FAILED: dead code was compiled (" << chunk.code.size() << " instructions)" << std::endl;
+        return;
+    }
+
+    // An unread initializer keeps its effects; a redeclaration is still an error
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    compiler.run("fn f(n) { let seen = g(n); if (n > 1) { return n; } else { return 0; } print \"dead\"; }"
+                 "fn g(n) { print \"g\"; return n; } print f(2);");
+    InterpretResult result = compiler.run("{ let d = 1; let d = 2; }");
+
+    if (output.str() != "g\n2\n" || result != InterpretResult::COMPILE_ERROR) {
+        std::cerr << "  FAILED: pruned program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testPeephole() {
+    std::cout << "Testing peephole..." << std::endl;
+
+    // `!` folds into the branch and the comparison; code after return goes
+    const char* source =
+        "let x = false; if (!x) { print \"a\"; }"
+        "let i = 0; while (i < 4) { if (!(i == 2)) { print i; } else { print \"b\"; } i = i + 1; }"
+        "fn f(n) { if (n < 1) { return 0; } return n + f(n - 1); } print f(4);";
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source);
+    const PeepholeStats& stats = compiler.peepholeStats();
+    if (compiler.hadError() || stats.removed < 3 || !stats.rules.contains("not-branch") ||
+        !stats.rules.contains("not-equal") || !stats.rules.contains("unreachable")) {
+        std::cerr << "  FAILED: peephole rules did not fire" << std::endl;
+        return;
+    }
+
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(chunk);
+
+    if (result != InterpretResult::OK || output.str() != "a\n0\n1\nb\n3\n10\n") {
+        std::cerr << "  FAILED: optimized program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testPeepholeTargets() {
+    std::cout << "Testing peephole jump targets..." << std::endl;
+
+    // if (x) { return; } 5; print "after"; -- the branch lands on the discarded push
+    Chunk chunk;
+    chunk.write(OpCode::OP_GET_LOCAL, 1, 1);
+    chunk.write(OpCode::OP_POP_JUMP_IF_FALSE, 1, 2);
+    chunk.write(OpCode::OP_NIL, 1);
+    chunk.write(OpCode::OP_RETURN, 1);
+    chunk.write(OpCode::OP_CONSTANT, 2, 0);
+    chunk.write(OpCode::OP_POP, 2);
+    chunk.write(OpCode::OP_CONSTANT, 3, 0);
+    chunk.write(OpCode::OP_PRINT, 3);
+    chunk.write(OpCode::OP_NIL, 4);
+    chunk.write(OpCode::OP_RETURN, 4);
+
+    Peephole peephole;
+    peephole.optimize(chunk);
+    bool printKept = false;
+    for (const Instruction& instruction : chunk.code) {
+        if (instruction.opcode == OpCode::OP_PRINT) printKept = true;
+    }
+
+    // The branch must still land inside the chunk, on the code after the return
+    size_t target = 2 + chunk.code[1].operand;
+    if (!printKept || chunk.code[1].opcode != OpCode::OP_POP_JUMP_IF_FALSE || target >= chunk.code.size() ||
+        chunk.code[target - 1].opcode != OpCode::OP_RETURN) {
+        std::cerr << "  FAILED: code after the early return was dropped" << std::endl;
+        return;
+    }
+
+    // Self-assignments right after a branch are jump targets too
+    const char* source =
+        "let k = 0; while (k < 3) { if (k > 5) { return 0; } k = k; k = k + 1; } print k;"
+        "fn g(x) { if (x) { return \"early\"; } x = x; print \"after\"; return \"end\"; } print g(false);";
+    std::ostringstream output;
+    Compiler compiler;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(source);
+
+    if (result != InterpretResult::OK || output.str() != "3\nafter\nend\n") {
+        std::cerr << "  FAILED: self-assignment after a branch changed the result: " << output.str() << std::endl;
+        return;
+    }
+
+    // A global self-assignment still reads the global, which may not be assigned yet
+    for (Backend backend : {Backend::STACK, Backend::SSA}) {
+        for (const char* unassigned : {"x = x; print \"ran\"; let x = 1;", "fn f() { g = g; return 1; } print f(); let g = 2;"}) {
+            std::ostringstream ignored;
+            Compiler checked;
+            checked.setBackend(backend);
+            checked.vm().setOutput(ignored);
+            if (checked.run(unassigned) != InterpretResult::RUNTIME_ERROR || !ignored.str().empty()) {
+                std::cerr << "  FAILED: global self-assignment skipped the undefined check" << std::endl;
+                return;
+            }
+        }
+    }
+    std::cout << "  PASSED" << std::endl;
+}
+
+void testSSA() {
+    std::cout << "Testing SSA..." << std::endl;
+
+    // The swap needs phis for both variables and a cyclic parallel copy
+    const char* source =
+        "fn f(n) { let a = 1; let b = 2; let i = 0; while (i < n) { let t = a; a = b; b = t; i = i + 1; } return a * 100 + b; }"
+        "print f(0); print f(3); let s = \"\"; let k = 0; while (k < 3) { s = s + \"x\"; k = k + 1; } print s;";
+    Compiler compiler;
+    std::string ssa = compiler.dumpSSA(source);
+    if (compiler.hadError() || ssa.find("phi") == std::string::npos) {
+        std::cerr << "  FAILED: loop variables did not get phis" << std::endl;
+        return;
+    }
+
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    compiler.setBackend(Backend::SSA);
+    InterpretResult result = compiler.run(source);
+
+    if (result != InterpretResult::OK || output.str() != "102\n201\nxxx\n") {
+        std::cerr << "  FAILED: SSA-generated program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testLoopInvariant() {
+    std::cout << "Testing loop-invariant code motion..." << std::endl;
+
+    // n * n - 1 is computed once before the loop and reused in the body
+    Compiler compiler;
+    Chunk chunk = compiler.compile("let n = 4; let i = 0; let s = 0; while (i < n * n - 1) { s = s + (n * n - 1); i = i + 1; }");
+    size_t multiplies = 0;
+    for (const Instruction& instruction : chunk.code) {
+        if (untypedOpcode(instruction.opcode) == OpCode::OP_MULTIPLY) multiplies++;
+    }
+    if (compiler.hadError() || multiplies != 1) {
+        std::cerr << "  FAILED: invariant was not hoisted" << std::endl;
+        return;
+    }
+
+    // A global changed by a call in the loop must be re-read every iteration
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    compiler.run(chunk);
+    compiler.run("print s; let g = 10; fn shrink() { g = g - 1; return 1; } let k = 0; while (k < g * 2) { k = k + shrink(); } print k;");
+
+    // Locals declared in and after the loop are resolved past the hidden ones
+    compiler.run("fn h(m) { let t = 0; let j = 0; while (j < m * 2) { let d = 1; t = t + d; j = j + 1; } let u = t; return u; }"
+                 "print h(3);");
+
+    if (compiler.hadError() || output.str() != "225\n7\n6\n") {
+        std::cerr << "  FAILED: hoisted program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testInlining() {
+    std::cout << "Testing inlining..." << std::endl;
+
+    // add and sq disappear into the loop; fib is recursive and stays a call
+    const char* source =
+        "fn add(a, b) { return a + b; } fn sq(x) { return x * x; }"
+        "fn fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }"
+        "let i = 0; let s = 0; while (i < 5) { s = add(s, sq(i + 1)); i = add(i, 1); } print s; print fib(8);"
+        "fn side(a) { print a; return a; } fn second(a, b) { return b; } print second(side(1), side(2));";
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source);
+    size_t calls = 0;
+    for (const Instruction& instruction : chunk.code) {
+        if (instruction.opcode == OpCode::OP_CALL) calls++;
+    }
+    if (compiler.hadError() || calls != 3) {
+        std::cerr << "  FAILED: expected only fib and side to be called, found " << calls << " calls" << std::endl;
+        return;
+    }
+
+    // Arguments are still evaluated once each, in order
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(chunk);
+
+    if (result != InterpretResult::OK || output.str() != "55\n21\n1\n2\n2\n") {
+        std::cerr << "  FAILED: inlined program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testStaticTypes() {
+    std::cout << "Testing static types..." << std::endl;
+
+    // i and s stay numbers; t may be a string after the if, and the call changes g
+    const char* source =
+        "let i = 0; let s = 0; while (i < 5) { s = s + i * 2; i = i + 1; } print s;"
+        "let t = 1; if (s > 10) { t = \"big\"; } print t + \"!\";"
+        "let g = 1; fn set() { g = \"g\"; return 0; } set(); print g + \"?\";";
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source);
+    size_t typed = 0;
+    size_t adds = 0;
+    for (const Instruction& instruction : chunk.code) {
+        if (untypedOpcode(instruction.opcode) != instruction.opcode) typed++;
+        if (instruction.opcode == OpCode::OP_ADD) adds++;
+    }
+    if (compiler.hadError() || typed < 4 || adds != 2) {
+        std::cerr << "  FAILED: expected typed arithmetic and two generic adds, found " << typed << " typed and "
+                  << adds << " generic" << std::endl;
+        return;
+    }
+
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(chunk);
+
+    if (result != InterpretResult::OK || output.str() != "20\nbig!\ng?\n") {
+        std::cerr << "  FAILED: typed program behaves differently" << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testIntegers() {
+    std::cout << "Testing integer modulo..." << std::endl;
+
+    // i and m stay integral, h has a fraction; the remainders keep fmod's signs
+    const char* source =
+        "let i = 0; let n = 0; while (i < 100) { if (i % 7 == 3) { n = n + 1; } i = i + 1; } print n;"
+        "let m = 0 - i; print m % 3; print (m + 91) % 3; let h = 7.5; print h % 2;"
+        "print (i * 100000000000000000000) % 7;";
+    Compiler compiler;
+    Chunk chunk = compiler.compile(source);
+    size_t integer = 0;
+    size_t generic = 0;
+    for (const Instruction& instruction : chunk.code) {
+        if (instruction.opcode == OpCode::OP_INT_MODULO) integer++;
+        if (untypedOpcode(instruction.opcode) == OpCode::OP_MODULO && instruction.opcode != OpCode::OP_INT_MODULO) {
+            generic++;
+        }
+    }
+    if (compiler.hadError() || integer != 4 || generic != 1) {
+        std::cerr << "  FAILED: expected four integer remainders and one other, found " << integer << " and "
+                  << generic << std::endl;
+        return;
+    }
+
+    std::ostringstream output;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(chunk);
+
+    if (result != InterpretResult::OK || output.str() != "14\n-1\n-0\n1.5\n4\n") {
+        std::cerr << "  FAILED: integer remainders differ from fmod: " << output.str() << std::endl;
+        return;
+    }
+
+    // Native code shares the remainder helpers: operands past 2^53 and fractions agree with the interpreter
+    const char* hot =
+        "fn rem(a, b) { return a % b; } let k = 0; let s = 0; while (k < 3000) {"
+        "  s = s + rem(k * 3000000000000000000, 7) + rem(k + 0.5, 3) + rem(0 - k * 10000000000000000, 9); k = k + 1; } print s;";
+    std::ostringstream native;
+    std::ostringstream interpreted;
+    Compiler jit;
+    jit.setInlining(false);
+    jit.vm().setOutput(native);
+    jit.run(hot);
+    Compiler interpreter;
+    interpreter.setInlining(false);
+    interpreter.vm().setOutput(interpreted);
+    interpreter.vm().setJitEnabled(false);
+    interpreter.run(hot);
+
+    if (jit.hadError() || native.str().empty() || native.str() != interpreted.str()) {
+        std::cerr << "  FAILED: native remainders differ: " << native.str() << " vs " << interpreted.str() << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
+void testSourceFile() {
+    std::cout << "Testing mapped source files..." << std::endl;
+
+    // Fill exactly one page so the last token ends at the end of the mapping
+    std::string path = (std::filesystem::temp_directory_path() / "minilang_test_source.ml").string();
+    std::string text = "let total = 40 + 2; // answer\n";
+    text += std::string(4096 - text.size() - 12, ' ') + "print total;";
+    std::ofstream(path, std::ios::binary) << text;
+
+    SourceFile file;
+    bool opened = file.open(path);
+    std::ostringstream output;
+    Compiler compiler;
+    compiler.vm().setOutput(output);
+    InterpretResult result = compiler.run(file.text());
+    file.close();
+    std::filesystem::remove(path);
+
+    // Missing files and directories are reported, not thrown
+    SourceFile missing;
+    SourceFile directory;
+    bool rejected = !missing.open(path) && missing.hadError() && missing.text().empty() &&
+                    !directory.open(std::filesystem::temp_directory_path().string()) && directory.hadError();
+    if (!opened || result != InterpretResult::OK || output.str() != "42\n" || !rejected) {
+        std::cerr << "  FAILED: " << (opened ? compiler.getError() : file.getError()) << std::endl;
+    } else {
+        std::cout << "  PASSED" << std::endl;
+    }
+}
+
 int main() {
     std::cout << "=== MiniLang Basic Tests ===" << std::endl << std::endl;
 
+    testLexer();
     testArithmetic();
     testComparison();
     testStrings();
     testIfStatement();
     testWhileLoop();
     testLogical();
+    testFunctions();
+    testGlobals();
+    testUndefinedGlobals();
+    testGarbageCollection();
+    testQuickening();
+    testWideOperands();
+    testAddConstant();
+    testStackDepth();
+    testRegisterBackend();
+    testJit();
+    testTracing();
+    testEmitC();
+    testConstantFolding();
+    testDeadCode();
+    testPeephole();
+    testPeepholeTargets();
+    testSSA();
+    testLoopInvariant();
+    testInlining();
+    testStaticTypes();
+    testIntegers();
+    testSourceFile();
 
     std::cout << std::endl << "=== All Tests Complete ===" << std::endl;
     return 0;